@@ -1,6 +1,18 @@
 const std = @import("std");
 const Pkg = std.build.Pkg;
 
+// src/lib.zig for other Zig projects, from their build.zig:
+//   exe.addPackage(@import("<path to dis>/build.zig").pkg);
+// and then @import("dis") in their code.
+pub const pkg = Pkg{
+    .name = "dis",
+    .source = .{ .path = thisDir() ++ "/src/lib.zig" },
+};
+
+fn thisDir() []const u8 {
+    return std.fs.path.dirname(@src().file) orelse ".";
+}
+
 pub fn build(b: *std.build.Builder) void {
     const target = b.standardTargetOptions(.{});
     const mode = b.standardReleaseOptions();
@@ -9,7 +21,15 @@ pub fn build(b: *std.build.Builder) void {
     exe.setTarget(target);
     exe.setBuildMode(mode);
     exe.install();
-    exe.single_threaded = true;
+
+    // NOTE(radomski): Zig tools use pkg above, C ones link this and include
+    // include/dis.h.
+    const lib = b.addStaticLibrary("dis", "src/c_api.zig");
+    lib.setTarget(target);
+    lib.setBuildMode(mode);
+    lib.linkLibC();
+    lib.install();
+    b.installFile("include/dis.h", "include/dis.h");
 
     const run_cmd = exe.run();
     run_cmd.step.dependOn(b.getInstallStep());
@@ -25,4 +45,28 @@ pub fn build(b: *std.build.Builder) void {
     }
     const trun_step = b.step("trun", "Run the app");
     trun_step.dependOn(&trun_cmd.step);
+
+    const bench = b.addExecutable("dis-bench", "src/bench.zig");
+    bench.setTarget(target);
+    bench.setBuildMode(mode);
+
+    const bench_cmd = bench.run();
+    bench_cmd.step.dependOn(b.getInstallStep());
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Run the benchmarks over generated inputs");
+    bench_step.dependOn(&bench_cmd.step);
+
+    const bench_micro = b.addExecutable("dis-bench-micro", "src/bench_micro.zig");
+    bench_micro.setTarget(target);
+    bench_micro.setBuildMode(mode);
+
+    const bench_micro_cmd = bench_micro.run();
+    bench_micro_cmd.step.dependOn(b.getInstallStep());
+    if (b.args) |args| {
+        bench_micro_cmd.addArgs(args);
+    }
+    const bench_micro_step = b.step("bench-micro", "Run the decoding primitive benchmarks");
+    bench_micro_step.dependOn(&bench_micro_cmd.step);
 }
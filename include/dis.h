@@ -0,0 +1,90 @@
+#ifndef DIS_H
+#define DIS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Everything returned points into the binary's tables and stays valid until
+ * dis_close. Strings are not zero terminated. */
+
+typedef struct dis_binary dis_binary;
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} dis_string;
+
+typedef struct {
+    uint32_t index;
+    uint32_t end;
+} dis_iterator;
+
+enum {
+    DIS_KIND_NONE = 0,
+    DIS_KIND_STRUCT = 1,
+    DIS_KIND_UNION = 2,
+    DIS_KIND_CLASS = 3,
+};
+
+typedef struct {
+    uint32_t id;
+    dis_string name;
+    uint32_t size;
+    uint8_t kind;
+    uint32_t member_count;
+} dis_structure;
+
+enum {
+    DIS_MEMBER_FIELD = 0,
+    DIS_MEMBER_BASE = 1,
+    DIS_MEMBER_VIRTUAL_BASE = 2, /* offset is meaningless */
+};
+
+typedef struct {
+    dis_string name;
+    uint32_t offset;
+    uint16_t bit_offset;
+    uint16_t bit_size;
+    dis_string type_name;
+    uint32_t type_size;
+    uint8_t ptr_count;
+    uint32_t dimension;
+    bool is_array;
+    uint32_t struct_id; /* UINT32_MAX unless the type is a structure */
+    uint8_t kind; /* DIS_MEMBER_* */
+} dis_member;
+
+typedef struct {
+    dis_string name;
+    uint32_t first_structure;
+    uint32_t structure_count;
+} dis_namespace;
+
+/* The buffer gets relocated in place, it has to be writable and outlive the
+ * binary. */
+dis_binary *dis_open_memory(uint8_t *data, size_t len);
+dis_binary *dis_open_fd(int fd);
+void dis_close(dis_binary *binary);
+
+dis_iterator dis_structures_begin(dis_binary *binary);
+bool dis_structures_next(dis_binary *binary, dis_iterator *it, dis_structure *out);
+
+dis_iterator dis_members_begin(dis_binary *binary, uint32_t structure_id);
+bool dis_members_next(dis_binary *binary, dis_iterator *it, dis_member *out);
+
+dis_iterator dis_namespaces_begin(dis_binary *binary);
+bool dis_namespaces_next(dis_binary *binary, dis_iterator *it, dis_namespace *out);
+
+/* Plain or namespace qualified, ns1::ns2::name */
+bool dis_find_structure(dis_binary *binary, const char *name, size_t name_len, dis_structure *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+const std = @import("std");
+const batch = @import("batch.zig");
+
+const fs = std.fs;
+const mem = std.mem;
+
+pub const archive_magic = "!<arch>\n";
+pub const thin_archive_magic = "!<thin>\n";
+
+const MemberHeader = extern struct {
+    name: [16]u8,
+    date: [12]u8,
+    uid: [6]u8,
+    gid: [6]u8,
+    mode: [8]u8,
+    size: [10]u8,
+    fmag: [2]u8,
+};
+
+pub const Error = error{
+    MalformedArchive,
+};
+
+pub fn isArchive(data: []const u8) bool {
+    return mem.startsWith(u8, data, archive_magic) or mem.startsWith(u8, data, thin_archive_magic);
+}
+
+fn parseDecimal(field: []const u8) !u64 {
+    const trimmed = mem.trimRight(u8, field, " ");
+    if (trimmed.len == 0) {
+        return 0;
+    }
+    return std.fmt.parseInt(u64, trimmed, 10) catch Error.MalformedArchive;
+}
+
+fn isElf(data: []const u8) bool {
+    return mem.startsWith(u8, data, "\x7fELF");
+}
+
+pub fn mapFile(file: fs.File, size: u64) ![]align(mem.page_size) u8 {
+    // NOTE(radomski): Private and writable, relocations get applied in place
+    // and only the touched pages get copied.
+    return std.os.mmap(null, size, std.os.PROT.READ | std.os.PROT.WRITE, std.os.MAP.PRIVATE, file.handle, 0);
+}
+
+// Collects every ELF member of the archive as a slice of the mapping. Thin
+// archives only store member paths, relative to the archive, so those members
+// are left for the prefetcher to read.
+pub fn readMembers(
+    data: []u8,
+    archive_dir: []const u8,
+    inputs: *std.ArrayList(batch.Input),
+    arena: mem.Allocator,
+) !void {
+    const thin = mem.startsWith(u8, data, thin_archive_magic);
+    var long_names: []const u8 = &[_]u8{};
+    var pos: usize = archive_magic.len;
+
+    while (pos + @sizeOf(MemberHeader) <= data.len) {
+        const header = mem.bytesToValue(MemberHeader, data[pos..][0..@sizeOf(MemberHeader)]);
+        pos += @sizeOf(MemberHeader);
+        if (!mem.eql(u8, &header.fmag, "`\n")) {
+            return Error.MalformedArchive;
+        }
+
+        const size = try parseDecimal(&header.size);
+        const raw_name = mem.trimRight(u8, &header.name, " ");
+        var name: []const u8 = raw_name;
+        var name_in_data: u64 = 0;
+
+        const is_special = mem.eql(u8, raw_name, "/") or mem.eql(u8, raw_name, "/SYM64/") or mem.eql(u8, raw_name, "//");
+        if (mem.eql(u8, raw_name, "//")) {
+            if (pos + size > data.len) {
+                return Error.MalformedArchive;
+            }
+            long_names = data[pos .. pos + size];
+        } else if (!is_special and raw_name.len > 1 and raw_name[0] == '/') {
+            // GNU long name, offset into the "//" member, terminated with "/\n"
+            const offset = try parseDecimal(raw_name[1..]);
+            if (offset >= long_names.len) {
+                return Error.MalformedArchive;
+            }
+            const end = mem.indexOfPos(u8, long_names, offset, "/\n") orelse long_names.len;
+            name = long_names[offset..end];
+        } else if (mem.startsWith(u8, raw_name, "#1/")) {
+            // BSD long name, stored at the start of the member data
+            name_in_data = try parseDecimal(raw_name[3..]);
+            // NOTE(radomski): The name is counted in the member size
+            if (name_in_data > size or pos + name_in_data > data.len) {
+                return Error.MalformedArchive;
+            }
+            name = mem.sliceTo(data[pos .. pos + name_in_data], 0);
+        } else if (!is_special and mem.endsWith(u8, raw_name, "/")) {
+            name = raw_name[0 .. raw_name.len - 1];
+        }
+
+        // NOTE(radomski): In thin archives only the symbol and name tables
+        // have their contents stored inline.
+        const stored_inline = !thin or is_special;
+        if (!is_special) {
+            if (stored_inline) {
+                if (pos + size > data.len) {
+                    return Error.MalformedArchive;
+                }
+                const member_data = data[pos + name_in_data .. pos + size];
+                if (isElf(member_data)) {
+                    try inputs.append(.{ .name = name, .data = member_data });
+                }
+            } else {
+                // NOTE(radomski): Read by the prefetcher while earlier
+                // members get parsed, only the parts the parser needs.
+                const member_path = if (fs.path.isAbsolute(name)) name else try fs.path.join(arena, &.{ archive_dir, name });
+                try inputs.append(.{ .name = member_path, .data = &[_]u8{}, .path = member_path });
+            }
+        }
+
+        if (stored_inline) {
+            pos += size;
+        }
+        pos = mem.alignForward(pos, 2);
+    }
+}
+
+pub fn run(file: fs.File, path: []const u8, arena: mem.Allocator) !void {
+    const size = try file.getEndPos();
+    const data = try mapFile(file, size);
+    defer std.os.munmap(data);
+
+    var inputs = std.ArrayList(batch.Input).init(arena);
+    const archive_dir = fs.path.dirname(path) orelse ".";
+    try readMembers(data, archive_dir, &inputs, arena);
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.BufferedWriter(16 * 1024, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
+
+    var timer = try std.time.Timer.start();
+    try batch.processInputs(inputs.items, bw.writer(), arena);
+    try bw.flush();
+    const ns = timer.read();
+    std.debug.print("Members: {} in {}\n", .{ inputs.items.len, std.fmt.fmtDuration(ns) });
+}
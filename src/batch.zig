@@ -0,0 +1,168 @@
+const std = @import("std");
+const main = @import("main.zig");
+const elf = @import("elf.zig");
+const Prefetcher = @import("prefetch.zig");
+
+const mem = std.mem;
+
+pub const Input = struct {
+    name: []const u8,
+    data: []u8,
+    // When set, data is read from here by the prefetcher right before the
+    // input is parsed and freed right after.
+    path: ?[]const u8 = null,
+};
+
+const Output = struct {
+    arena_instance: std.heap.ArenaAllocator,
+    text: []const u8 = &[_]u8{},
+    // End offset in text of every printed structure
+    struct_ends: []const usize = &[_]usize{},
+};
+
+const Shared = struct {
+    inputs: []const Input,
+    outputs: []Output,
+    prefetcher: ?*Prefetcher = null,
+    next_input: usize = 0,
+};
+
+fn processInput(input: Input, output: *Output) !void {
+    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    var c = try main.contextFromElf(input.data, arena);
+    try c.parse();
+    c.sortNamespaces();
+
+    const output_arena = output.arena_instance.allocator();
+    var text = std.ArrayList(u8).init(output_arena);
+    var struct_ends = std.ArrayList(usize).init(output_arena);
+
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        try c.printStruct(s, &text, it.activeNamespaces());
+        try struct_ends.append(text.items.len);
+    }
+
+    output.text = text.items;
+    output.struct_ends = struct_ends.items;
+}
+
+fn worker(shared: *Shared) void {
+    while (true) {
+        const i = @atomicRmw(usize, &shared.next_input, .Add, 1, .Monotonic);
+        if (i >= shared.inputs.len) {
+            break;
+        }
+
+        if (shared.prefetcher) |prefetcher| {
+            prefetcher.acquire(i) catch |err| {
+                std.log.warn("{s}: {s}", .{ shared.inputs[i].name, @errorName(err) });
+                prefetcher.release(i);
+                continue;
+            };
+        }
+
+        if (shared.inputs[i].data.len > 0) {
+            processInput(shared.inputs[i], &shared.outputs[i]) catch |err| {
+                std.log.warn("{s}: {s}", .{ shared.inputs[i].name, @errorName(err) });
+            };
+        }
+
+        if (shared.prefetcher) |prefetcher| {
+            prefetcher.release(i);
+        }
+    }
+}
+
+// NOTE(radomski): Every pool worker already has a core, splitting the
+// relocations of an input would only add threads competing for them. With a
+// single input, or no pool, the calling thread does the work and may split.
+fn poolWorker(shared: *Shared) void {
+    elf.relocation_split.threshold = null;
+    worker(shared);
+}
+
+// Parses every input on its own thread pool worker and prints the results in
+// input order. A structure printed by more than one input, same namespaces and
+// the same layout, is only printed the first time it's seen.
+pub fn processInputs(inputs: []Input, stdout: anytype, gpa: mem.Allocator) !void {
+    var outputs = try gpa.alloc(Output, inputs.len);
+    defer gpa.free(outputs);
+    for (outputs) |*output| {
+        output.* = .{ .arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator) };
+    }
+    defer {
+        for (outputs) |*output| {
+            output.arena_instance.deinit();
+        }
+    }
+
+    var prefetcher_opt: ?Prefetcher = null;
+    if (Prefetcher.needed(inputs)) {
+        prefetcher_opt = try Prefetcher.init(inputs, gpa);
+        try prefetcher_opt.?.start();
+    }
+    defer {
+        if (prefetcher_opt) |*prefetcher| {
+            prefetcher.deinit();
+        }
+    }
+
+    var shared = Shared{ .inputs = inputs, .outputs = outputs };
+    if (prefetcher_opt) |*prefetcher| {
+        shared.prefetcher = prefetcher;
+    }
+    const thread_count = @minimum(inputs.len, std.Thread.getCpuCount() catch 1);
+    var threads = try std.ArrayList(std.Thread).initCapacity(gpa, thread_count);
+    defer threads.deinit();
+    while (thread_count > 1 and threads.items.len < thread_count) {
+        const thread = std.Thread.spawn(.{}, poolWorker, .{&shared}) catch break;
+        threads.appendAssumeCapacity(thread);
+    }
+    if (threads.items.len == 0) {
+        worker(&shared);
+    }
+    for (threads.items) |thread| {
+        thread.join();
+    }
+    if (prefetcher_opt) |prefetcher| {
+        prefetcher.stats.print();
+    }
+
+    var seen = std.StringHashMap(void).init(gpa);
+    defer seen.deinit();
+    for (outputs) |output| {
+        var start: usize = 0;
+        for (output.struct_ends) |end| {
+            const text = output.text[start..end];
+            start = end;
+
+            const gop = try seen.getOrPut(text);
+            if (!gop.found_existing) {
+                try stdout.writeAll(text);
+            }
+        }
+    }
+}
+
+// Batch over object files given on the command line, read through the
+// prefetcher instead of all being mapped up front.
+pub fn runFiles(paths: []const []const u8, arena: mem.Allocator) !void {
+    var inputs = try arena.alloc(Input, paths.len);
+    for (paths) |path, i| {
+        inputs[i] = .{ .name = path, .data = &[_]u8{}, .path = path };
+    }
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.BufferedWriter(16 * 1024, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
+
+    var timer = try std.time.Timer.start();
+    try processInputs(inputs, bw.writer(), arena);
+    try bw.flush();
+    const ns = timer.read();
+    std.debug.print("Files: {} in {}\n", .{ inputs.len, std.fmt.fmtDuration(ns) });
+}
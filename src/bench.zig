@@ -0,0 +1,257 @@
+const std = @import("std");
+const fs = std.fs;
+const mem = std.mem;
+const time = std.time;
+
+const KiloByte = 1024;
+const MegaByte = 1024 * KiloByte;
+const GigaByte = 1024 * MegaByte;
+
+// NOTE(radomski): Inputs are generated once into the bench directory and reused
+// between runs, generating the big ones takes a while.
+const Input = struct {
+    name: []const u8,
+    generate: *const fn (path: []const u8) anyerror!void,
+};
+
+const inputs = [_]Input{
+    .{ .name = "dwarf64_over_4gib.elf", .generate = generateDwarf64OverFourGiB },
+};
+
+pub fn main() !void {
+    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    const bench_dir_path = if (args.len > 1) args[1] else "zig-cache/bench";
+    const runs: u32 = if (args.len > 2) try std.fmt.parseInt(u32, args[2], 10) else 3;
+
+    try fs.cwd().makePath(bench_dir_path);
+
+    for (inputs) |input| {
+        const input_path = try fs.path.join(arena, &.{ bench_dir_path, input.name });
+        fs.cwd().access(input_path, .{}) catch {
+            std.debug.print("Generating {s}...\n", .{input_path});
+            var timer = try time.Timer.start();
+            try input.generate(input_path);
+            std.debug.print("Generated in {}\n", .{std.fmt.fmtDuration(timer.read())});
+        };
+
+        const input_size = (try fs.cwd().statFile(input_path)).size;
+        var best_ns: u64 = std.math.maxInt(u64);
+        var run: u32 = 0;
+        while (run < runs) : (run += 1) {
+            var timer = try time.Timer.start();
+            const result = try std.ChildProcess.exec(.{
+                .allocator = arena,
+                .argv = &.{ "./zig-out/bin/dis", input_path },
+                .max_output_bytes = 4 * GigaByte,
+            });
+            const ns = timer.read();
+            defer arena.free(result.stdout);
+            defer arena.free(result.stderr);
+
+            if (result.term != .Exited or result.term.Exited != 0) {
+                std.debug.print("{s}\n", .{result.stderr});
+                return error.BenchmarkFailed;
+            }
+
+            std.debug.print("{s}", .{result.stderr});
+            best_ns = @minimum(best_ns, ns);
+        }
+
+        const elapsed_s = @intToFloat(f64, best_ns) / time.ns_per_s;
+        const throughput = @floatToInt(u64, @intToFloat(f64, input_size) / elapsed_s);
+        std.debug.print("{s}: {} best of {}, {}[{}/s]\n", .{
+            input.name,
+            std.fmt.fmtDuration(best_ns),
+            runs,
+            std.fmt.fmtIntSizeBin(input_size),
+            std.fmt.fmtIntSizeDec(throughput),
+        });
+    }
+}
+
+const DW_TAG_compile_unit = 0x11;
+const DW_TAG_base_type = 0x24;
+const DW_TAG_structure_type = 0x13;
+const DW_TAG_member = 0x0d;
+const DW_TAG_variable = 0x34;
+
+const DW_AT_name = 0x03;
+const DW_AT_byte_size = 0x0b;
+const DW_AT_type = 0x49;
+const DW_AT_data_member_location = 0x38;
+const DW_AT_const_value = 0x1c;
+
+const DW_FORM_block2 = 0x03;
+const DW_FORM_data2 = 0x05;
+const DW_FORM_data4 = 0x06;
+const DW_FORM_string = 0x08;
+const DW_FORM_data1 = 0x0b;
+const DW_FORM_ref4 = 0x13;
+
+// zig fmt: off
+const abbrev_table = [_]u8{
+    1, DW_TAG_compile_unit,   1, DW_AT_name, DW_FORM_string, 0, 0,
+    2, DW_TAG_base_type,      0, DW_AT_name, DW_FORM_string, DW_AT_byte_size, DW_FORM_data1, 0, 0,
+    3, DW_TAG_structure_type, 1, DW_AT_name, DW_FORM_string, DW_AT_byte_size, DW_FORM_data4, 0, 0,
+    4, DW_TAG_member,         0, DW_AT_name, DW_FORM_string, DW_AT_type, DW_FORM_ref4, DW_AT_data_member_location, DW_FORM_data2, 0, 0,
+    5, DW_TAG_variable,       0, DW_AT_name, DW_FORM_string, DW_AT_const_value, DW_FORM_block2, 0, 0,
+    0,
+};
+// zig fmt: on
+
+// NOTE(radomski): DWARF64 unit header, 0xffffffff escape + u64 unit_length,
+// u16 version, u64 debug_abbrev_offset, u8 address_size.
+const dwarf64_unit_header_size = 4 + 8 + 2 + 8 + 1;
+const structs_per_cu = 64;
+const filler_block_size = 60 * KiloByte;
+const cu_payload_target = 1 * MegaByte;
+
+const CuTemplate = struct {
+    payload: std.ArrayList(u8),
+
+    fn init(allocator: mem.Allocator) !CuTemplate {
+        var payload = std.ArrayList(u8).init(allocator);
+        const w = payload.writer();
+
+        try w.writeByte(1);
+        try w.writeAll("bench.c\x00");
+
+        // NOTE(radomski): DW_FORM_ref4 is relative to the start of the unit header
+        const int_offset = @intCast(u32, dwarf64_unit_header_size + payload.items.len);
+        try w.writeByte(2);
+        try w.writeAll("int\x00");
+        try w.writeByte(4);
+
+        const char_offset = @intCast(u32, dwarf64_unit_header_size + payload.items.len);
+        try w.writeByte(2);
+        try w.writeAll("char\x00");
+        try w.writeByte(1);
+
+        var i: u32 = 0;
+        while (i < structs_per_cu) : (i += 1) {
+            try w.writeByte(3);
+            try w.print("bench_struct_{d}\x00", .{i});
+            try w.writeIntLittle(u32, 16);
+
+            const members = [_]struct { name: []const u8, type_offset: u32, loc: u16 }{
+                .{ .name = "small_a", .type_offset = char_offset, .loc = 0 },
+                .{ .name = "big_a", .type_offset = int_offset, .loc = 4 },
+                .{ .name = "small_b", .type_offset = char_offset, .loc = 8 },
+                .{ .name = "big_b", .type_offset = int_offset, .loc = 12 },
+            };
+            for (members) |m| {
+                try w.writeByte(4);
+                try w.writeAll(m.name);
+                try w.writeByte(0);
+                try w.writeIntLittle(u32, m.type_offset);
+                try w.writeIntLittle(u16, m.loc);
+            }
+            try w.writeByte(0);
+        }
+
+        var filler_index: u32 = 0;
+        while (payload.items.len + filler_block_size < cu_payload_target) : (filler_index += 1) {
+            try w.writeByte(5);
+            try w.print("bench_filler_{d}\x00", .{filler_index});
+            try w.writeIntLittle(u16, filler_block_size);
+            try w.writeByteNTimes(0xaa, filler_block_size);
+        }
+        try w.writeByte(0);
+
+        return CuTemplate{ .payload = payload };
+    }
+};
+
+fn generateDwarf64OverFourGiB(path: []const u8) !void {
+    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    const cu = try CuTemplate.init(arena);
+    const cu_size = dwarf64_unit_header_size + cu.payload.items.len;
+    const target_size: u64 = 4 * GigaByte + 256 * MegaByte;
+    const cu_count = (target_size + cu_size - 1) / cu_size;
+
+    const shstrtab = "\x00.shstrtab\x00.debug_abbrev\x00.debug_info\x00";
+    const shstrtab_name = 1;
+    const debug_abbrev_name = shstrtab_name + ".shstrtab".len + 1;
+    const debug_info_name = debug_abbrev_name + ".debug_abbrev".len + 1;
+
+    const elf_header_size = 64;
+    const section_header_size = 64;
+    const shstrtab_offset: u64 = elf_header_size;
+    // NOTE(radomski): Every unit gets its own copy of the abbreviation table,
+    // the same way separately compiled objects end up after linking.
+    const debug_abbrev_offset = shstrtab_offset + shstrtab.len;
+    const debug_abbrev_size = abbrev_table.len * cu_count;
+    const debug_info_offset = debug_abbrev_offset + debug_abbrev_size;
+    const debug_info_size = cu_size * cu_count;
+    const section_headers_offset = std.mem.alignForward(debug_info_offset + debug_info_size, 8);
+
+    var file = try fs.cwd().createFile(path, .{});
+    defer file.close();
+    var bw = std.io.BufferedWriter(4 * MegaByte, fs.File.Writer){ .unbuffered_writer = file.writer() };
+    const w = bw.writer();
+
+    // ELF identification + file header
+    try w.writeAll(&[_]u8{ 0x7f, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+    try w.writeIntLittle(u16, 2); // e_type = ET_EXEC
+    try w.writeIntLittle(u16, 62); // e_machine = EM_X86_64
+    try w.writeIntLittle(u32, 1); // e_version
+    try w.writeIntLittle(u64, 0); // e_entry
+    try w.writeIntLittle(u64, 0); // e_phoff
+    try w.writeIntLittle(u64, section_headers_offset); // e_shoff
+    try w.writeIntLittle(u32, 0); // e_flags
+    try w.writeIntLittle(u16, elf_header_size); // e_ehsize
+    try w.writeIntLittle(u16, 0); // e_phentsize
+    try w.writeIntLittle(u16, 0); // e_phnum
+    try w.writeIntLittle(u16, section_header_size); // e_shentsize
+    try w.writeIntLittle(u16, 4); // e_shnum
+    try w.writeIntLittle(u16, 1); // e_shstrndx
+
+    try w.writeAll(shstrtab);
+
+    var i: u64 = 0;
+    while (i < cu_count) : (i += 1) {
+        try w.writeAll(&abbrev_table);
+    }
+
+    i = 0;
+    while (i < cu_count) : (i += 1) {
+        try w.writeIntLittle(u32, std.math.maxInt(u32));
+        try w.writeIntLittle(u64, cu_size - 12);
+        try w.writeIntLittle(u16, 4);
+        try w.writeIntLittle(u64, i * abbrev_table.len);
+        try w.writeByte(8);
+        try w.writeAll(cu.payload.items);
+    }
+
+    try w.writeByteNTimes(0, section_headers_offset - (debug_info_offset + debug_info_size));
+
+    const SectionHeader = struct { name: u32, offset: u64, size: u64 };
+    const headers = [_]SectionHeader{
+        .{ .name = 0, .offset = 0, .size = 0 },
+        .{ .name = shstrtab_name, .offset = shstrtab_offset, .size = shstrtab.len },
+        .{ .name = debug_abbrev_name, .offset = debug_abbrev_offset, .size = debug_abbrev_size },
+        .{ .name = debug_info_name, .offset = debug_info_offset, .size = debug_info_size },
+    };
+    for (headers) |sh, shi| {
+        const sh_type: u32 = if (shi == 0) 0 else if (shi == 1) 3 else 1; // SHT_NULL, SHT_STRTAB, SHT_PROGBITS
+        try w.writeIntLittle(u32, sh.name);
+        try w.writeIntLittle(u32, sh_type);
+        try w.writeIntLittle(u64, 0); // sh_flags
+        try w.writeIntLittle(u64, 0); // sh_addr
+        try w.writeIntLittle(u64, sh.offset);
+        try w.writeIntLittle(u64, sh.size);
+        try w.writeIntLittle(u32, 0); // sh_link
+        try w.writeIntLittle(u32, 0); // sh_info
+        try w.writeIntLittle(u64, 1); // sh_addralign
+        try w.writeIntLittle(u64, 0); // sh_entsize
+    }
+
+    try bw.flush();
+}
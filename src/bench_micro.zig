@@ -0,0 +1,323 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const Buffer = @import("main.zig").Buffer;
+const Dwarf = @import("dwarf.zig");
+const elf = @import("elf.zig");
+
+const fs = std.fs;
+const mem = std.mem;
+const time = std.time;
+
+const KiloByte = 1024;
+const MegaByte = 1024 * KiloByte;
+
+// Benchmarks of the decoding primitives on their own: Buffer.consumeUntil,
+// readULEB128, readFormData and skipDieAttrs. Synthetic inputs have a known
+// distribution, the real ones are sections of an ELF file, by default our own
+// binary. Every case reports the best of a few passes over its input.
+
+const synthetic_size = 16 * MegaByte;
+const passes = 7;
+
+const Result = struct {
+    ops: usize,
+    bytes: usize,
+};
+
+fn readCycles() ?u64 {
+    // NOTE(radomski): TSC ticks at a constant rate, close to but not quite
+    // core cycles when the frequency scales.
+    if (builtin.cpu.arch == .x86_64) {
+        var low: u32 = undefined;
+        var high: u32 = undefined;
+        asm volatile ("rdtsc"
+            : [low] "={eax}" (low),
+              [high] "={edx}" (high),
+        );
+        return (@as(u64, high) << 32) | low;
+    }
+    return null;
+}
+
+fn measure(name: []const u8, comptime func: anytype, args: anytype) !void {
+    var best_ns: u64 = std.math.maxInt(u64);
+    var best_cycles: ?u64 = null;
+    var result = Result{ .ops = 0, .bytes = 0 };
+
+    var pass: u32 = 0;
+    while (pass < passes) : (pass += 1) {
+        const start_cycles = readCycles();
+        var timer = try time.Timer.start();
+        result = try @call(.{}, func, args);
+        const ns = timer.read();
+        const end_cycles = readCycles();
+
+        if (ns < best_ns) {
+            best_ns = ns;
+            if (start_cycles != null and end_cycles != null) {
+                best_cycles = end_cycles.? - start_cycles.?;
+            }
+        }
+    }
+
+    const ns_per_op = @intToFloat(f64, best_ns) / @intToFloat(f64, @maximum(result.ops, 1));
+    if (best_cycles) |cycles| {
+        const bytes_per_cycle = @intToFloat(f64, result.bytes) / @intToFloat(f64, @maximum(cycles, 1));
+        std.debug.print("{s: <40} {d: >9.2} ns/op {d: >7.3} bytes/cycle {: >10} ops {}\n", .{
+            name,
+            ns_per_op,
+            bytes_per_cycle,
+            result.ops,
+            std.fmt.fmtIntSizeBin(result.bytes),
+        });
+    } else {
+        std.debug.print("{s: <40} {d: >9.2} ns/op {s: >7} bytes/cycle {: >10} ops {}\n", .{
+            name,
+            ns_per_op,
+            "n/a",
+            result.ops,
+            std.fmt.fmtIntSizeBin(result.bytes),
+        });
+    }
+}
+
+fn benchConsumeUntil(data: []u8) !Result {
+    var buffer = Buffer{ .data = data };
+    var ops: usize = 0;
+    var total: usize = 0;
+    while (buffer.consumeUntil(0)) |s| {
+        total += s.len;
+        ops += 1;
+    }
+    mem.doNotOptimizeAway(total);
+    return Result{ .ops = ops, .bytes = data.len };
+}
+
+fn benchReadULEB128(data: []u8) !Result {
+    var buffer = Buffer{ .data = data };
+    var ops: usize = 0;
+    var total: usize = 0;
+    while (buffer.curr_pos < data.len) {
+        total +%= Dwarf.readULEB128(&buffer);
+        ops += 1;
+    }
+    mem.doNotOptimizeAway(total);
+    return Result{ .ops = ops, .bytes = data.len };
+}
+
+fn benchReadFormData(d: *Dwarf, forms: []const Dwarf.DW_FORM) !Result {
+    d.debug_info.curr_pos = 0;
+    var ops: usize = 0;
+    var total: usize = 0;
+    while (d.debug_info.curr_pos < d.debug_info.data.len) {
+        total +%= try d.readFormData(forms[ops % forms.len], 0);
+        ops += 1;
+    }
+    mem.doNotOptimizeAway(total);
+    return Result{ .ops = ops, .bytes = d.debug_info.data.len };
+}
+
+fn benchSkipDieAttrs(d: *Dwarf) !Result {
+    d.debug_info.curr_pos = 0;
+    var ops: usize = 0;
+    while (d.debug_info.curr_pos < d.debug_info.data.len) {
+        d.skipDieAttrs(0);
+        ops += 1;
+    }
+    return Result{ .ops = ops, .bytes = d.debug_info.data.len };
+}
+
+// Walks every DIE of every unit, skipping all attributes.
+fn benchWalkDies(d: *Dwarf) !Result {
+    var ops: usize = 0;
+    for (d.cus.items) |cu| {
+        d.current_cu = cu;
+        d.debug_info.curr_pos = cu.offset;
+        const end = cu.offset + cu.payload_size;
+        while (d.debug_info.curr_pos < end) {
+            const code = Dwarf.readULEB128(&d.debug_info);
+            if (code == 0) {
+                continue;
+            }
+            d.skipDieAttrs(cu.die_range.start + @intCast(Dwarf.DieId, code) - 1);
+            ops += 1;
+        }
+    }
+    return Result{ .ops = ops, .bytes = d.debug_info.data.len };
+}
+
+// Reads every attribute readFormData knows how to read, skips the others.
+fn benchReadDieAttrs(d: *Dwarf) !Result {
+    var ops: usize = 0;
+    var total: usize = 0;
+    for (d.cus.items) |cu| {
+        d.current_cu = cu;
+        d.debug_info.curr_pos = cu.offset;
+        const end = cu.offset + cu.payload_size;
+        while (d.debug_info.curr_pos < end) {
+            const code = Dwarf.readULEB128(&d.debug_info);
+            if (code == 0) {
+                continue;
+            }
+            const die = d.dies.items[cu.die_range.start + @intCast(Dwarf.DieId, code) - 1];
+            for (d.getAttrs(die.attr_range)) |attr, i| {
+                switch (attr.form) {
+                    .data1, .data2, .data4, .data8, .udata, .sdata, .ref1, .ref2, .ref4, .ref8, .strp, .strx1, .addr, .implicit_const => {
+                        total +%= try d.readFormData(attr.form, die.attr_range.start + i);
+                        ops += 1;
+                    },
+                    else => d.skipFormData(attr.form),
+                }
+            }
+        }
+    }
+    mem.doNotOptimizeAway(total);
+    return Result{ .ops = ops, .bytes = d.debug_info.data.len };
+}
+
+fn generateStrings(allocator: mem.Allocator, random: std.rand.Random, min_len: usize, max_len: usize) ![]u8 {
+    var data = try std.ArrayList(u8).initCapacity(allocator, synthetic_size + max_len + 1);
+    while (data.items.len < synthetic_size) {
+        const len = random.intRangeAtMost(usize, min_len, max_len);
+        var i: usize = 0;
+        while (i < len) : (i += 1) {
+            data.appendAssumeCapacity(random.intRangeAtMost(u8, 'a', 'z'));
+        }
+        data.appendAssumeCapacity(0);
+    }
+    return data.items;
+}
+
+fn appendULEB128(data: *std.ArrayList(u8), value: u64) !void {
+    var v = value;
+    while (v >= 0x80) : (v >>= 7) {
+        try data.append(@truncate(u8, v) | 0x80);
+    }
+    try data.append(@truncate(u8, v));
+}
+
+// ULEBs whose length in bytes is uniform in [min_len, max_len].
+fn generateULEBs(allocator: mem.Allocator, random: std.rand.Random, min_len: u6, max_len: u6) ![]u8 {
+    var data = try std.ArrayList(u8).initCapacity(allocator, synthetic_size + max_len);
+    while (data.items.len < synthetic_size) {
+        const len = random.intRangeAtMost(u6, min_len, max_len);
+        const low = if (len == 1) 0 else @as(u64, 1) << (7 * (len - 1));
+        const high = (@as(u64, 1) << (7 * len)) - 1;
+        try appendULEB128(&data, random.intRangeAtMost(u64, low, high));
+    }
+    return data.items;
+}
+
+fn syntheticDwarf(allocator: mem.Allocator, debug_info: []u8) Dwarf {
+    return Dwarf{
+        .attrs = std.meta.FieldType(Dwarf, .attrs).init(allocator),
+        .attr_implicit_consts = std.meta.FieldType(Dwarf, .attr_implicit_consts).init(allocator),
+        .attr_skips = std.meta.FieldType(Dwarf, .attr_skips).init(allocator),
+        .dies = std.meta.FieldType(Dwarf, .dies).init(allocator),
+        .cus = std.meta.FieldType(Dwarf, .cus).init(allocator),
+        .current_cu = .{
+            .size = 11,
+            .dwarf_address_size = 4,
+            .address_size = 8,
+            .payload_size = debug_info.len,
+            .offset = 0,
+            .die_range = .{ .start = 0, .end = 1 },
+        },
+        .binary_bitness = 64,
+        .debug_info = Buffer{ .data = debug_info },
+        .debug_str = Buffer{ .data = &[_]u8{} },
+        .debug_str_offsets = Buffer{ .data = &[_]u8{} },
+        .debug_info_address_stack = std.meta.FieldType(Dwarf, .debug_info_address_stack).init(allocator),
+    };
+}
+
+// The forms of a typical member DIE, name, type, decl_file, decl_line and
+// data_member_location, with udata thrown in for the variable length case.
+const member_forms = [_]Dwarf.DW_FORM{ .strp, .ref4, .data1, .data2, .data1, .udata };
+
+fn generateMemberDies(allocator: mem.Allocator, random: std.rand.Random) ![]u8 {
+    var data = try std.ArrayList(u8).initCapacity(allocator, synthetic_size + 32);
+    const w = data.writer();
+    while (data.items.len < synthetic_size) {
+        try w.writeIntLittle(u32, random.int(u32));
+        try w.writeIntLittle(u32, random.int(u32));
+        try w.writeByte(random.int(u8));
+        try w.writeIntLittle(u16, random.int(u16));
+        try w.writeByte(random.int(u8));
+        try appendULEB128(&data, random.intRangeAtMost(u64, 0, 1 << 20));
+    }
+    return data.items;
+}
+
+fn benchSynthetic(arena: mem.Allocator) !void {
+    var prng = std.rand.DefaultPrng.init(0x5eed);
+    const random = prng.random();
+
+    try measure("consumeUntil short strings (1-15)", benchConsumeUntil, .{try generateStrings(arena, random, 1, 15)});
+    try measure("consumeUntil medium strings (16-64)", benchConsumeUntil, .{try generateStrings(arena, random, 16, 64)});
+    try measure("consumeUntil long strings (64-1024)", benchConsumeUntil, .{try generateStrings(arena, random, 64, 1024)});
+
+    var len: u6 = 1;
+    while (len <= 5) : (len += 1) {
+        const name = try std.fmt.allocPrint(arena, "readULEB128 {}-byte", .{len});
+        try measure(name, benchReadULEB128, .{try generateULEBs(arena, random, len, len)});
+    }
+    try measure("readULEB128 1-5 byte mixed", benchReadULEB128, .{try generateULEBs(arena, random, 1, 5)});
+
+    const dies = try generateMemberDies(arena, random);
+    var form_dwarf = syntheticDwarf(arena, dies);
+    try measure("readFormData member forms", benchReadFormData, .{ &form_dwarf, &member_forms });
+
+    var skip_dwarf = syntheticDwarf(arena, dies);
+    const Attr = std.meta.Child(std.meta.FieldType(Dwarf, .attrs).Slice);
+    var attrs: [member_forms.len]Attr = undefined;
+    for (member_forms) |form, i| {
+        attrs[i] = .{ .at = .name, .form = form };
+    }
+    try skip_dwarf.attrs.appendSlice(&attrs);
+    try skip_dwarf.generateAttrSkips(&attrs, 8, 4);
+    try skip_dwarf.dies.append(.{
+        .tag = .member,
+        .attr_range = .{ .start = 0, .len = attrs.len },
+        .attr_skip_range = .{ .start = 0, .len = @intCast(u8, skip_dwarf.attr_skips.items.len) },
+        .sibling_attr_index = std.math.maxInt(u8),
+        .has_children = false,
+    });
+    try measure("skipDieAttrs member DIE", benchSkipDieAttrs, .{&skip_dwarf});
+}
+
+fn benchReal(path: []const u8, arena: mem.Allocator) !void {
+    const data = try fs.cwd().readFileAlloc(arena, path, std.math.maxInt(usize));
+    var buffer = Buffer{ .data = data };
+    var sections = try elf.getSectionsDebugSections(&buffer, arena);
+
+    std.debug.print("{s}: .debug_info {}, .debug_str {}\n", .{
+        path,
+        std.fmt.fmtIntSizeBin(sections.debug_info.data.len),
+        std.fmt.fmtIntSizeBin(sections.debug_str.data.len),
+    });
+    try measure("consumeUntil .debug_str", benchConsumeUntil, .{sections.debug_str.data});
+
+    var d = try Dwarf.init(
+        sections.binary_bitness,
+        &sections.debug_abbrev,
+        sections.debug_info,
+        sections.debug_str,
+        sections.debug_str_offsets,
+        arena,
+    );
+    try measure("skipDieAttrs every DIE of .debug_info", benchWalkDies, .{&d});
+    try measure("readFormData every DIE of .debug_info", benchReadDieAttrs, .{&d});
+}
+
+pub fn main() !void {
+    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    const elf_path = if (args.len > 1) args[1] else "zig-out/bin/dis";
+
+    try benchSynthetic(arena);
+    try benchReal(elf_path, arena);
+}
@@ -0,0 +1,767 @@
+const std = @import("std");
+const main = @import("main.zig");
+const elf = @import("elf.zig");
+const Dwarf = @import("dwarf.zig");
+
+const mem = std.mem;
+const Buffer = main.Buffer;
+const Context = main.Context;
+const NameId = main.NameId;
+const Type = main.Type;
+const TypeId = main.TypeId;
+const StructId = main.StructId;
+
+// BTF, the compact type format of the kernel (/sys/kernel/btf/vmlinux) and of
+// BPF objects, loaded into the same tables parsing DWARF fills. Types are
+// numbered from 1 in the order they're written, 0 being void, and may refer to
+// types further on, so they're indexed first and resolved in a second pass.
+//
+// NOTE(radomski): Derived types are resolved the way finishTypeFrame resolves
+// their DWARF counterparts, so the printer and the analyses can't tell where
+// the tables came from.
+
+pub const Error = error{
+    MalformedBtf,
+    InvalidTypeReference,
+    CyclicTypeReference,
+};
+
+const magic: u16 = 0xeb9f;
+
+const Header = extern struct {
+    magic: u16,
+    version: u8,
+    flags: u8,
+    hdr_len: u32,
+    // Relative to the end of the header
+    type_off: u32,
+    type_len: u32,
+    str_off: u32,
+    str_len: u32,
+};
+
+const BTF_KIND = enum(u5) {
+    unknown = 0,
+    int = 1,
+    ptr = 2,
+    array = 3,
+    struct_ = 4,
+    union_ = 5,
+    enum_ = 6,
+    fwd = 7,
+    typedef = 8,
+    volatile_ = 9,
+    const_ = 10,
+    restrict = 11,
+    func = 12,
+    func_proto = 13,
+    var_ = 14,
+    datasec = 15,
+    float = 16,
+    decl_tag = 17,
+    type_tag = 18,
+    enum64 = 19,
+    _,
+};
+
+const BtfType = extern struct {
+    name_off: u32,
+    info: u32,
+    // Size for int, enum, struct, union, float and datasec, a type id otherwise
+    size_or_type: u32,
+
+    fn kind(t: BtfType) BTF_KIND {
+        return @intToEnum(BTF_KIND, @truncate(u5, t.info >> 24));
+    }
+
+    fn vlen(t: BtfType) u16 {
+        return @truncate(u16, t.info);
+    }
+
+    fn kindFlag(t: BtfType) bool {
+        return t.info >> 31 != 0;
+    }
+};
+
+// In the top byte of an int's encoding
+const BTF_INT_SIGNED = 1 << 0;
+
+const BtfArray = extern struct {
+    type: u32,
+    index_type: u32,
+    nelems: u32,
+};
+
+const BtfMember = extern struct {
+    name_off: u32,
+    type: u32,
+    // In bits, with the struct's kind flag the top 8 bits are the bitfield size
+    offset: u32,
+};
+
+// Bytes following the BtfType of a kind.
+fn trailingSize(t: BtfType) !usize {
+    const vlen = @as(usize, t.vlen());
+    return switch (t.kind()) {
+        .unknown, .ptr, .fwd, .typedef, .volatile_, .const_, .restrict, .func, .float, .type_tag => 0,
+        .int, .var_, .decl_tag => 4,
+        .array => @sizeOf(BtfArray),
+        .struct_, .union_ => vlen * @sizeOf(BtfMember),
+        .enum_, .func_proto => vlen * 8,
+        .datasec, .enum64 => vlen * 12,
+        _ => Error.MalformedBtf,
+    };
+}
+
+pub const Source = struct {
+    data: []const u8,
+    pointer_size: u8,
+};
+
+pub fn isBtf(data: []const u8) bool {
+    return data.len >= @sizeOf(Header) and mem.readIntLittle(u16, data[0..2]) == magic;
+}
+
+// Raw BTF as in /sys/kernel/btf/vmlinux, or the .BTF section of an ELF file.
+pub fn find(data: []u8) ?Source {
+    if (isBtf(data)) {
+        return Source{ .data = data, .pointer_size = @sizeOf(usize) };
+    }
+
+    var buffer = Buffer{ .data = data };
+    const section = elf.findSection(&buffer, ".BTF") orelse return null;
+    if (!isBtf(section.data)) {
+        return null;
+    }
+    const pointer_size: u8 = if (data[4] == elf.ELF_32BIT_CLASS) 4 else 8;
+    return Source{ .data = section.data, .pointer_size = pointer_size };
+}
+
+const Loader = struct {
+    c: *Context,
+    types: []const u8,
+    // Offset of every type in types, index 0 is void and has none
+    offsets: std.ArrayListUnmanaged(u32) = .{},
+    states: []State = &[_]State{},
+    stack: std.ArrayListUnmanaged(u32) = .{},
+    base: TypeId,
+
+    const State = enum(u8) {
+        unresolved,
+        in_progress,
+        resolved,
+    };
+
+    fn typeAt(l: *Loader, id: u32) BtfType {
+        return mem.bytesToValue(BtfType, l.types[l.offsets.items[id]..][0..@sizeOf(BtfType)]);
+    }
+
+    fn trailing(l: *Loader, comptime T: type, id: u32, i: usize) T {
+        const start = l.offsets.items[id] + @sizeOf(BtfType) + i * @sizeOf(T);
+        return mem.bytesToValue(T, l.types[start..][0..@sizeOf(T)]);
+    }
+
+    fn typeId(l: *Loader, id: u32) !TypeId {
+        if (id >= l.offsets.items.len) {
+            return Error.InvalidTypeReference;
+        }
+        return l.base + id;
+    }
+
+    fn name(l: *Loader, name_off: u32) !NameId {
+        if (name_off == 0) {
+            return 0;
+        }
+        return l.c.names.reference(l.c.arena, name_off);
+    }
+
+    fn index(l: *Loader) !void {
+        try l.offsets.append(l.c.arena, 0);
+        var pos: usize = 0;
+        while (pos < l.types.len) {
+            if (l.types.len - pos < @sizeOf(BtfType)) {
+                return Error.MalformedBtf;
+            }
+            try l.offsets.append(l.c.arena, @intCast(u32, pos));
+            const t = l.typeAt(@intCast(u32, l.offsets.items.len - 1));
+            pos += @sizeOf(BtfType) + try trailingSize(t);
+        }
+        if (pos != l.types.len) {
+            return Error.MalformedBtf;
+        }
+    }
+
+    // The type a derived type is made from, the element type for arrays.
+    fn innerType(l: *Loader, id: u32) ?u32 {
+        if (id == 0) {
+            return null;
+        }
+        const t = l.typeAt(id);
+        return switch (t.kind()) {
+            .ptr, .typedef, .volatile_, .const_, .restrict, .type_tag => t.size_or_type,
+            .array => l.trailing(BtfArray, id, 0).type,
+            else => null,
+        };
+    }
+
+    fn resolve(l: *Loader, id: u32) !void {
+        const stack_start = l.stack.items.len;
+        try l.stack.append(l.c.arena, id);
+        while (l.stack.items.len > stack_start) {
+            const top = l.stack.items[l.stack.items.len - 1];
+            if (l.states[top] == .resolved) {
+                _ = l.stack.pop();
+                continue;
+            }
+
+            if (l.innerType(top)) |inner| {
+                _ = try l.typeId(inner);
+                switch (l.states[inner]) {
+                    .in_progress => return Error.CyclicTypeReference,
+                    .unresolved => {
+                        l.states[top] = .in_progress;
+                        try l.stack.append(l.c.arena, inner);
+                        continue;
+                    },
+                    .resolved => {},
+                }
+            }
+
+            try l.finishType(top);
+            l.states[top] = .resolved;
+            _ = l.stack.pop();
+        }
+    }
+
+    fn finishType(l: *Loader, id: u32) !void {
+        const c = l.c;
+        var t = Type{
+            .name = 0,
+            .size = 0,
+            .dimension = std.math.maxInt(u32),
+            .ptr_count = 0,
+        };
+
+        if (id == 0) {
+            t.name = try c.names.intern(c.arena, "void");
+            c.types.set(l.base, t);
+            return;
+        }
+
+        const btf_type = l.typeAt(id);
+        t.name = try l.name(btf_type.name_off);
+        const kind = btf_type.kind();
+        switch (kind) {
+            .int, .enum_, .enum64, .float, .struct_, .union_, .datasec => {
+                t.size = btf_type.size_or_type;
+                if (kind == .int) {
+                    t.is_signed = (l.trailing(u32, id, 0) >> 24) & BTF_INT_SIGNED != 0;
+                }
+            },
+            .ptr => {
+                const inner = c.types.get(l.base + btf_type.size_or_type);
+                t.size = c.dwarf.getPointerSize();
+                t.name = try c.pointeeName(inner);
+                t.ptr_count = 1 + inner.ptr_count;
+            },
+            .typedef, .volatile_, .const_, .restrict, .type_tag => {
+                const inner = c.types.get(l.base + btf_type.size_or_type);
+                if (t.name == 0) {
+                    t.name = inner.name;
+                }
+                t.size = inner.size;
+                if (inner.isArray()) {
+                    t.size *= inner.dimension;
+                }
+                if (kind != .typedef) {
+                    t.ptr_count = inner.ptr_count;
+                    t.qualifiers = inner.qualifiers;
+                }
+                if (inner.ptr_count == 0) {
+                    t.is_signed = inner.is_signed;
+                }
+                switch (kind) {
+                    .volatile_ => t.qualifiers.is_volatile = true,
+                    .const_ => t.qualifiers.is_const = true,
+                    .restrict => t.qualifiers.is_restrict = true,
+                    else => {},
+                }
+            },
+            .array => {
+                // NOTE(radomski): int a[2][3] is an array of arrays here and a
+                // single array with two subranges in DWARF, flatten it the same.
+                const array = l.trailing(BtfArray, id, 0);
+                const inner = c.types.get(l.base + array.type);
+                t.name = inner.name;
+                t.size = inner.size;
+                t.qualifiers = inner.qualifiers;
+                t.is_signed = inner.is_signed;
+                t.dimension = array.nelems;
+                if (inner.isArray()) {
+                    t.dimension *%= inner.dimension;
+                }
+            },
+            else => {},
+        }
+
+        if (t.name == 0 and kind != .struct_ and kind != .union_ and kind != .fwd) {
+            t.name = try c.names.intern(c.arena, "void");
+        }
+        c.types.set(l.base + id, t);
+    }
+
+    fn addStructure(l: *Loader, id: u32) !StructId {
+        const c = l.c;
+        const type_id = l.base + id;
+        const existing = c.types.items(.struct_id)[type_id];
+        if (existing != std.math.maxInt(StructId)) {
+            return existing;
+        }
+
+        const btf_type = l.typeAt(id);
+        const member_start = @intCast(main.MemberId, c.members.len);
+        try c.members.ensureUnusedCapacity(c.gpa, btf_type.vlen());
+        var i: usize = 0;
+        while (i < btf_type.vlen()) : (i += 1) {
+            const btf_member = l.trailing(BtfMember, id, i);
+            var bit_offset = btf_member.offset;
+            var bit_size: u32 = 0;
+            if (btf_type.kindFlag()) {
+                bit_size = bit_offset >> 24;
+                bit_offset &= 0xffffff;
+            } else if (btf_member.type != 0 and btf_member.type < l.offsets.items.len and l.typeAt(btf_member.type).kind() == .int) {
+                // Bitfields without the kind flag are ints narrower than their size
+                const int_data = l.trailing(u32, btf_member.type, 0);
+                const int_bits = int_data & 0xff;
+                if (int_bits != l.typeAt(btf_member.type).size_or_type * 8) {
+                    bit_size = int_bits;
+                    bit_offset += (int_data >> 16) & 0xff;
+                }
+            }
+
+            const member_type_id = try l.typeId(btf_member.type);
+            var mem_loc = bit_offset / 8;
+            if (bit_size != 0) {
+                // Offset of the storage unit the bitfield is in, as in DWARF
+                const unit_size = @maximum(c.types.items(.shape)[member_type_id].size, 1);
+                mem_loc = mem_loc / unit_size * unit_size;
+            }
+            c.members.appendAssumeCapacity(.{
+                .name = try l.name(btf_member.name_off),
+                .type_id = member_type_id,
+                .mem_loc = mem_loc,
+                .bit_loc = @intCast(u16, bit_offset - mem_loc * 8),
+                .bit_size = @intCast(u16, bit_size),
+            });
+        }
+
+        const struct_id = try c.addStruct(.{
+            .type_id = type_id,
+            .member_range = .{ .start = member_start, .end = @intCast(main.MemberId, c.members.len) },
+        });
+        c.types.items(.struct_id)[type_id] = struct_id;
+        c.types.items(.shape)[type_id].struct_type = if (btf_type.kind() == .union_) .union_type else .struct_type;
+        return struct_id;
+    }
+
+    // typedef struct { ... } name; is printed under the typedef's name, like
+    // readTypedefAtAddress does.
+    fn addTypedefStructure(l: *Loader, id: u32) !void {
+        const c = l.c;
+        const inner = l.typeAt(id).size_or_type;
+        if (inner == 0 or inner >= l.offsets.items.len) {
+            return;
+        }
+        const inner_kind = l.typeAt(inner).kind();
+        if (inner_kind != .struct_ and inner_kind != .union_) {
+            return;
+        }
+
+        const inner_struct_id = try l.addStructure(inner);
+        const s = c.structures.get(inner_struct_id);
+        const type_id = l.base + id;
+        const struct_id = try c.addStruct(.{
+            .type_id = type_id,
+            .member_range = s.member_range,
+            .inline_structures = s.inline_structures,
+        });
+        c.types.items(.struct_id)[type_id] = struct_id;
+        c.types.items(.shape)[type_id].struct_type = c.types.items(.shape)[s.type_id].struct_type;
+    }
+};
+
+pub fn load(c: *Context, data: []const u8) !void {
+    if (!isBtf(data)) {
+        return Error.MalformedBtf;
+    }
+    const header = mem.bytesToValue(Header, data[0..@sizeOf(Header)]);
+    if (header.hdr_len < @sizeOf(Header) or header.hdr_len > data.len) {
+        return Error.MalformedBtf;
+    }
+    const body = data[header.hdr_len..];
+    if (@as(u64, header.type_off) + header.type_len > body.len or @as(u64, header.str_off) + header.str_len > body.len) {
+        return Error.MalformedBtf;
+    }
+
+    c.names = try main.NameTable.init(c.arena, body[header.str_off .. header.str_off + header.str_len]);
+    var l = Loader{
+        .c = c,
+        .types = body[header.type_off .. header.type_off + header.type_len],
+        .base = @intCast(TypeId, c.types.len()),
+    };
+    try l.index();
+
+    const count = l.offsets.items.len;
+    try c.types.resize(c.gpa, l.base + count);
+    l.states = try c.arena.alloc(Loader.State, count);
+    mem.set(Loader.State, l.states, .unresolved);
+
+    var id: u32 = 0;
+    while (id < count) : (id += 1) {
+        try l.resolve(id);
+    }
+
+    id = 1;
+    while (id < count) : (id += 1) {
+        switch (l.typeAt(id).kind()) {
+            .struct_, .union_ => _ = try l.addStructure(id),
+            .typedef => try l.addTypedefStructure(id),
+            else => {},
+        }
+    }
+}
+
+pub fn contextFromBtf(source: Source, arena: mem.Allocator) !Context {
+    var c = try Context.init(arena, Dwarf.initEmpty(source.pointer_size, arena));
+    try load(&c, source.data);
+    return c;
+}
+
+// Writing the Context tables as BTF, for --emit-btf. The tables keep only the
+// name of what a pointer points to or an array holds, those become the struct
+// of that name when there is one and a base type otherwise.
+//
+// NOTE(radomski): Types are written bottom up and deduplicated on their
+// encoded bytes, so identical types, structures from different CUs included,
+// end up written once. Pointers to structures point to a fwd of the name,
+// which keeps the graph acyclic and the byte comparison exact.
+
+pub const EmitError = error{
+    UnencodableLayout,
+};
+
+pub const EmitStats = struct {
+    types: u32,
+    strings_size: usize,
+    size: usize,
+};
+
+const array_index_type_name = "__ARRAY_SIZE_TYPE__";
+
+const Encoder = struct {
+    c: *Context,
+    arena: mem.Allocator,
+    types: std.ArrayListUnmanaged(u8) = .{},
+    type_count: u32 = 0,
+    // Encoded bytes of a type to its id
+    type_ids: std.StringHashMapUnmanaged(u32) = .{},
+    strings: std.ArrayListUnmanaged(u8) = .{},
+    string_offsets: std.StringHashMapUnmanaged(u32) = .{},
+
+    struct_ids: []?u32,
+    struct_by_name: std.StringHashMapUnmanaged(StructId) = .{},
+    bases: std.StringHashMapUnmanaged(Base) = .{},
+    qualified_names: std.AutoHashMapUnmanaged(StructId, []const u8) = .{},
+    // Typedef'd structures share the members of the structure they name
+    first_with_members: std.AutoHashMapUnmanaged(u64, StructId) = .{},
+
+    const EmitTypeError = mem.Allocator.Error || EmitError;
+
+    const Base = struct {
+        size: u32,
+        is_signed: bool,
+    };
+
+    fn string(e: *Encoder, s: []const u8) EmitTypeError!u32 {
+        if (s.len == 0) {
+            return 0;
+        }
+        const gop = try e.string_offsets.getOrPut(e.arena, s);
+        if (!gop.found_existing) {
+            gop.value_ptr.* = @intCast(u32, e.strings.items.len);
+            try e.strings.appendSlice(e.arena, s);
+            try e.strings.append(e.arena, 0);
+        }
+        return gop.value_ptr.*;
+    }
+
+    fn addType(e: *Encoder, kind: BTF_KIND, vlen: usize, kind_flag: bool, name_off: u32, size_or_type: u32, trailing_bytes: []const u8) EmitTypeError!u32 {
+        if (vlen > std.math.maxInt(u16)) {
+            return EmitError.UnencodableLayout;
+        }
+        const t = BtfType{
+            .name_off = name_off,
+            .info = @as(u32, @enumToInt(kind)) << 24 | @intCast(u32, vlen) | @as(u32, @boolToInt(kind_flag)) << 31,
+            .size_or_type = size_or_type,
+        };
+        var bytes = try e.arena.alloc(u8, @sizeOf(BtfType) + trailing_bytes.len);
+        mem.copy(u8, bytes, mem.asBytes(&t));
+        mem.copy(u8, bytes[@sizeOf(BtfType)..], trailing_bytes);
+
+        const gop = try e.type_ids.getOrPut(e.arena, bytes);
+        if (!gop.found_existing) {
+            try e.types.appendSlice(e.arena, bytes);
+            e.type_count += 1;
+            gop.value_ptr.* = e.type_count;
+        }
+        return gop.value_ptr.*;
+    }
+
+    // Ints for the sizes BTF allows them, a typedef of a byte array otherwise.
+    fn emitBase(e: *Encoder, name: []const u8, size: u32, is_signed: bool) EmitTypeError!u32 {
+        if (size == 0) {
+            if (mem.eql(u8, name, "void")) {
+                return 0;
+            }
+            return e.addType(.typedef, 0, false, try e.string(name), 0, &.{});
+        }
+
+        switch (size) {
+            1, 2, 4, 8, 16 => {
+                const encoding: u32 = @as(u32, if (is_signed) BTF_INT_SIGNED else 0) << 24 | size * 8;
+                return e.addType(.int, 0, false, try e.string(name), size, mem.asBytes(&encoding));
+            },
+            else => {
+                const bytes = try e.emitArray(try e.emitBase("unsigned char", 1, false), size);
+                return e.addType(.typedef, 0, false, try e.string(name), bytes, &.{});
+            },
+        }
+    }
+
+    fn emitArray(e: *Encoder, element: u32, nelems: u32) EmitTypeError!u32 {
+        const array = BtfArray{
+            .type = element,
+            .index_type = try e.emitBase(array_index_type_name, 4, false),
+            .nelems = nelems,
+        };
+        return e.addType(.array, 0, false, 0, 0, mem.asBytes(&array));
+    }
+
+    // The pointee's qualifiers lead its name, see Context.pointeeName
+    fn emitPointee(e: *Encoder, qualified_name: []const u8) EmitTypeError!u32 {
+        var name = qualified_name;
+        var qualifiers = Type.Qualifiers{};
+        while (true) {
+            if (mem.startsWith(u8, name, "const ")) {
+                qualifiers.is_const = true;
+            } else if (mem.startsWith(u8, name, "volatile ")) {
+                qualifiers.is_volatile = true;
+            } else if (mem.startsWith(u8, name, "_Atomic ")) {
+                qualifiers.is_atomic = true;
+            } else if (mem.startsWith(u8, name, "restrict ")) {
+                qualifiers.is_restrict = true;
+            } else {
+                break;
+            }
+            name = name[mem.indexOfScalar(u8, name, ' ').? + 1 ..];
+        }
+
+        const id = if (e.struct_by_name.get(name)) |sid| blk: {
+            const is_union = e.c.types.items(.shape)[e.c.structures.items(.type_id)[sid]].struct_type == .union_type;
+            break :blk try e.addType(.fwd, 0, is_union, try e.string(name), 0, &.{});
+        } else blk: {
+            const base = e.bases.get(name) orelse Base{ .size = 0, .is_signed = false };
+            break :blk try e.emitBase(name, base.size, base.is_signed);
+        };
+        return e.emitQualifiers(id, qualifiers);
+    }
+
+    fn emitType(e: *Encoder, type_id: TypeId) EmitTypeError!u32 {
+        const t = e.c.types.get(type_id);
+        return e.emitQualifiers(try e.emitUnqualifiedType(t), t.qualifiers);
+    }
+
+    // NOTE(radomski): BTF has no kind for _Atomic, that one is dropped
+    fn emitQualifiers(e: *Encoder, unqualified: u32, qualifiers: Type.Qualifiers) EmitTypeError!u32 {
+        var id = unqualified;
+        if (qualifiers.is_restrict) {
+            id = try e.addType(.restrict, 0, false, 0, id, &.{});
+        }
+        if (qualifiers.is_volatile) {
+            id = try e.addType(.volatile_, 0, false, 0, id, &.{});
+        }
+        if (qualifiers.is_const) {
+            id = try e.addType(.const_, 0, false, 0, id, &.{});
+        }
+        return id;
+    }
+
+    fn emitUnqualifiedType(e: *Encoder, t: Type) EmitTypeError!u32 {
+        const c = e.c;
+        const name = c.getName(t.name);
+        if (t.ptr_count > 0) {
+            var id = try e.emitPointee(name);
+            var i: u8 = 0;
+            while (i < t.ptr_count) : (i += 1) {
+                id = try e.addType(.ptr, 0, false, 0, id, &.{});
+            }
+            return id;
+        }
+
+        if (t.isArray()) {
+            const element = if (e.struct_by_name.get(name)) |sid| blk: {
+                const element_type = c.types.get(c.structures.items(.type_id)[sid]);
+                if (element_type.size != t.size) {
+                    break :blk try e.emitBase(name, t.size, t.is_signed);
+                }
+                break :blk try e.emitStructure(sid);
+            } else try e.emitBase(name, t.size, t.is_signed);
+            return e.emitArray(element, t.dimension);
+        }
+
+        if (t.struct_id != std.math.maxInt(StructId)) {
+            return e.emitStructure(t.struct_id);
+        }
+        return e.emitBase(name, t.size, t.is_signed);
+    }
+
+    fn emitStructure(e: *Encoder, sid: StructId) EmitTypeError!u32 {
+        if (e.struct_ids[sid]) |id| {
+            return id;
+        }
+
+        const c = e.c;
+        const s = c.structures.get(sid);
+        const stype = c.types.get(s.type_id);
+        const name_off = try e.string(e.qualified_names.get(sid) orelse c.getName(stype.name));
+
+        const range_key = @as(u64, s.member_range.start) << 32 | s.member_range.end;
+        const first = e.first_with_members.get(range_key) orelse sid;
+        if (first != sid and s.member_range.len() > 0) {
+            const id = try e.addType(.typedef, 0, false, name_off, try e.emitStructure(first), &.{});
+            e.struct_ids[sid] = id;
+            return id;
+        }
+
+        // NOTE(radomski): Virtual bases have no offset of their own, BTF has
+        // no way to say where they go
+        var members = try std.ArrayList(BtfMember).initCapacity(e.arena, s.member_range.len());
+        var bit_sizes = try std.ArrayList(u16).initCapacity(e.arena, s.member_range.len());
+        var has_bitfields = false;
+        const member_columns = c.members.slice();
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            if (member_columns.items(.kind)[member_id] == .virtual_base) {
+                continue;
+            }
+            const bit_size = member_columns.items(.bit_size)[member_id];
+            members.appendAssumeCapacity(.{
+                .name_off = try e.string(c.getName(member_columns.items(.name)[member_id])),
+                .type = try e.emitType(member_columns.items(.type_id)[member_id]),
+                .offset = member_columns.items(.mem_loc)[member_id] * 8 + member_columns.items(.bit_loc)[member_id],
+            });
+            bit_sizes.appendAssumeCapacity(bit_size);
+            has_bitfields = has_bitfields or bit_size != 0;
+        }
+        if (has_bitfields) {
+            for (members.items) |*btf_member, i| {
+                const bit_size = bit_sizes.items[i];
+                if (btf_member.offset > 0xffffff or bit_size > 0xff) {
+                    return EmitError.UnencodableLayout;
+                }
+                btf_member.offset |= @as(u32, bit_size) << 24;
+            }
+        }
+
+        const kind: BTF_KIND = if (stype.struct_type == .union_type) .union_ else .struct_;
+        const id = try e.addType(kind, members.items.len, has_bitfields, name_off, stype.size, mem.sliceAsBytes(members.items));
+        e.struct_ids[sid] = id;
+        return id;
+    }
+
+    fn indexTables(e: *Encoder) !void {
+        const c = e.c;
+        var sid: StructId = 0;
+        while (sid < c.structures.len) : (sid += 1) {
+            const s = c.structures.get(sid);
+            const stype = c.types.get(s.type_id);
+            if (stype.name != 0 and stype.size > 0) {
+                _ = try e.struct_by_name.getOrPutValue(e.arena, c.getName(stype.name), sid);
+            }
+            if (s.member_range.len() > 0) {
+                _ = try e.first_with_members.getOrPutValue(e.arena, @as(u64, s.member_range.start) << 32 | s.member_range.end, sid);
+            }
+        }
+
+        var type_id: TypeId = 0;
+        while (type_id < c.types.len()) : (type_id += 1) {
+            const t = c.types.get(type_id);
+            if (t.ptr_count == 0 and !t.isArray() and t.struct_id == std.math.maxInt(StructId) and t.size > 0) {
+                _ = try e.bases.getOrPutValue(e.arena, c.getName(t.name), .{ .size = t.size, .is_signed = t.is_signed });
+            }
+        }
+
+        // NOTE(radomski): BTF has no namespaces, the qualified name prints the same
+        var it = try c.containerIterator(.all);
+        defer it.deinit();
+        while (try it.next()) |s| {
+            var qualified = std.ArrayList(u8).init(e.arena);
+            for (it.activeNamespaces()) |ns| {
+                if (ns.name.len > 0) {
+                    try qualified.appendSlice(ns.name);
+                    try qualified.appendSlice("::");
+                }
+            }
+            if (qualified.items.len > 0) {
+                try qualified.appendSlice(c.getName(c.types.items(.name)[s.type_id]));
+                try e.qualified_names.put(e.arena, @intCast(StructId, it.sid - 1), qualified.items);
+            }
+        }
+    }
+};
+
+pub const Emitted = struct {
+    data: []const u8,
+    stats: EmitStats,
+};
+
+pub fn emit(c: *Context, arena: mem.Allocator) !Emitted {
+    var e = Encoder{ .c = c, .arena = arena, .struct_ids = try arena.alloc(?u32, c.structures.len) };
+    mem.set(?u32, e.struct_ids, null);
+    try e.strings.append(arena, 0);
+    try e.indexTables();
+
+    var sid: StructId = 0;
+    while (sid < c.structures.len) : (sid += 1) {
+        _ = try e.emitStructure(sid);
+    }
+
+    const header = Header{
+        .magic = magic,
+        .version = 1,
+        .flags = 0,
+        .hdr_len = @sizeOf(Header),
+        .type_off = 0,
+        .type_len = @intCast(u32, e.types.items.len),
+        .str_off = @intCast(u32, e.types.items.len),
+        .str_len = @intCast(u32, e.strings.items.len),
+    };
+    var out = try std.ArrayList(u8).initCapacity(arena, @sizeOf(Header) + e.types.items.len + e.strings.items.len);
+    out.appendSliceAssumeCapacity(mem.asBytes(&header));
+    out.appendSliceAssumeCapacity(e.types.items);
+    out.appendSliceAssumeCapacity(e.strings.items);
+    return Emitted{
+        .data = out.items,
+        .stats = .{
+            .types = e.type_count,
+            .strings_size = e.strings.items.len,
+            .size = out.items.len,
+        },
+    };
+}
+
+pub fn emitFile(c: *Context, path: []const u8, arena: mem.Allocator) !EmitStats {
+    const emitted = try emit(c, arena);
+    try std.fs.cwd().writeFile(path, emitted.data);
+    return emitted.stats;
+}
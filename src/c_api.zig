@@ -0,0 +1,135 @@
+const std = @import("std");
+const lib = @import("lib.zig");
+
+// C ABI over lib.zig, declared in include/dis.h. Strings aren't zero
+// terminated, they're a pointer and a length into the binary's tables.
+
+const DisString = extern struct {
+    ptr: [*]const u8,
+    len: usize,
+
+    fn from(s: []const u8) DisString {
+        return .{ .ptr = s.ptr, .len = s.len };
+    }
+};
+
+const DisIterator = extern struct {
+    index: u32,
+    end: u32,
+};
+
+const DisStructure = extern struct {
+    id: u32,
+    name: DisString,
+    size: u32,
+    kind: u8,
+    member_count: u32,
+};
+
+const DisMember = extern struct {
+    name: DisString,
+    offset: u32,
+    bit_offset: u16,
+    bit_size: u16,
+    type_name: DisString,
+    type_size: u32,
+    ptr_count: u8,
+    // 0 when not an array
+    dimension: u32,
+    is_array: bool,
+    // UINT32_MAX when the type isn't a structure
+    struct_id: u32,
+    kind: u8,
+};
+
+const DisNamespace = extern struct {
+    name: DisString,
+    first_structure: u32,
+    structure_count: u32,
+};
+
+const gpa = std.heap.c_allocator;
+
+fn structureToC(s: lib.StructureView) DisStructure {
+    return .{
+        .id = s.id,
+        .name = DisString.from(s.name),
+        .size = s.size,
+        .kind = @enumToInt(s.kind),
+        .member_count = s.member_count,
+    };
+}
+
+export fn dis_open_memory(data: [*]u8, len: usize) ?*lib.Binary {
+    return lib.Binary.openMemory(gpa, data[0..len]) catch null;
+}
+
+export fn dis_open_fd(fd: c_int) ?*lib.Binary {
+    return lib.Binary.openFd(gpa, fd) catch null;
+}
+
+export fn dis_close(b: ?*lib.Binary) void {
+    if (b) |binary| {
+        binary.close();
+    }
+}
+
+export fn dis_structures_begin(b: *lib.Binary) DisIterator {
+    const it = b.structures();
+    return .{ .index = it.index, .end = it.end };
+}
+
+export fn dis_structures_next(b: *lib.Binary, c_it: *DisIterator, out: *DisStructure) bool {
+    var it = lib.StructureIterator{ .b = b, .index = c_it.index, .end = c_it.end };
+    defer c_it.index = it.index;
+    const s = it.next() orelse return false;
+    out.* = structureToC(s);
+    return true;
+}
+
+export fn dis_members_begin(b: *lib.Binary, structure_id: u32) DisIterator {
+    const it = b.members(structure_id);
+    return .{ .index = it.index, .end = it.end };
+}
+
+export fn dis_members_next(b: *lib.Binary, c_it: *DisIterator, out: *DisMember) bool {
+    var it = lib.MemberIterator{ .b = b, .index = c_it.index, .end = c_it.end };
+    defer c_it.index = it.index;
+    const m = it.next() orelse return false;
+    out.* = .{
+        .name = DisString.from(m.name),
+        .offset = m.offset,
+        .bit_offset = m.bit_offset,
+        .bit_size = m.bit_size,
+        .type_name = DisString.from(m.type_name),
+        .type_size = m.type_size,
+        .ptr_count = m.ptr_count,
+        .dimension = m.dimension orelse 0,
+        .is_array = m.dimension != null,
+        .struct_id = m.struct_id orelse std.math.maxInt(u32),
+        .kind = @enumToInt(m.kind),
+    };
+    return true;
+}
+
+export fn dis_namespaces_begin(b: *lib.Binary) DisIterator {
+    return .{ .index = 0, .end = @intCast(u32, b.context.namespaces.items.len) };
+}
+
+export fn dis_namespaces_next(b: *lib.Binary, c_it: *DisIterator, out: *DisNamespace) bool {
+    var it = lib.NamespaceIterator{ .b = b, .index = c_it.index };
+    defer c_it.index = @intCast(u32, it.index);
+    const ns = it.next() orelse return false;
+    out.* = .{
+        .name = DisString.from(ns.name),
+        .first_structure = ns.first_structure,
+        .structure_count = ns.structure_count,
+    };
+    return true;
+}
+
+export fn dis_find_structure(b: *lib.Binary, name: [*]const u8, name_len: usize, out: *DisStructure) bool {
+    const s = (b.findStructure(name[0..name_len]) catch null) orelse return false;
+    out.* = structureToC(s);
+    return true;
+}
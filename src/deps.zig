@@ -0,0 +1,207 @@
+const std = @import("std");
+const archive = @import("archive.zig");
+const batch = @import("batch.zig");
+const elf = @import("elf.zig");
+const Buffer = @import("main.zig").Buffer;
+
+const fs = std.fs;
+const mem = std.mem;
+
+const ELFCLASS64 = 2;
+const ELFDATA2MSB = 2;
+const EF_ARM_ABI_FLOAT_HARD = 0x400;
+
+// Searched after the multiarch directories of the binary's machine
+const generic_library_dirs = [_][]const u8{
+    "/lib64",
+    "/usr/lib64",
+    "/lib",
+    "/usr/lib",
+    "/usr/local/lib",
+};
+
+// Class, data encoding and machine of an ELF file. A library only satisfies
+// DT_NEEDED of a binary it could actually be loaded into.
+const TargetIdent = struct {
+    class: u8,
+    data: u8,
+    machine: [2]u8,
+
+    fn fromBytes(bytes: []const u8) ?TargetIdent {
+        if (bytes.len < 20 or !mem.startsWith(u8, bytes, "\x7fELF")) {
+            return null;
+        }
+        return TargetIdent{ .class = bytes[4], .data = bytes[5], .machine = bytes[18..20].* };
+    }
+
+    fn eql(a: TargetIdent, b: TargetIdent) bool {
+        return a.class == b.class and a.data == b.data and mem.eql(u8, &a.machine, &b.machine);
+    }
+};
+
+// NOTE(radomski): Debian style multiarch directories are named after the
+// machine of the analysed binary, which isn't necessarily the one dis runs on.
+// Only the machines the relocation table knows about.
+fn multiarchTriple(header: []const u8) ?[]const u8 {
+    const is_64 = header[4] == ELFCLASS64;
+    const endian: std.builtin.Endian = if (header[5] == ELFDATA2MSB) .Big else .Little;
+    return switch (mem.readInt(u16, header[18..20], endian)) {
+        elf.EM_X86_64 => if (is_64) "x86_64-linux-gnu" else "x86_64-linux-gnux32",
+        elf.EM_386 => "i386-linux-gnu",
+        elf.EM_AARCH64 => "aarch64-linux-gnu",
+        elf.EM_ARM => blk: {
+            // e_flags, the 32 bit header has it at 36
+            if (header.len < 40) {
+                break :blk null;
+            }
+            const flags = mem.readInt(u32, header[36..40], endian);
+            break :blk if (flags & EF_ARM_ABI_FLOAT_HARD != 0) "arm-linux-gnueabihf" else "arm-linux-gnueabi";
+        },
+        elf.EM_RISCV => if (is_64) "riscv64-linux-gnu" else null,
+        else => null,
+    };
+}
+
+fn defaultLibraryDirs(header: []const u8, arena: mem.Allocator) ![]const []const u8 {
+    var dirs = std.ArrayList([]const u8).init(arena);
+    if (multiarchTriple(header)) |triple| {
+        try dirs.append(try fs.path.join(arena, &.{ "/lib", triple }));
+        try dirs.append(try fs.path.join(arena, &.{ "/usr/lib", triple }));
+    }
+    try dirs.appendSlice(&generic_library_dirs);
+    return dirs.items;
+}
+
+fn isCompatible(path: []const u8, ident: TargetIdent) bool {
+    const file = fs.cwd().openFile(path, .{}) catch return false;
+    defer file.close();
+    var bytes: [20]u8 = undefined;
+    const read = file.preadAll(&bytes, 0) catch return false;
+    const candidate = TargetIdent.fromBytes(bytes[0..read]) orelse return false;
+    return candidate.eql(ident);
+}
+
+fn expandOrigin(dir: []const u8, origin: []const u8, arena: mem.Allocator) ![]const u8 {
+    const braced = try mem.replaceOwned(u8, arena, dir, "${ORIGIN}", origin);
+    return mem.replaceOwned(u8, arena, braced, "$ORIGIN", origin);
+}
+
+fn findInPathList(
+    name: []const u8,
+    path_list_opt: ?[]const u8,
+    origin: []const u8,
+    ident: TargetIdent,
+    arena: mem.Allocator,
+) !?[]const u8 {
+    const path_list = path_list_opt orelse return null;
+    var it = mem.tokenize(u8, path_list, ":");
+    while (it.next()) |dir| {
+        const candidate = try fs.path.join(arena, &.{ try expandOrigin(dir, origin, arena), name });
+        if (isCompatible(candidate, ident)) {
+            return candidate;
+        }
+    }
+    return null;
+}
+
+// Same order as the dynamic loader: DT_RPATH only when there is no
+// DT_RUNPATH, then LD_LIBRARY_PATH, DT_RUNPATH and the default directories.
+// NOTE(radomski): The loader also inherits DT_RPATH of the loading objects,
+// we only look at the object's own.
+fn resolveLibrary(
+    name: []const u8,
+    dynamic: elf.DynamicInfo,
+    origin: []const u8,
+    ident: TargetIdent,
+    default_dirs: []const []const u8,
+    arena: mem.Allocator,
+) !?[]const u8 {
+    if (mem.indexOfScalar(u8, name, '/') != null) {
+        return if (isCompatible(name, ident)) name else null;
+    }
+
+    if (dynamic.runpath == null) {
+        if (try findInPathList(name, dynamic.rpath, origin, ident, arena)) |path| {
+            return path;
+        }
+    }
+    if (try findInPathList(name, std.os.getenv("LD_LIBRARY_PATH"), origin, ident, arena)) |path| {
+        return path;
+    }
+    if (try findInPathList(name, dynamic.runpath, origin, ident, arena)) |path| {
+        return path;
+    }
+    for (default_dirs) |dir| {
+        const candidate = try fs.path.join(arena, &.{ dir, name });
+        if (isCompatible(candidate, ident)) {
+            return candidate;
+        }
+    }
+    return null;
+}
+
+// Collects the binary and everything it transitively needs, breadth first,
+// every library once no matter how many objects depend on it.
+pub fn collectInputs(
+    file: fs.File,
+    path: []const u8,
+    inputs: *std.ArrayList(batch.Input),
+    arena: mem.Allocator,
+) !void {
+    const size = try file.getEndPos();
+    const data = try archive.mapFile(file, size);
+    const ident = TargetIdent.fromBytes(data) orelse return error.NotAnElf;
+    const default_dirs = try defaultLibraryDirs(data, arena);
+
+    var seen = std.StringHashMap(void).init(arena);
+    try seen.put(try fs.cwd().realpathAlloc(arena, path), {});
+    try inputs.append(.{ .name = path, .data = data });
+
+    var i: usize = 0;
+    while (i < inputs.items.len) : (i += 1) {
+        const input = inputs.items[i];
+        var buffer = Buffer{ .data = input.data };
+        const dynamic = elf.readDynamic(&buffer, arena) catch |err| {
+            std.log.warn("{s}: {s}", .{ input.name, @errorName(err) });
+            continue;
+        };
+        const real_path = try fs.cwd().realpathAlloc(arena, input.name);
+        const origin = fs.path.dirname(real_path) orelse ".";
+
+        for (dynamic.needed) |name| {
+            const lib_path = (try resolveLibrary(name, dynamic, origin, ident, default_dirs, arena)) orelse {
+                std.log.warn("{s}: {s} not found", .{ input.name, name });
+                continue;
+            };
+            const lib_real_path = try fs.cwd().realpathAlloc(arena, lib_path);
+            const gop = try seen.getOrPut(lib_real_path);
+            if (gop.found_existing) {
+                continue;
+            }
+
+            const lib_file = try fs.cwd().openFile(lib_real_path, .{});
+            defer lib_file.close();
+            const lib_size = try lib_file.getEndPos();
+            try inputs.append(.{ .name = lib_real_path, .data = try archive.mapFile(lib_file, lib_size) });
+        }
+    }
+}
+
+pub fn run(file: fs.File, path: []const u8, arena: mem.Allocator) !void {
+    var inputs = std.ArrayList(batch.Input).init(arena);
+    defer {
+        for (inputs.items) |input| {
+            std.os.munmap(@alignCast(mem.page_size, input.data));
+        }
+    }
+    try collectInputs(file, path, &inputs, arena);
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.BufferedWriter(16 * 1024, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
+
+    var timer = try std.time.Timer.start();
+    try batch.processInputs(inputs.items, bw.writer(), arena);
+    try bw.flush();
+    const ns = timer.read();
+    std.debug.print("Objects: {} (binary and libraries) in {}\n", .{ inputs.items.len, std.fmt.fmtDuration(ns) });
+}
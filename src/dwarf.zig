@@ -216,6 +216,10 @@ pub const DW_AT = enum(u8) {
     custom_non_spec = 0xff,
 };
 
+// Base type encodings, only signedness is kept
+pub const DW_ATE_signed = 0x05;
+pub const DW_ATE_signed_char = 0x06;
+
 pub const DW_FORM = enum(u8) {
     null = 0x00,
     addr = 0x01,
@@ -304,13 +308,14 @@ const CompilationUnit = struct {
     size: u8,
     dwarf_address_size: u8,
     address_size: u8,
-    payload_size: u32,
-    offset: u32,
+    payload_size: u64,
+    offset: u64,
     die_range: DieRange,
 };
 
 pub const Error = error{
     EndOfBuffer,
+    InvalidAbbrevCode,
 };
 
 const Self = @This();
@@ -327,9 +332,15 @@ binary_bitness: u8,
 debug_info: Buffer,
 debug_str: Buffer,
 debug_str_offsets: Buffer,
+// Only read for DW_AT_decl_file, empty unless set after init
+debug_line: Buffer = .{ .data = &[_]u8{} },
+debug_line_str: Buffer = .{ .data = &[_]u8{} },
+// Only read for DW_OP_addrx, empty unless set after init
+debug_addr: Buffer = .{ .data = &[_]u8{} },
+// DW_AT_addr_base of the current unit, set while reading its DIE
+addr_base: usize = 0,
 
-debug_info_address_stack: [64]usize,
-debug_info_address_stack_top: u32,
+debug_info_address_stack: std.ArrayList(usize),
 
 pub fn init(
     binary_bitness: u8,
@@ -352,14 +363,13 @@ pub fn init(
         .debug_str = debug_str,
         .debug_str_offsets = debug_str_offsets,
 
-        .debug_info_address_stack = undefined,
-        .debug_info_address_stack_top = 0,
+        .debug_info_address_stack = std.ArrayList(usize).init(allocator),
     };
 
     var debug_abbrev_offsets = std.ArrayList(u64).init(allocator);
     defer debug_abbrev_offsets.deinit();
 
-    d.pushAddress();
+    try d.pushAddress();
     while (d.debug_info.isGood()) {
         const start_pos = d.debug_info.curr_pos;
 
@@ -407,9 +417,9 @@ pub fn init(
         const payload_size = unit_length - (size - unit_length_size);
         const cu_offset = d.debug_info.curr_pos;
         const cu = CompilationUnit{
-            .payload_size = @intCast(u32, payload_size),
+            .payload_size = payload_size,
             .address_size = address_size,
-            .offset = @intCast(u32, cu_offset),
+            .offset = cu_offset,
             .size = size,
             .dwarf_address_size = @divExact(bitness, 8),
             .die_range = undefined,
@@ -485,6 +495,25 @@ pub fn init(
     return d;
 }
 
+// No units at all, for a Context whose tables are filled from BTF.
+pub fn initEmpty(binary_bitness: u8, allocator: std.mem.Allocator) Self {
+    return Self{
+        .dies = std.ArrayList(Die).init(allocator),
+        .attrs = std.ArrayList(Attr).init(allocator),
+        .attr_implicit_consts = std.AutoHashMap(AttrId, usize).init(allocator),
+        .attr_skips = std.ArrayList(AttrSkip).init(allocator),
+        .cus = std.ArrayList(CompilationUnit).init(allocator),
+        .current_cu = undefined,
+        .binary_bitness = binary_bitness,
+
+        .debug_info = Buffer{ .data = &[_]u8{} },
+        .debug_str = Buffer{ .data = &[_]u8{} },
+        .debug_str_offsets = Buffer{ .data = &[_]u8{} },
+
+        .debug_info_address_stack = std.ArrayList(usize).init(allocator),
+    };
+}
+
 pub fn generateAttrSkips(self: *Self, attrs: []Attr, machine_address_size: u8, dwarf_address_size: u8) !void {
     const SkipHelper = struct {
         last_skip: ?u16 = null,
@@ -604,6 +633,7 @@ pub fn generateAttrSkips(self: *Self, attrs: []Attr, machine_address_size: u8, d
 
 pub fn setCu(self: *Self, cu: CompilationUnit) void {
     self.current_cu = cu;
+    self.addr_base = 0;
     self.debug_info.curr_pos = cu.offset;
 }
 
@@ -641,7 +671,7 @@ pub fn skipFormData(self: *Self, form: DW_FORM) void {
         DW_FORM.addr => self.debug_info.advance(self.current_cu.address_size),
         DW_FORM.block2 => {
             const len = self.debug_info.consumeTypeUnchecked(u16);
-            self.debug_info.advance(@intCast(u32, len));
+            self.debug_info.advance(len);
         },
         DW_FORM.block4 => unreachable,
         DW_FORM.data2 => self.debug_info.advance(@sizeOf(u16)),
@@ -651,7 +681,7 @@ pub fn skipFormData(self: *Self, form: DW_FORM) void {
         DW_FORM.block => unreachable,
         DW_FORM.block1 => {
             const len = self.debug_info.consumeTypeUnchecked(u8);
-            _ = self.debug_info.advance(@intCast(u32, len));
+            self.debug_info.advance(len);
         },
         DW_FORM.data1 => self.debug_info.advance(@sizeOf(u8)),
         DW_FORM.flag => self.debug_info.advance(1),
@@ -672,7 +702,7 @@ pub fn skipFormData(self: *Self, form: DW_FORM) void {
         DW_FORM.sec_offset => self.debug_info.advance(self.current_cu.dwarf_address_size),
         DW_FORM.exprloc => {
             const len = readULEB128(&self.debug_info);
-            self.debug_info.advance(@intCast(u32, len));
+            self.debug_info.advance(len);
         },
         DW_FORM.flag_present => {},
         DW_FORM.strx => unreachable,
@@ -682,7 +712,7 @@ pub fn skipFormData(self: *Self, form: DW_FORM) void {
         DW_FORM.ref_sup4 => unreachable,
         DW_FORM.strp_sup => unreachable,
         DW_FORM.data16 => unreachable,
-        DW_FORM.line_strp => unreachable,
+        DW_FORM.line_strp => self.debug_info.advance(self.current_cu.dwarf_address_size),
         DW_FORM.ref_sig8 => unreachable,
         DW_FORM.implicit_const => {},
         DW_FORM.loclistx => unreachable,
@@ -713,7 +743,7 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
         },
         DW_FORM.block2 => {
             const len = self.debug_info.consumeTypeUnchecked(u16);
-            _ = self.debug_info.advance(@intCast(u32, len));
+            self.debug_info.advance(len);
         },
         DW_FORM.block4 => unreachable,
         DW_FORM.data2 => return self.debug_info.consumeTypeUnchecked(u16),
@@ -723,7 +753,7 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
         DW_FORM.block => unreachable,
         DW_FORM.block1 => {
             const len = self.debug_info.consumeTypeUnchecked(u8);
-            var slice_data = self.debug_info.consumeUnchecked(@intCast(u32, len));
+            var slice_data = self.debug_info.consumeUnchecked(len);
 
             var data = Buffer{ .data = slice_data };
             const op = data.consumeTypeUnchecked(u8);
@@ -738,7 +768,7 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
         DW_FORM.data1 => return self.debug_info.consumeTypeUnchecked(u8),
         DW_FORM.flag => unreachable,
         DW_FORM.sdata => return readULEB128(&self.debug_info),
-        DW_FORM.strp => {
+        DW_FORM.strp, DW_FORM.sec_offset, DW_FORM.line_strp => {
             if (self.current_cu.dwarf_address_size == @sizeOf(u64)) {
                 return @intCast(usize, (self.debug_info.consumeTypeUnchecked(u64)));
             } else if (self.current_cu.dwarf_address_size == @sizeOf(u32)) {
@@ -755,10 +785,9 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
         DW_FORM.ref8 => return self.debug_info.consumeTypeUnchecked(u64),
         DW_FORM.ref_udata => unreachable,
         DW_FORM.indirect => unreachable,
-        DW_FORM.sec_offset => unreachable,
         DW_FORM.exprloc => {
             const len = readULEB128(&self.debug_info);
-            self.debug_info.advance(@intCast(u32, len));
+            self.debug_info.advance(len);
         },
         DW_FORM.flag_present => {},
         DW_FORM.strx => unreachable,
@@ -766,7 +795,6 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
         DW_FORM.ref_sup4 => unreachable,
         DW_FORM.strp_sup => unreachable,
         DW_FORM.data16 => unreachable,
-        DW_FORM.line_strp => unreachable,
         DW_FORM.ref_sig8 => unreachable,
         DW_FORM.implicit_const => return self.attr_implicit_consts.get(@intCast(u24, attr_id + 1)) orelse unreachable,
         DW_FORM.loclistx => unreachable,
@@ -784,10 +812,117 @@ pub fn readFormData(self: *Self, form: DW_FORM, attr_id: usize) !usize {
     return 0;
 }
 
+const DW_OP_plus_uconst = 0x23;
+
+// DW_AT_data_member_location, null for an expression that isn't a constant
+// offset, like the vtable lookup locating a virtual base.
+pub fn readMemberLocation(self: *Self, form: DW_FORM, attr_id: usize) !?usize {
+    const len: usize = switch (form) {
+        .exprloc, .block => readULEB128(&self.debug_info),
+        .block1 => self.debug_info.consumeTypeUnchecked(u8),
+        .block2 => self.debug_info.consumeTypeUnchecked(u16),
+        .block4 => self.debug_info.consumeTypeUnchecked(u32),
+        else => return try self.readFormData(form, attr_id),
+    };
+    var expr = Buffer{ .data = self.debug_info.consume(len) orelse return Error.EndOfBuffer };
+    const op = expr.consumeType(u8) orelse return null;
+    if (op != DW_OP_plus_uconst) {
+        return null;
+    }
+    const offset = readULEB128(&expr);
+    return if (expr.curr_pos == expr.data.len) offset else null;
+}
+
+const DW_OP_addr = 0x03;
+const DW_OP_const1u = 0x08;
+const DW_OP_const2u = 0x0a;
+const DW_OP_const4u = 0x0c;
+const DW_OP_const8u = 0x0e;
+const DW_OP_constu = 0x10;
+const DW_OP_form_tls_address = 0x9b;
+const DW_OP_addrx = 0xa1;
+const DW_OP_constx = 0xa2;
+const DW_OP_GNU_push_tls_address = 0xe0;
+
+pub const Storage = enum {
+    none,
+    global,
+    tls,
+};
+
+pub const Location = struct {
+    storage: Storage = .none,
+    // Of a global, null if it can't be read
+    address: ?u64 = null,
+};
+
+// DW_AT_location of a variable, a static address or an offset into the
+// thread's TLS block. Anything else, a location list or a register or frame
+// based expression, is a local and comes back as none.
+pub fn readVariableLocation(self: *Self, form: DW_FORM) !Location {
+    const len: usize = switch (form) {
+        .exprloc, .block => readULEB128(&self.debug_info),
+        .block1 => self.debug_info.consumeTypeUnchecked(u8),
+        .block2 => self.debug_info.consumeTypeUnchecked(u16),
+        .block4 => self.debug_info.consumeTypeUnchecked(u32),
+        else => {
+            self.skipFormData(form);
+            return Location{};
+        },
+    };
+    var expr = Buffer{ .data = self.debug_info.consume(len) orelse return Error.EndOfBuffer };
+    var location = Location{};
+    while (expr.consumeType(u8)) |op| {
+        const operand_size: usize = switch (op) {
+            DW_OP_addr => self.getPointerSize(),
+            DW_OP_const1u => 1,
+            DW_OP_const2u => 2,
+            DW_OP_const4u => 4,
+            DW_OP_const8u => 8,
+            DW_OP_addrx, DW_OP_constu, DW_OP_constx => {
+                const index = readULEB128(&expr);
+                if (op == DW_OP_addrx) {
+                    location = .{ .storage = .global, .address = self.readIndexedAddress(index) };
+                }
+                continue;
+            },
+            // NOTE(radomski): The operand pushed before is the offset in the
+            // module's TLS block, whatever it was
+            DW_OP_form_tls_address, DW_OP_GNU_push_tls_address => return Location{ .storage = .tls },
+            else => return Location{},
+        };
+        const operand = expr.consume(operand_size) orelse return Location{};
+        if (op == DW_OP_addr) {
+            location = .{ .storage = .global, .address = readAddress(operand) };
+        }
+    }
+    return location;
+}
+
+fn readAddress(bytes: []const u8) ?u64 {
+    return switch (bytes.len) {
+        4 => std.mem.readIntNative(u32, bytes[0..4]),
+        8 => std.mem.readIntNative(u64, bytes[0..8]),
+        else => null,
+    };
+}
+
+// Entry of .debug_addr at index, counted from the unit's DW_AT_addr_base
+pub fn readIndexedAddress(self: *Self, index: usize) ?u64 {
+    const size = self.getPointerSize();
+    const start = self.addr_base + index * size;
+    if (start > self.debug_addr.data.len or self.debug_addr.data.len - start < size) {
+        return null;
+    }
+    return readAddress(self.debug_addr.data[start .. start + size]);
+}
+
 pub fn readString(self: *Self, form: DW_FORM, attr_id: usize) ![]const u8 {
     if (form == DW_FORM.strp) {
         const name_addr = try self.readFormData(form, attr_id);
         return self.readOffsetString(name_addr);
+    } else if (form == DW_FORM.line_strp) {
+        return readCString(self.debug_line_str, try self.readFormData(form, attr_id));
     } else if (form == DW_FORM.string) {
         return self.readFormString();
     } else {
@@ -796,6 +931,25 @@ pub fn readString(self: *Self, form: DW_FORM, attr_id: usize) ![]const u8 {
     }
 }
 
+pub const StringRef = union(enum) {
+    // Offset into .debug_str, the string itself wasn't read yet
+    offset: usize,
+    bytes: []const u8,
+};
+
+// Same as readString except .debug_str isn't touched, strp and strx forms are
+// only turned into an offset to be read whenever the string is needed.
+pub fn readStringRef(self: *Self, form: DW_FORM, attr_id: usize) !StringRef {
+    if (form == DW_FORM.strp) {
+        return StringRef{ .offset = try self.readFormData(form, attr_id) };
+    } else if (form == DW_FORM.string) {
+        return StringRef{ .bytes = try self.readFormString() };
+    } else {
+        const offset_index = try self.readFormData(form, attr_id);
+        return StringRef{ .offset = try self.readStringOffset(offset_index) };
+    }
+}
+
 pub fn readFormString(self: *Self) ![]const u8 {
     return self.debug_info.consumeUntil(0) orelse return Error.EndOfBuffer;
 }
@@ -806,6 +960,12 @@ pub fn readOffsetString(self: *Self, addr: usize) ![]const u8 {
 }
 
 pub fn readOffsetIndexedString(self: *Self, index: usize) ![]const u8 {
+    const address = try self.readStringOffset(index);
+    const name = try self.readOffsetString(address);
+    return name;
+}
+
+pub fn readStringOffset(self: *Self, index: usize) !usize {
     const size = self.current_cu.dwarf_address_size * 2;
     self.debug_str_offsets.curr_pos = index * self.current_cu.dwarf_address_size + size;
 
@@ -819,8 +979,146 @@ pub fn readOffsetIndexedString(self: *Self, index: usize) ![]const u8 {
         }
     };
 
-    const name = try self.readOffsetString(address);
-    return name;
+    return address;
+}
+
+fn readCString(buffer: Buffer, offset: usize) ![]const u8 {
+    if (offset >= buffer.data.len) {
+        return Error.EndOfBuffer;
+    }
+    const end = std.mem.indexOfScalarPos(u8, buffer.data, offset, 0) orelse return Error.EndOfBuffer;
+    return buffer.data[offset..end];
+}
+
+const DW_LNCT_path = 0x1;
+const DW_LNCT_directory_index = 0x2;
+
+const LineValue = union(enum) {
+    string: []const u8,
+    number: u64,
+};
+
+fn readLineValue(self: *Self, b: *Buffer, form: DW_FORM, offset_size: u8) !LineValue {
+    switch (form) {
+        .string => return LineValue{ .string = b.consumeUntil(0) orelse return Error.EndOfBuffer },
+        .line_strp, .strp => {
+            const offset = if (offset_size == 8)
+                b.consumeType(u64) orelse return Error.EndOfBuffer
+            else
+                b.consumeType(u32) orelse return Error.EndOfBuffer;
+            const buffer = if (form == .line_strp) self.debug_line_str else self.debug_str;
+            return LineValue{ .string = try readCString(buffer, @intCast(usize, offset)) };
+        },
+        .udata => return LineValue{ .number = readULEB128(b) },
+        .data1 => return LineValue{ .number = b.consumeType(u8) orelse return Error.EndOfBuffer },
+        .data2 => return LineValue{ .number = b.consumeType(u16) orelse return Error.EndOfBuffer },
+        .data4 => return LineValue{ .number = b.consumeType(u32) orelse return Error.EndOfBuffer },
+        .data8 => return LineValue{ .number = b.consumeType(u64) orelse return Error.EndOfBuffer },
+        .data16 => {
+            _ = b.consume(16) orelse return Error.EndOfBuffer;
+            return LineValue{ .number = 0 };
+        },
+        .block => {
+            const len = readULEB128(b);
+            _ = b.consume(len) orelse return Error.EndOfBuffer;
+            return LineValue{ .number = 0 };
+        },
+        else => return Error.EndOfBuffer,
+    }
+}
+
+// Directory of every file in the line table at stmt_list, indexed like
+// DW_AT_decl_file. Relative directories are joined to comp_dir.
+pub fn readLineFileDirs(self: *Self, stmt_list: usize, comp_dir: []const u8, allocator: std.mem.Allocator) ![][]const u8 {
+    var b = Buffer{ .data = self.debug_line.data, .curr_pos = stmt_list };
+    var offset_size: u8 = 4;
+    if ((b.consumeType(u32) orelse return Error.EndOfBuffer) == std.math.maxInt(u32)) {
+        offset_size = 8;
+        _ = b.consumeType(u64) orelse return Error.EndOfBuffer;
+    }
+    const version = b.consumeType(u16) orelse return Error.EndOfBuffer;
+    if (version >= 5) {
+        _ = b.consume(2) orelse return Error.EndOfBuffer; // address_size, segment_selector_size
+    }
+    _ = b.consume(offset_size) orelse return Error.EndOfBuffer; // header_length
+    // minimum_instruction_length, [maximum_operations_per_instruction],
+    // default_is_stmt, line_base, line_range
+    _ = b.consume(if (version >= 4) 5 else 4) orelse return Error.EndOfBuffer;
+    const opcode_base = b.consumeType(u8) orelse return Error.EndOfBuffer;
+    _ = b.consume(opcode_base -| 1) orelse return Error.EndOfBuffer;
+
+    var dirs = std.ArrayList([]const u8).init(allocator);
+    var file_dirs = std.ArrayList([]const u8).init(allocator);
+    if (version < 5) {
+        // Index 0 is the compilation directory, files are numbered from 1
+        try dirs.append(comp_dir);
+        while (true) {
+            const dir = b.consumeUntil(0) orelse return Error.EndOfBuffer;
+            if (dir.len == 0) {
+                break;
+            }
+            try dirs.append(dir);
+        }
+
+        try file_dirs.append(comp_dir);
+        while (true) {
+            const name = b.consumeUntil(0) orelse return Error.EndOfBuffer;
+            if (name.len == 0) {
+                break;
+            }
+            const dir_index = readULEB128(&b);
+            _ = readULEB128(&b); // modification time
+            _ = readULEB128(&b); // length
+            const dir = if (dir_index < dirs.items.len) dirs.items[dir_index] else comp_dir;
+            const full = try std.fs.path.join(allocator, &.{ dir, name });
+            try file_dirs.append(std.fs.path.dirname(full) orelse dir);
+        }
+    } else {
+        var table: usize = 0;
+        while (table < 2) : (table += 1) {
+            var formats: [16][2]usize = undefined;
+            const format_count = b.consumeType(u8) orelse return Error.EndOfBuffer;
+            if (format_count > formats.len) {
+                return Error.EndOfBuffer;
+            }
+            for (formats[0..format_count]) |*format| {
+                format[0] = readULEB128(&b);
+                format[1] = readULEB128(&b);
+            }
+
+            const count = readULEB128(&b);
+            var i: usize = 0;
+            while (i < count) : (i += 1) {
+                var path: []const u8 = "";
+                var dir_index: u64 = 0;
+                for (formats[0..format_count]) |format| {
+                    const value = try self.readLineValue(&b, @intToEnum(DW_FORM, @intCast(u8, format[1])), offset_size);
+                    switch (format[0]) {
+                        DW_LNCT_path => path = if (value == .string) value.string else "",
+                        DW_LNCT_directory_index => dir_index = if (value == .number) value.number else 0,
+                        else => {},
+                    }
+                }
+
+                if (table == 0) {
+                    try dirs.append(if (std.fs.path.isAbsolute(path)) path else try std.fs.path.join(allocator, &.{ comp_dir, path }));
+                } else {
+                    const dir = if (dir_index < dirs.items.len) dirs.items[dir_index] else comp_dir;
+                    const full = try std.fs.path.join(allocator, &.{ dir, path });
+                    try file_dirs.append(std.fs.path.dirname(full) orelse dir);
+                }
+            }
+        }
+    }
+
+    // NOTE(radomski): Before version 5 include directories are relative to
+    // comp_dir, they are only made absolute here
+    for (file_dirs.items) |*dir| {
+        if (!std.fs.path.isAbsolute(dir.*)) {
+            dir.* = try std.fs.path.join(allocator, &.{ comp_dir, dir.* });
+        }
+    }
+    return file_dirs.items;
 }
 
 pub fn readDieIdAtAddress(self: *Self, global_addr: usize) !?DieId {
@@ -831,32 +1129,54 @@ pub fn readDieIdAtAddress(self: *Self, global_addr: usize) !?DieId {
         if (code == 0) {
             return null;
         }
+        if (code > self.current_cu.die_range.len()) {
+            return Error.InvalidAbbrevCode;
+        }
         return self.current_cu.die_range.start + @intCast(DieId, code) - 1;
     }
 
     return Error.EndOfBuffer;
 }
 
+// NOTE(radomski): Iterative, the depth only counts the children lists that
+// are still open, so arbitrarily deep subtrees don't use any native stack.
 pub fn skipDieAndChildren(self: *Self, die_id: DieId) !void {
-    const die = self.dies.items[die_id];
-    if (die.sibling_attr_index != std.math.maxInt(@TypeOf(die.sibling_attr_index))) {
-        var i: u8 = 0;
-        const attrs = self.getAttrs(die.attr_range);
-        while (i < die.sibling_attr_index) : (i += 1) {
-            self.skipFormData(attrs[i].form);
-        }
-        const attr = attrs[die.sibling_attr_index];
-        const address = @intCast(u32, try self.readFormData(attr.form, die.attr_range.start + die.sibling_attr_index));
-        const global_address = self.toGlobalAddr(address);
-        self.debug_info.curr_pos = global_address;
-    } else {
-        self.skipDieAttrs(die_id);
-        if (die.has_children == true) {
-            while (self.readNextDie()) |global_addr| {
-                const inner_die_id = try self.readDieIdAtAddress(global_addr) orelse break;
-                try self.skipDieAndChildren(inner_die_id);
+    var depth: usize = 0;
+    var current_die_id = die_id;
+    while (true) {
+        const die = self.dies.items[current_die_id];
+        if (die.sibling_attr_index != std.math.maxInt(@TypeOf(die.sibling_attr_index))) {
+            var i: u8 = 0;
+            const attrs = self.getAttrs(die.attr_range);
+            while (i < die.sibling_attr_index) : (i += 1) {
+                self.skipFormData(attrs[i].form);
+            }
+            const attr = attrs[die.sibling_attr_index];
+            const address = try self.readFormData(attr.form, die.attr_range.start + die.sibling_attr_index);
+            const global_address = self.toGlobalAddr(address);
+            self.debug_info.curr_pos = global_address;
+        } else {
+            self.skipDieAttrs(current_die_id);
+            if (die.has_children == true) {
+                depth += 1;
             }
         }
+
+        current_die_id = while (depth > 0) {
+            const global_addr = self.readNextDie() orelse return;
+            if (try self.readDieIdAtAddress(global_addr)) |inner_die_id| {
+                break inner_die_id;
+            }
+            depth -= 1;
+        } else return;
+    }
+}
+
+// Skips the children of a DIE whose attributes were just read.
+pub fn skipChildren(self: *Self) !void {
+    while (self.readNextDie()) |global_addr| {
+        const die_id = try self.readDieIdAtAddress(global_addr) orelse return;
+        try self.skipDieAndChildren(die_id);
     }
 }
 
@@ -898,40 +1218,30 @@ pub fn skipDieAttrs(self: *Self, die_id: DieId) void {
             .skip_c_string => self.debug_info.advanceUntil(0),
             .read_u8_len_and_skip => {
                 const len = self.debug_info.consumeTypeUnchecked(u8);
-                _ = self.debug_info.advance(@intCast(u32, len));
+                self.debug_info.advance(len);
             },
             .read_u16_len_and_skip => {
                 const len = self.debug_info.consumeTypeUnchecked(u16);
-                _ = self.debug_info.advance(@intCast(u32, len));
+                self.debug_info.advance(len);
             },
             .read_u32_len_and_skip => {
                 const len = self.debug_info.consumeTypeUnchecked(u32);
-                _ = self.debug_info.advance(len);
+                self.debug_info.advance(len);
             },
             .read_uleb_len_and_skip => {
                 const len = readULEB128(&self.debug_info);
-                _ = self.debug_info.advance(len);
+                self.debug_info.advance(len);
             },
         }
     }
 }
 
-pub fn pushAddress(self: *Self) void {
-    if (self.debug_info_address_stack_top >= self.debug_info_address_stack.len) {
-        unreachable;
-    }
-
-    self.debug_info_address_stack[self.debug_info_address_stack_top] = self.debug_info.curr_pos;
-    self.debug_info_address_stack_top += 1;
+pub fn pushAddress(self: *Self) !void {
+    try self.debug_info_address_stack.append(self.debug_info.curr_pos);
 }
 
 pub fn popAddress(self: *Self) void {
-    if (self.debug_info_address_stack_top <= 0) {
-        unreachable;
-    }
-
-    self.debug_info_address_stack_top -= 1;
-    self.debug_info.curr_pos = self.debug_info_address_stack[self.debug_info_address_stack_top];
+    self.debug_info.curr_pos = self.debug_info_address_stack.pop();
 }
 
 pub fn readULEB128(b: *Buffer) usize {
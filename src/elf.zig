@@ -46,90 +46,341 @@ pub fn ELFSectionHeader(comptime T: type) type {
     };
 }
 
-const ELFRelocationType = enum(u32) {
-    R_X86_64_NONE = 0,
-    R_X86_64_64 = 1,
-    R_X86_64_PC32 = 2,
-    R_X86_64_GOT32 = 3,
-    R_X86_64_PLT32 = 4,
-    R_X86_64_COPY = 5,
-    R_X86_64_GLOB_DAT = 6,
-    R_X86_64_JUMP_SLOT = 7,
-    R_X86_64_RELATIVE = 8,
-    R_X86_64_GOTPCREL = 9,
-    R_X86_64_32 = 10,
-    R_X86_64_32S = 11,
-    R_X86_64_16 = 12,
-    R_X86_64_PC16 = 13,
-    R_X86_64_8 = 14,
-    R_X86_64_PC8 = 15,
-    R_X86_64_DTPMOD64 = 16,
-    R_X86_64_DTPOFF64 = 17,
-    R_X86_64_TPOFF64 = 18,
-    R_X86_64_TLSGD = 19,
-    R_X86_64_TLSLD = 20,
-    R_X86_64_DTPOFF32 = 21,
-    R_X86_64_GOTTPOFF = 22,
-    R_X86_64_TPOFF32 = 23,
-    R_X86_64_PC64 = 24,
-    R_X86_64_GOTOFF64 = 25,
-    R_X86_64_GOTPC32 = 26,
-    R_X86_64_GOT64 = 27,
-    R_X86_64_GOTPCREL64 = 28,
-    R_X86_64_GOTPC64 = 29,
-    R_X86_64_GOTPLT64 = 30,
-    R_X86_64_PLTOFF64 = 31,
-    R_X86_64_SIZE32 = 32,
-    R_X86_64_SIZE64 = 33,
-    R_X86_64_GOTPC32_TLSDESC = 34,
-    R_X86_64_TLSDESC_CALL = 35,
-    R_X86_64_TLSDESC = 36,
-    R_X86_64_IRELATIVE = 37,
-    R_X86_64_RELATIVE64 = 38,
-    R_X86_64_GOTPCRELX = 41,
-    R_X86_64_REX_GOTPCRELX = 42,
-    R_X86_64_NUM = 43,
+pub fn ELFSymbol(comptime T: type) type {
+    if (T == u64) {
+        return extern struct {
+            st_name: u32,
+            st_info: u8,
+            st_other: u8,
+            st_shndx: u16,
+            st_value: u64,
+            st_size: u64,
+        };
+    } else {
+        return extern struct {
+            st_name: u32,
+            st_value: u32,
+            st_size: u32,
+            st_info: u8,
+            st_other: u8,
+            st_shndx: u16,
+        };
+    }
+}
+
+pub fn ELFRelocation(comptime T: type) type {
+    return extern struct {
+        r_offset: T,
+        r_info: T,
+    };
+}
+
+pub fn ELFRelocationA(comptime T: type) type {
+    return extern struct {
+        r_offset: T,
+        r_info: T,
+        r_addend: std.meta.Int(.signed, @bitSizeOf(T)),
+    };
+}
+
+fn relocationSymbol(comptime T: type, r_info: T) u64 {
+    return if (T == u64) r_info >> 32 else r_info >> 8;
+}
+
+fn relocationType(comptime T: type, r_info: T) u32 {
+    return if (T == u64) @truncate(u32, r_info) else @truncate(u8, r_info);
+}
+
+pub const Error = error{
+    UnsupportedMachine,
+    UnsupportedRelocation,
+    MalformedRelocation,
+    MalformedDynamic,
+    MalformedHeader,
+    NotElf,
+};
+
+const SHT_RELA = 4;
+const SHT_REL = 9;
+
+pub const EM_386 = 3;
+pub const EM_ARM = 40;
+pub const EM_X86_64 = 62;
+pub const EM_AARCH64 = 183;
+pub const EM_RISCV = 243;
+
+const RelocationOp = enum {
+    none,
+    set,
+    add,
+    sub,
 };
 
-const ELFSymbol = struct {
-    st_name: u32,
-    st_info: u8,
-    st_other: u8,
-    st_shndx: u16,
-    st_value: u64,
-    st_size: u64,
+const RelocationRule = struct {
+    r_type: u32,
+    op: RelocationOp,
+    width: u8 = 0,
 };
 
-const ELFRelocation = struct {
-    r_offset: usize,
-    r_info: u64,
+const MachineRelocations = struct {
+    machine: u16,
+    rules: []const RelocationRule,
 };
 
-const ELFRelocationA = struct {
-    r_offset: usize,
-    r_info: u64,
-    r_addend: i64,
-    const Self = @This();
+// NOTE(radomski): Only the relocations compilers put into debug sections.
+// Every one of them resolves to S + A; RISC-V also describes label differences
+// with add/sub pairs applied to the same location.
+const relocation_table = [_]MachineRelocations{
+    .{ .machine = EM_X86_64, .rules = &[_]RelocationRule{
+        .{ .r_type = 0, .op = .none }, // R_X86_64_NONE
+        .{ .r_type = 1, .op = .set, .width = 8 }, // R_X86_64_64
+        .{ .r_type = 10, .op = .set, .width = 4 }, // R_X86_64_32
+        .{ .r_type = 11, .op = .set, .width = 4 }, // R_X86_64_32S
+        .{ .r_type = 17, .op = .set, .width = 8 }, // R_X86_64_DTPOFF64
+        .{ .r_type = 21, .op = .set, .width = 4 }, // R_X86_64_DTPOFF32
+    } },
+    .{ .machine = EM_386, .rules = &[_]RelocationRule{
+        .{ .r_type = 0, .op = .none }, // R_386_NONE
+        .{ .r_type = 1, .op = .set, .width = 4 }, // R_386_32
+        .{ .r_type = 32, .op = .set, .width = 4 }, // R_386_TLS_LDO_32
+    } },
+    .{ .machine = EM_ARM, .rules = &[_]RelocationRule{
+        .{ .r_type = 0, .op = .none }, // R_ARM_NONE
+        .{ .r_type = 2, .op = .set, .width = 4 }, // R_ARM_ABS32
+        .{ .r_type = 106, .op = .set, .width = 4 }, // R_ARM_TLS_LDO32
+    } },
+    .{ .machine = EM_AARCH64, .rules = &[_]RelocationRule{
+        .{ .r_type = 0, .op = .none }, // R_AARCH64_NONE
+        .{ .r_type = 257, .op = .set, .width = 8 }, // R_AARCH64_ABS64
+        .{ .r_type = 258, .op = .set, .width = 4 }, // R_AARCH64_ABS32
+        .{ .r_type = 259, .op = .set, .width = 2 }, // R_AARCH64_ABS16
+        .{ .r_type = 1029, .op = .set, .width = 8 }, // R_AARCH64_TLS_DTPREL64
+    } },
+    .{ .machine = EM_RISCV, .rules = &[_]RelocationRule{
+        .{ .r_type = 0, .op = .none }, // R_RISCV_NONE
+        .{ .r_type = 1, .op = .set, .width = 4 }, // R_RISCV_32
+        .{ .r_type = 2, .op = .set, .width = 8 }, // R_RISCV_64
+        .{ .r_type = 33, .op = .add, .width = 1 }, // R_RISCV_ADD8
+        .{ .r_type = 34, .op = .add, .width = 2 }, // R_RISCV_ADD16
+        .{ .r_type = 35, .op = .add, .width = 4 }, // R_RISCV_ADD32
+        .{ .r_type = 36, .op = .add, .width = 8 }, // R_RISCV_ADD64
+        .{ .r_type = 37, .op = .sub, .width = 1 }, // R_RISCV_SUB8
+        .{ .r_type = 38, .op = .sub, .width = 2 }, // R_RISCV_SUB16
+        .{ .r_type = 39, .op = .sub, .width = 4 }, // R_RISCV_SUB32
+        .{ .r_type = 40, .op = .sub, .width = 8 }, // R_RISCV_SUB64
+        .{ .r_type = 51, .op = .none }, // R_RISCV_RELAX
+        .{ .r_type = 54, .op = .set, .width = 1 }, // R_RISCV_SET8
+        .{ .r_type = 55, .op = .set, .width = 2 }, // R_RISCV_SET16
+        .{ .r_type = 56, .op = .set, .width = 4 }, // R_RISCV_SET32
+    } },
+};
+
+fn machineRelocationRules(machine: u16) ?[]const RelocationRule {
+    for (relocation_table) |entry| {
+        if (entry.machine == machine) {
+            return entry.rules;
+        }
+    }
+    return null;
+}
+
+fn findRelocationRule(rules: []const RelocationRule, r_type: u32) ?RelocationRule {
+    for (rules) |rule| {
+        if (rule.r_type == r_type) {
+            return rule;
+        }
+    }
+    return null;
+}
+
+fn readLocation(location: []const u8) u64 {
+    return switch (location.len) {
+        1 => location[0],
+        2 => mem.readIntLittle(u16, location[0..2]),
+        4 => mem.readIntLittle(u32, location[0..4]),
+        8 => mem.readIntLittle(u64, location[0..8]),
+        else => unreachable,
+    };
+}
 
-    pub fn symbolIndex(s: Self) u64 {
-        return s.r_info >> 32;
+fn writeLocation(location: []u8, value: u64) void {
+    switch (location.len) {
+        1 => location[0] = @truncate(u8, value),
+        2 => mem.writeIntLittle(u16, location[0..2], @truncate(u16, value)),
+        4 => mem.writeIntLittle(u32, location[0..4], @truncate(u32, value)),
+        8 => mem.writeIntLittle(u64, location[0..8], value),
+        else => unreachable,
     }
+}
+
+fn applyRelocations(
+    comptime T: type,
+    comptime R: type,
+    target: []u8,
+    entries: []align(1) const R,
+    symtab: []align(1) const ELFSymbol(T),
+    rules: []const RelocationRule,
+) Error!void {
+    // NOTE(radomski): A debug section is usually relocated with one or two
+    // types, remember the last rule instead of searching the table every time.
+    var last_rule = rules[0];
+    for (entries) |r| {
+        const r_type = relocationType(T, r.r_info);
+        const rule = if (r_type == last_rule.r_type) last_rule else findRelocationRule(rules, r_type) orelse return Error.UnsupportedRelocation;
+        last_rule = rule;
+        if (rule.op == .none) {
+            continue;
+        }
+
+        const symbol_index = relocationSymbol(T, r.r_info);
+        if (symbol_index >= symtab.len or r.r_offset > target.len or target.len - r.r_offset < rule.width) {
+            return Error.MalformedRelocation;
+        }
 
-    pub fn relocationType(s: Self) ELFRelocationType {
-        return @intToEnum(ELFRelocationType, @truncate(u32, s.r_info));
+        const location = target[r.r_offset .. r.r_offset + rule.width];
+        const current = readLocation(location);
+        // NOTE(radomski): REL keeps the addend at the location itself
+        const addend = if (@hasField(R, "r_addend")) @bitCast(u64, @as(i64, r.r_addend)) else current;
+        const value = @as(u64, symtab[symbol_index].st_value) +% addend;
+        writeLocation(location, switch (rule.op) {
+            .set => value,
+            .add => current +% value,
+            .sub => current -% value,
+            .none => unreachable,
+        });
     }
+}
+
+fn RelocationJob(comptime T: type, comptime R: type) type {
+    return struct {
+        target: []u8,
+        entries: []align(1) const R,
+        symtab: []align(1) const ELFSymbol(T),
+        rules: []const RelocationRule,
+        err: ?Error = null,
+
+        fn run(job: *@This()) void {
+            applyRelocations(T, R, job.target, job.entries, job.symtab, job.rules) catch |err| {
+                job.err = err;
+            };
+        }
+    };
+}
+
+const max_relocation_threads = 64;
+
+// When relocation sections are split across threads, see relocateEntries
+pub const RelocationSplit = struct {
+    // Sections with fewer entries are relocated on the calling thread, null
+    // never splits
+    threshold: ?usize = 64 * 1024,
+    entries_per_thread: usize = 32 * 1024,
+    // Every core when null, at most max_relocation_threads
+    threads: ?usize = null,
 };
 
+// NOTE(radomski): Per thread, batch workers turn splitting off. Every core
+// already parses an input of its own there.
+pub threadlocal var relocation_split = RelocationSplit{};
+
+// Ends of the ranges entries are split into, one per element of ends. An end
+// moves past entries sharing an r_offset with the one before it, RISC-V
+// add/sub pairs then stay in one range.
+fn splitRelocationRanges(comptime R: type, entries: []align(1) const R, ends: []usize) void {
+    var start: usize = 0;
+    for (ends) |*end, i| {
+        var e = if (i + 1 == ends.len) entries.len else @maximum(start, (i + 1) * entries.len / ends.len);
+        while (e < entries.len and e > start and entries[e].r_offset == entries[e - 1].r_offset) {
+            e += 1;
+        }
+        end.* = e;
+        start = e;
+    }
+}
+
+// Big relocation sections are split into ranges relocated on their own
+// threads. Relocations never overlap except RISC-V add/sub pairs, which are
+// kept in the same range.
+fn relocateEntries(
+    comptime T: type,
+    comptime R: type,
+    target: []u8,
+    entries: []align(1) const R,
+    symtab: []align(1) const ELFSymbol(T),
+    rules: []const RelocationRule,
+    split: RelocationSplit,
+) Error!void {
+    const threshold = split.threshold orelse return applyRelocations(T, R, target, entries, symtab, rules);
+    const max_threads = split.threads orelse (std.Thread.getCpuCount() catch 1);
+    const thread_count = @minimum(@minimum(max_threads, max_relocation_threads), entries.len / @maximum(split.entries_per_thread, 1));
+    if (entries.len < threshold or thread_count <= 1) {
+        return applyRelocations(T, R, target, entries, symtab, rules);
+    }
+
+    var ends: [max_relocation_threads]usize = undefined;
+    splitRelocationRanges(R, entries, ends[0..thread_count]);
+
+    const Job = RelocationJob(T, R);
+    var jobs: [max_relocation_threads]Job = undefined;
+    var threads: [max_relocation_threads]?std.Thread = undefined;
+    var start: usize = 0;
+    for (jobs[0..thread_count]) |*job, i| {
+        job.* = .{ .target = target, .entries = entries[start..ends[i]], .symtab = symtab, .rules = rules };
+        start = ends[i];
+    }
+
+    for (jobs[1..thread_count]) |*job, i| {
+        threads[i] = std.Thread.spawn(.{}, Job.run, .{job}) catch null;
+        if (threads[i] == null) {
+            job.run();
+        }
+    }
+    jobs[0].run();
+    for (threads[0 .. thread_count - 1]) |thread_opt| {
+        if (thread_opt) |thread| {
+            thread.join();
+        }
+    }
+
+    for (jobs[0..thread_count]) |job| {
+        if (job.err) |err| {
+            return err;
+        }
+    }
+}
+
+pub fn relocateBuffer(
+    comptime T: type,
+    machine: u16,
+    buffer: Buffer,
+    rel_buff: Buffer,
+    is_rela: bool,
+    symtab_buff: Buffer,
+) Error!void {
+    const rules = machineRelocationRules(machine) orelse return Error.UnsupportedMachine;
+    const symtab = mem.bytesAsSlice(ELFSymbol(T), symtab_buff.data);
+    if (is_rela) {
+        const entries = mem.bytesAsSlice(ELFRelocationA(T), rel_buff.data);
+        try relocateEntries(T, ELFRelocationA(T), buffer.data, entries, symtab, rules, relocation_split);
+    } else {
+        const entries = mem.bytesAsSlice(ELFRelocation(T), rel_buff.data);
+        try relocateEntries(T, ELFRelocation(T), buffer.data, entries, symtab, rules, relocation_split);
+    }
+}
+
 const ELFDebugSections = struct {
     binary_bitness: u8,
     debug_abbrev: Buffer,
     debug_info: Buffer,
     debug_str: Buffer,
     debug_str_offsets: Buffer,
+    debug_line: Buffer,
+    debug_line_str: Buffer,
+    debug_addr: Buffer,
 };
 
-const ELF_32BIT_CLASS = 1;
-const ELF_64BIT_CLASS = 2;
+pub const ELF_32BIT_CLASS = 1;
+pub const ELF_64BIT_CLASS = 2;
 
 pub fn getSectionBuffer(
     comptime T: type,
@@ -140,7 +391,7 @@ pub fn getSectionBuffer(
     if (sh_bufferi_opt) |sh_bufferi| {
         const sh_buffer = section_headers[sh_bufferi];
         file_buffer.curr_pos = sh_buffer.sh_offset;
-        var sbuffer = file_buffer.consume(@intCast(u32, sh_buffer.sh_size)) orelse unreachable;
+        var sbuffer = file_buffer.consume(sh_buffer.sh_size) orelse unreachable;
         var buffer = Buffer{ .data = sbuffer, .curr_pos = 0 };
         return buffer;
     } else {
@@ -148,29 +399,6 @@ pub fn getSectionBuffer(
     }
 }
 
-pub fn relocateBuffer(buffer: Buffer, rela_buff: *Buffer, symtab_buff: *Buffer) void {
-    const rela = mem.bytesAsSlice(ELFRelocationA, rela_buff.data);
-    const symtab = mem.bytesAsSlice(ELFSymbol, symtab_buff.data);
-
-    for (rela) |r| {
-        switch (r.relocationType()) {
-            ELFRelocationType.R_X86_64_64 => {
-                const write_type = u64;
-                const value: write_type = symtab[r.symbolIndex()].st_value +| @bitCast(write_type, r.r_addend);
-                const value_bytes = mem.toBytes(value);
-                mem.copy(u8, buffer.data[r.r_offset .. r.r_offset + @sizeOf(write_type)], &value_bytes);
-            },
-            ELFRelocationType.R_X86_64_32 => {
-                const write_type = u32;
-                const value: write_type = @truncate(u32, symtab[r.symbolIndex()].st_value) +| @bitCast(write_type, @intCast(i32, r.r_addend));
-                const value_bytes = mem.toBytes(value);
-                mem.copy(u8, buffer.data[r.r_offset .. r.r_offset + @sizeOf(write_type)], &value_bytes);
-            },
-            else => unreachable,
-        }
-    }
-}
-
 pub fn readElfGeneric(comptime T: type, buffer: *Buffer, arena: mem.Allocator) !ELFDebugSections {
     const header = buffer.consumeType(ELFFileHeader(T)) orelse unreachable;
     buffer.curr_pos = header.e_shoff;
@@ -181,17 +409,15 @@ pub fn readElfGeneric(comptime T: type, buffer: *Buffer, arena: mem.Allocator) !
 
     const shstrtab = section_headers[header.e_shstrndx];
     buffer.curr_pos = shstrtab.sh_offset;
-    var sstrtab = buffer.consume(@intCast(u32, shstrtab.sh_size)) orelse unreachable;
+    var sstrtab = buffer.consume(shstrtab.sh_size) orelse unreachable;
 
     var sh_debug_infoi: ?usize = null;
-    var sh_debug_info_relai: ?usize = null;
     var sh_debug_abbrevi: ?usize = null;
-    var sh_debug_abbrev_relai: ?usize = null;
     var sh_debug_stri: ?usize = null;
-    var sh_debug_str_relai: ?usize = null;
     var sh_debug_str_offsetsi: ?usize = null;
-    var sh_debug_str_offsets_relai: ?usize = null;
-    var sh_symtabi: ?usize = null;
+    var sh_debug_linei: ?usize = null;
+    var sh_debug_line_stri: ?usize = null;
+    var sh_debug_addri: ?usize = null;
     for (section_headers) |sh, i| {
         const name = blk: {
             if (mem.indexOfScalar(u8, sstrtab[sh.sh_name..], 0)) |pos| {
@@ -201,48 +427,61 @@ pub fn readElfGeneric(comptime T: type, buffer: *Buffer, arena: mem.Allocator) !
             }
         };
 
-        if (mem.eql(u8, name, ".symtab")) {
-            sh_symtabi = i;
-        } else if (mem.eql(u8, name, ".debug_info")) {
+        if (mem.eql(u8, name, ".debug_info")) {
             sh_debug_infoi = i;
-        } else if (mem.eql(u8, name, ".rela.debug_info")) {
-            sh_debug_info_relai = i;
         } else if (mem.eql(u8, name, ".debug_abbrev")) {
             sh_debug_abbrevi = i;
-        } else if (mem.eql(u8, name, ".rela.debug_abbrev")) {
-            sh_debug_abbrev_relai = i;
         } else if (mem.eql(u8, name, ".debug_str")) {
             sh_debug_stri = i;
-        } else if (mem.eql(u8, name, ".rela.debug_str")) {
-            sh_debug_str_relai = i;
         } else if (mem.eql(u8, name, ".debug_str_offsets")) {
             sh_debug_str_offsetsi = i;
-        } else if (mem.eql(u8, name, ".rela.debug_str_offsets")) {
-            sh_debug_str_offsets_relai = i;
+        } else if (mem.eql(u8, name, ".debug_line")) {
+            sh_debug_linei = i;
+        } else if (mem.eql(u8, name, ".debug_line_str")) {
+            sh_debug_line_stri = i;
+        } else if (mem.eql(u8, name, ".debug_addr")) {
+            sh_debug_addri = i;
         }
     }
 
-    var symtab = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_symtabi, buffer);
     var debug_abbrev = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_abbrevi, buffer);
     var debug_info = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_infoi, buffer);
     var debug_str = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_stri, buffer);
     var debug_str_offsets = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_str_offsetsi, buffer);
+    var debug_line = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_linei, buffer);
+    var debug_line_str = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_line_stri, buffer);
+    var debug_addr = getSectionBuffer(ELFSectionHeader(T), section_headers, sh_debug_addri, buffer);
 
-    if (sh_debug_info_relai) |relai| {
-        var rela = getSectionBuffer(ELFSectionHeader(T), section_headers, relai, buffer);
-        relocateBuffer(debug_info, &rela, &symtab);
-    }
-    if (sh_debug_abbrev_relai) |relai| {
-        var rela = getSectionBuffer(ELFSectionHeader(T), section_headers, relai, buffer);
-        relocateBuffer(debug_abbrev, &rela, &symtab);
-    }
-    if (sh_debug_str_relai) |relai| {
-        var rela = getSectionBuffer(ELFSectionHeader(T), section_headers, relai, buffer);
-        relocateBuffer(debug_str, &rela, &symtab);
-    }
-    if (sh_debug_str_offsets_relai) |relai| {
-        var rela = getSectionBuffer(ELFSectionHeader(T), section_headers, relai, buffer);
-        relocateBuffer(debug_str_offsets, &rela, &symtab);
+    // NOTE(radomski): Relocation sections name the section they apply to in
+    // sh_info and their symbol table in sh_link, .rel.* and .rela.* alike.
+    for (section_headers) |sh, i| {
+        if (sh.sh_type != SHT_REL and sh.sh_type != SHT_RELA) {
+            continue;
+        }
+
+        const target = blk: {
+            if (sh_debug_infoi != null and sh.sh_info == sh_debug_infoi.?) {
+                break :blk debug_info;
+            } else if (sh_debug_abbrevi != null and sh.sh_info == sh_debug_abbrevi.?) {
+                break :blk debug_abbrev;
+            } else if (sh_debug_stri != null and sh.sh_info == sh_debug_stri.?) {
+                break :blk debug_str;
+            } else if (sh_debug_str_offsetsi != null and sh.sh_info == sh_debug_str_offsetsi.?) {
+                break :blk debug_str_offsets;
+            } else if (sh_debug_linei != null and sh.sh_info == sh_debug_linei.?) {
+                break :blk debug_line;
+            } else if (sh_debug_addri != null and sh.sh_info == sh_debug_addri.?) {
+                break :blk debug_addr;
+            }
+            continue;
+        };
+
+        if (sh.sh_link >= section_headers.len) {
+            return Error.MalformedRelocation;
+        }
+        const rel = getSectionBuffer(ELFSectionHeader(T), section_headers, i, buffer);
+        const symtab = getSectionBuffer(ELFSectionHeader(T), section_headers, sh.sh_link, buffer);
+        try relocateBuffer(T, header.e_machine, target, rel, sh.sh_type == SHT_RELA, symtab);
     }
 
     return ELFDebugSections{
@@ -251,6 +490,9 @@ pub fn readElfGeneric(comptime T: type, buffer: *Buffer, arena: mem.Allocator) !
         .debug_info = debug_info,
         .debug_str = debug_str,
         .debug_str_offsets = debug_str_offsets,
+        .debug_line = debug_line,
+        .debug_line_str = debug_line_str,
+        .debug_addr = debug_addr,
     };
 }
 
@@ -262,6 +504,353 @@ pub fn readElf64(buffer: *Buffer, arena: mem.Allocator) !ELFDebugSections {
     return readElfGeneric(u64, buffer, arena);
 }
 
+pub fn findSectionGeneric(comptime T: type, buffer: *Buffer, section_name: []const u8) ?Buffer {
+    const header = buffer.consumeType(ELFFileHeader(T)) orelse return null;
+    if (header.e_shstrndx >= header.e_shnum) {
+        return null;
+    }
+
+    buffer.curr_pos = header.e_shoff + @as(u64, header.e_shstrndx) * @sizeOf(ELFSectionHeader(T));
+    const shstrtab = buffer.consumeType(ELFSectionHeader(T)) orelse return null;
+    buffer.curr_pos = shstrtab.sh_offset;
+    const sstrtab = buffer.consume(shstrtab.sh_size) orelse return null;
+
+    var i: u16 = 0;
+    while (i < header.e_shnum) : (i += 1) {
+        buffer.curr_pos = header.e_shoff + @as(u64, i) * @sizeOf(ELFSectionHeader(T));
+        const sh = buffer.consumeType(ELFSectionHeader(T)) orelse return null;
+        if (sh.sh_name >= sstrtab.len) {
+            continue;
+        }
+
+        const name_end = mem.indexOfScalarPos(u8, sstrtab, sh.sh_name, 0) orelse continue;
+        if (mem.eql(u8, sstrtab[sh.sh_name..name_end], section_name)) {
+            buffer.curr_pos = sh.sh_offset;
+            const data = buffer.consume(sh.sh_size) orelse return null;
+            return Buffer{ .data = data };
+        }
+    }
+
+    return null;
+}
+
+pub fn findSection(buffer: *Buffer, section_name: []const u8) ?Buffer {
+    buffer.curr_pos = 0;
+    const header_ident = buffer.consumeType(ELFIdentHeader) orelse return null;
+    if (!mem.eql(u8, &header_ident.eh_magic, "\x7fELF")) {
+        return null;
+    }
+
+    return switch (header_ident.eh_class) {
+        ELF_32BIT_CLASS => findSectionGeneric(u32, buffer, section_name),
+        ELF_64BIT_CLASS => findSectionGeneric(u64, buffer, section_name),
+        else => null,
+    };
+}
+
+// NOTE(radomski): Returns an empty slice when the binary was linked without
+// --build-id. Doesn't apply relocations, so it's fine on read-only mappings.
+pub fn getBuildId(buffer: *Buffer) []const u8 {
+    var note = findSection(buffer, ".note.gnu.build-id") orelse return &[_]u8{};
+    const name_size = note.consumeType(u32) orelse return &[_]u8{};
+    const desc_size = note.consumeType(u32) orelse return &[_]u8{};
+    _ = note.consumeType(u32) orelse return &[_]u8{}; // type
+    note.advance(mem.alignForward(name_size, 4));
+    return note.consume(desc_size) orelse &[_]u8{};
+}
+
+// Parts of the file the parser needs, for reading an ELF piece by piece
+// instead of all of it. Every step only looks at what the previous ones read,
+// at its offset in a buffer as big as the file.
+pub const FileRange = struct {
+    offset: u64,
+    size: u64,
+};
+
+pub const elf_header_size = 64;
+
+const SHT_NOBITS = 8;
+
+// .BTF too, it's used in place of DWARF when present. The line table only
+// gives --summary the directories structures are declared in.
+const debug_section_names = [_][]const u8{
+    ".debug_info",
+    ".debug_abbrev",
+    ".debug_str",
+    ".debug_str_offsets",
+    ".debug_line",
+    ".debug_line_str",
+    ".debug_addr",
+    ".BTF",
+};
+
+fn fileRange(data: []const u8, offset: u64, size: u64) Error!FileRange {
+    if (offset > data.len or data.len - offset < size) {
+        return Error.MalformedHeader;
+    }
+    return FileRange{ .offset = offset, .size = size };
+}
+
+fn fileHeader(comptime T: type, data: []u8) Error!ELFFileHeader(T) {
+    var buffer = Buffer{ .data = data, .curr_pos = @sizeOf(ELFIdentHeader) };
+    return buffer.consumeType(ELFFileHeader(T)) orelse Error.MalformedHeader;
+}
+
+fn sectionHeader(comptime T: type, data: []u8, header: ELFFileHeader(T), index: usize) Error!ELFSectionHeader(T) {
+    if (index >= header.e_shnum) {
+        return Error.MalformedHeader;
+    }
+    var buffer = Buffer{ .data = data, .curr_pos = header.e_shoff + index * @sizeOf(ELFSectionHeader(T)) };
+    return buffer.consumeType(ELFSectionHeader(T)) orelse Error.MalformedHeader;
+}
+
+fn sectionHeaderTableRangeGeneric(comptime T: type, data: []u8) Error!FileRange {
+    const header = try fileHeader(T, data);
+    return fileRange(data, header.e_shoff, @as(u64, header.e_shnum) * @sizeOf(ELFSectionHeader(T)));
+}
+
+fn sectionNamesRangeGeneric(comptime T: type, data: []u8) Error!FileRange {
+    const header = try fileHeader(T, data);
+    const sh = try sectionHeader(T, data, header, header.e_shstrndx);
+    return fileRange(data, sh.sh_offset, sh.sh_size);
+}
+
+fn debugSectionRangesGeneric(comptime T: type, data: []u8, ranges: anytype) !void {
+    const header = try fileHeader(T, data);
+    const shstrtab = try sectionHeader(T, data, header, header.e_shstrndx);
+    const names_range = try fileRange(data, shstrtab.sh_offset, shstrtab.sh_size);
+    const names = data[names_range.offset .. names_range.offset + names_range.size];
+
+    var debug_indices = [_]?usize{null} ** debug_section_names.len;
+    var i: usize = 0;
+    while (i < header.e_shnum) : (i += 1) {
+        const sh = try sectionHeader(T, data, header, i);
+        if (sh.sh_name >= names.len or sh.sh_type == SHT_NOBITS) {
+            continue;
+        }
+        const name = mem.sliceTo(names[sh.sh_name..], 0);
+        for (debug_section_names) |debug_name, j| {
+            if (mem.eql(u8, name, debug_name)) {
+                debug_indices[j] = i;
+                try ranges.append(try fileRange(data, sh.sh_offset, sh.sh_size));
+            }
+        }
+    }
+
+    var symtab_index: ?usize = null;
+    i = 0;
+    while (i < header.e_shnum) : (i += 1) {
+        const sh = try sectionHeader(T, data, header, i);
+        if (sh.sh_type != SHT_REL and sh.sh_type != SHT_RELA) {
+            continue;
+        }
+        for (debug_indices) |index_opt| {
+            if (index_opt != null and index_opt.? == sh.sh_info) {
+                break;
+            }
+        } else {
+            continue;
+        }
+
+        try ranges.append(try fileRange(data, sh.sh_offset, sh.sh_size));
+        if (symtab_index == null or symtab_index.? != sh.sh_link) {
+            symtab_index = sh.sh_link;
+            const symtab = try sectionHeader(T, data, header, sh.sh_link);
+            try ranges.append(try fileRange(data, symtab.sh_offset, symtab.sh_size));
+        }
+    }
+}
+
+fn fileClass(data: []const u8) Error!u8 {
+    if (data.len < elf_header_size or !mem.startsWith(u8, data, "\x7fELF")) {
+        return Error.NotElf;
+    }
+    return data[4];
+}
+
+// Needs the ELF header.
+pub fn sectionHeaderTableRange(data: []u8) Error!FileRange {
+    return switch (try fileClass(data)) {
+        ELF_32BIT_CLASS => sectionHeaderTableRangeGeneric(u32, data),
+        ELF_64BIT_CLASS => sectionHeaderTableRangeGeneric(u64, data),
+        else => Error.MalformedHeader,
+    };
+}
+
+fn sectionHeaderTableExtentGeneric(comptime T: type, header_bytes: []u8) Error!FileRange {
+    const header = try fileHeader(T, header_bytes);
+    return FileRange{ .offset = header.e_shoff, .size = @as(u64, header.e_shnum) * @sizeOf(ELFSectionHeader(T)) };
+}
+
+// Same as sectionHeaderTableRange but from the ELF header alone, nothing past
+// it has to be there, so nothing is bounds checked.
+pub fn sectionHeaderTableExtent(header_bytes: []u8) Error!FileRange {
+    return switch (try fileClass(header_bytes)) {
+        ELF_32BIT_CLASS => sectionHeaderTableExtentGeneric(u32, header_bytes),
+        ELF_64BIT_CLASS => sectionHeaderTableExtentGeneric(u64, header_bytes),
+        else => Error.MalformedHeader,
+    };
+}
+
+fn sectionsEndGeneric(comptime T: type, data: []u8) Error!u64 {
+    const header = try fileHeader(T, data);
+    var end = header.e_shoff + @as(u64, header.e_shnum) * @sizeOf(ELFSectionHeader(T));
+    var i: usize = 0;
+    while (i < header.e_shnum) : (i += 1) {
+        const sh = try sectionHeader(T, data, header, i);
+        if (sh.sh_type != SHT_NOBITS) {
+            end = @maximum(end, sh.sh_offset + sh.sh_size);
+        }
+    }
+    return end;
+}
+
+// Where the last section or the section header table ends, whichever is
+// later. Needs the section header table.
+pub fn sectionsEnd(data: []u8) Error!u64 {
+    return switch (try fileClass(data)) {
+        ELF_32BIT_CLASS => sectionsEndGeneric(u32, data),
+        ELF_64BIT_CLASS => sectionsEndGeneric(u64, data),
+        else => Error.MalformedHeader,
+    };
+}
+
+const ET_REL = 1;
+const SHF_WRITE = 0x1;
+const SHF_ALLOC = 0x2;
+const SHF_TLS = 0x400;
+
+pub const SectionKind = enum {
+    data,
+    bss,
+    rodata,
+};
+
+pub const AllocatedSection = struct {
+    start: u64,
+    end: u64,
+    kind: SectionKind,
+};
+
+fn allocatedSectionsGeneric(comptime T: type, data: []u8, arena: mem.Allocator) ![]AllocatedSection {
+    const header = try fileHeader(T, data);
+    var out = std.ArrayList(AllocatedSection).init(arena);
+    if (header.e_type == ET_REL) {
+        return out.items;
+    }
+    var i: usize = 0;
+    while (i < header.e_shnum) : (i += 1) {
+        const sh = try sectionHeader(T, data, header, i);
+        if (sh.sh_flags & SHF_ALLOC == 0 or sh.sh_flags & SHF_TLS != 0 or sh.sh_size == 0) {
+            continue;
+        }
+        const kind: SectionKind = if (sh.sh_type == SHT_NOBITS)
+            .bss
+        else if (sh.sh_flags & SHF_WRITE != 0)
+            .data
+        else
+            .rodata;
+        try out.append(.{ .start = sh.sh_addr, .end = sh.sh_addr + sh.sh_size, .kind = kind });
+    }
+    return out.items;
+}
+
+// Sections loaded into memory besides TLS, told apart by type and flags so
+// .data.rel.ro, .sdata and the like count too. None for relocatable objects,
+// every section starts at 0 in those. Needs the section header table.
+pub fn allocatedSections(data: []u8, arena: mem.Allocator) ![]AllocatedSection {
+    return switch (try fileClass(data)) {
+        ELF_32BIT_CLASS => allocatedSectionsGeneric(u32, data, arena),
+        ELF_64BIT_CLASS => allocatedSectionsGeneric(u64, data, arena),
+        else => Error.MalformedHeader,
+    };
+}
+
+pub fn sectionKindAt(sections: []const AllocatedSection, address: u64) ?SectionKind {
+    for (sections) |section| {
+        if (address >= section.start and address < section.end) {
+            return section.kind;
+        }
+    }
+    return null;
+}
+
+// Needs the section header table.
+pub fn sectionNamesRange(data: []u8) Error!FileRange {
+    return switch (try fileClass(data)) {
+        ELF_32BIT_CLASS => sectionNamesRangeGeneric(u32, data),
+        ELF_64BIT_CLASS => sectionNamesRangeGeneric(u64, data),
+        else => Error.MalformedHeader,
+    };
+}
+
+// Needs the section names. Appends the debug sections getSectionsDebugSections
+// uses, the relocation sections applying to them and their symbol tables.
+pub fn debugSectionRanges(data: []u8, ranges: anytype) !void {
+    return switch (try fileClass(data)) {
+        ELF_32BIT_CLASS => debugSectionRangesGeneric(u32, data, ranges),
+        ELF_64BIT_CLASS => debugSectionRangesGeneric(u64, data, ranges),
+        else => Error.MalformedHeader,
+    };
+}
+
+const DT_NULL = 0;
+const DT_NEEDED = 1;
+const DT_RPATH = 15;
+const DT_RUNPATH = 29;
+
+fn ELFDynamic(comptime T: type) type {
+    return extern struct {
+        d_tag: std.meta.Int(.signed, @bitSizeOf(T)),
+        d_val: T,
+    };
+}
+
+pub const DynamicInfo = struct {
+    needed: []const []const u8 = &.{},
+    rpath: ?[]const u8 = null,
+    runpath: ?[]const u8 = null,
+};
+
+fn readDynamicGeneric(comptime T: type, dynamic: Buffer, dynstr: Buffer, arena: mem.Allocator) !DynamicInfo {
+    var needed = std.ArrayList([]const u8).init(arena);
+    var info = DynamicInfo{};
+    for (mem.bytesAsSlice(ELFDynamic(T), dynamic.data)) |dyn| {
+        if (dyn.d_tag == DT_NULL) {
+            break;
+        }
+        if (dyn.d_tag != DT_NEEDED and dyn.d_tag != DT_RPATH and dyn.d_tag != DT_RUNPATH) {
+            continue;
+        }
+        if (dyn.d_val >= dynstr.data.len) {
+            return Error.MalformedDynamic;
+        }
+
+        const str = mem.sliceTo(dynstr.data[dyn.d_val..], 0);
+        if (dyn.d_tag == DT_NEEDED) {
+            try needed.append(str);
+        } else if (dyn.d_tag == DT_RPATH) {
+            info.rpath = str;
+        } else {
+            info.runpath = str;
+        }
+    }
+    info.needed = needed.items;
+    return info;
+}
+
+// NOTE(radomski): Strings are looked up through the .dynstr section instead
+// of DT_STRTAB, which is an address and would need the program headers.
+pub fn readDynamic(buffer: *Buffer, arena: mem.Allocator) !DynamicInfo {
+    const dynamic = findSection(buffer, ".dynamic") orelse return DynamicInfo{};
+    const dynstr = findSection(buffer, ".dynstr") orelse return Error.MalformedDynamic;
+    return switch (buffer.data[4]) {
+        ELF_32BIT_CLASS => readDynamicGeneric(u32, dynamic, dynstr, arena),
+        ELF_64BIT_CLASS => readDynamicGeneric(u64, dynamic, dynstr, arena),
+        else => Error.MalformedDynamic,
+    };
+}
+
 pub fn getSectionsDebugSections(buffer: *Buffer, arena: mem.Allocator) !ELFDebugSections {
     const header_ident = buffer.consumeType(ELFIdentHeader) orelse unreachable;
     var sections = switch (header_ident.eh_class) {
@@ -272,3 +861,50 @@ pub fn getSectionsDebugSections(buffer: *Buffer, arena: mem.Allocator) !ELFDebug
 
     return sections;
 }
+
+test "relocation split keeps RISC-V pairs together" {
+    const R = ELFRelocationA(u64);
+    const Symbol = ELFSymbol(u64);
+    const R_RISCV_ADD32 = 35;
+    const R_RISCV_SUB32 = 39;
+
+    // NOTE(radomski): A symbol difference in every 4 byte slot, the way
+    // RISC-V writes lengths in .debug_line, ADD32 and SUB32 at one offset.
+    // 30 entries in 4 ranges would end at 7, 15 and 22, the first two in
+    // the middle of a pair.
+    const slot_count = 15;
+    var entries: [slot_count * 2]R = undefined;
+    for (entries) |*r, i| {
+        const is_sub = i % 2 == 1;
+        r.* = .{
+            .r_offset = @as(u64, i / 2) * 4,
+            .r_info = (@as(u64, if (is_sub) 2 else 1) << 32) | @as(u64, if (is_sub) R_RISCV_SUB32 else R_RISCV_ADD32),
+            .r_addend = 0,
+        };
+    }
+    const symtab = [_]Symbol{
+        .{ .st_name = 0, .st_info = 0, .st_other = 0, .st_shndx = 0, .st_value = 0, .st_size = 0 },
+        .{ .st_name = 0, .st_info = 0, .st_other = 0, .st_shndx = 0, .st_value = 0x1234, .st_size = 0 },
+        .{ .st_name = 0, .st_info = 0, .st_other = 0, .st_shndx = 0, .st_value = 0x1000, .st_size = 0 },
+    };
+
+    var ends: [4]usize = undefined;
+    splitRelocationRanges(R, &entries, &ends);
+    var start: usize = 0;
+    for (ends) |end| {
+        try std.testing.expect(end > start);
+        if (end < entries.len) {
+            try std.testing.expect(entries[end].r_offset != entries[end - 1].r_offset);
+        }
+        start = end;
+    }
+    try std.testing.expectEqual(@as(usize, entries.len), start);
+
+    var target = [_]u8{0} ** (slot_count * 4);
+    const split = RelocationSplit{ .threshold = 1, .entries_per_thread = 1, .threads = 4 };
+    try relocateEntries(u64, R, &target, &entries, &symtab, machineRelocationRules(EM_RISCV).?, split);
+    var slot: usize = 0;
+    while (slot < slot_count) : (slot += 1) {
+        try std.testing.expectEqual(@as(u32, 0x234), mem.readIntLittle(u32, target[slot * 4 ..][0..4]));
+    }
+}
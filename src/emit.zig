@@ -0,0 +1,67 @@
+const std = @import("std");
+
+// Text output of the struct printer. Everything gets appended straight into
+// one growable buffer, there are no format strings to interpret, integers go
+// through a two digits at a time routine and padding is a single memset.
+
+out: *std.ArrayList(u8),
+
+const Self = @This();
+
+const digit_pairs = blk: {
+    var table: [200]u8 = undefined;
+    var i: usize = 0;
+    while (i < 100) : (i += 1) {
+        table[i * 2] = '0' + @intCast(u8, i / 10);
+        table[i * 2 + 1] = '0' + @intCast(u8, i % 10);
+    }
+    break :blk table;
+};
+
+pub fn init(out: *std.ArrayList(u8)) Self {
+    return Self{ .out = out };
+}
+
+pub fn bytes(e: Self, s: []const u8) !void {
+    try e.out.appendSlice(s);
+}
+
+pub fn byteNTimes(e: Self, byte: u8, n: usize) !void {
+    try e.out.appendNTimes(byte, n);
+}
+
+pub fn spaces(e: Self, n: usize) !void {
+    try e.out.appendNTimes(' ', n);
+}
+
+pub fn int(e: Self, value: u64) !void {
+    var buffer: [20]u8 = undefined;
+    var i: usize = buffer.len;
+    var v = value;
+    while (v >= 100) {
+        const pair = @intCast(usize, v % 100) * 2;
+        v /= 100;
+        i -= 2;
+        buffer[i] = digit_pairs[pair];
+        buffer[i + 1] = digit_pairs[pair + 1];
+    }
+    if (v >= 10) {
+        const pair = @intCast(usize, v) * 2;
+        i -= 2;
+        buffer[i] = digit_pairs[pair];
+        buffer[i + 1] = digit_pairs[pair + 1];
+    } else {
+        i -= 1;
+        buffer[i] = '0' + @intCast(u8, v);
+    }
+    try e.out.appendSlice(buffer[i..]);
+}
+
+pub fn digitCount(value: u64) usize {
+    var count: usize = 1;
+    var v = value;
+    while (v >= 10) : (count += 1) {
+        v /= 10;
+    }
+    return count;
+}
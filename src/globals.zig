@@ -0,0 +1,178 @@
+const std = @import("std");
+const elf = @import("elf.zig");
+const main = @import("main.zig");
+const Context = main.Context;
+const StructId = main.StructId;
+const Variable = main.Variable;
+
+const mem = std.mem;
+
+// --globals, which variables with a static location take the most of .data
+// and .bss, and which thread_local ones make up the TLS block every new thread
+// gets a copy of. Waste is the padding of the structures they're made of, for
+// an array once per element. The section comes from the variable's address,
+// relocatable objects don't have one and their variables are just global.
+
+const Placement = enum {
+    data,
+    bss,
+    rodata,
+    global,
+    thread_local,
+
+    fn text(p: Placement) []const u8 {
+        return switch (p) {
+            .data => ".data",
+            .bss => ".bss",
+            .rodata => ".rodata",
+            .global => "global",
+            .thread_local => "thread_local",
+        };
+    }
+};
+
+const Entry = struct {
+    variable: Variable,
+    placement: Placement,
+    size: u64,
+    waste_bits: u64,
+};
+
+fn placementOf(variable: Variable, sections: []const elf.AllocatedSection) Placement {
+    if (variable.is_tls) {
+        return .thread_local;
+    }
+    const address = variable.address orelse return .global;
+    return switch (elf.sectionKindAt(sections, address) orelse return .global) {
+        .data => .data,
+        .bss => .bss,
+        .rodata => .rodata,
+    };
+}
+
+fn sizeGreaterThan(context: void, a: Entry, b: Entry) bool {
+    _ = context;
+    if (a.size != b.size) {
+        return a.size > b.size;
+    }
+    return mem.lessThan(u8, a.variable.name, b.variable.name);
+}
+
+fn wasteGreaterThan(context: void, a: Entry, b: Entry) bool {
+    _ = context;
+    if (a.waste_bits != b.waste_bits) {
+        return a.waste_bits > b.waste_bits;
+    }
+    return mem.lessThan(u8, a.variable.name, b.variable.name);
+}
+
+// NOTE(radomski): Array and qualified types don't point at their structure,
+// it's found by name and checked by size like the BTF encoder does. Keyed by
+// the name itself, the same name can have several NameIds.
+fn structuresByName(c: *Context, arena: mem.Allocator) !std.StringHashMap(StructId) {
+    var out = std.StringHashMap(StructId).init(arena);
+    for (c.structures.items(.type_id)) |type_id, sid| {
+        const name = c.types.items(.name)[type_id];
+        if (name != 0) {
+            const gop = try out.getOrPut(c.getName(name));
+            if (!gop.found_existing) {
+                gop.value_ptr.* = @intCast(StructId, sid);
+            }
+        }
+    }
+    return out;
+}
+
+pub fn run(c: *Context, sections: []const elf.AllocatedSection, top_n: usize, arena: mem.Allocator) !void {
+    const by_name = try structuresByName(c, arena);
+    var waste_by_struct = std.AutoHashMap(StructId, u64).init(arena);
+    var holes = std.ArrayList(Context.Hole).init(arena);
+
+    var entries = try arena.alloc(Entry, c.variables.items.len);
+    var counts = [_]u64{0} ** @typeInfo(Placement).Enum.fields.len;
+    var sizes = [_]u64{0} ** @typeInfo(Placement).Enum.fields.len;
+    for (c.variables.items) |variable, i| {
+        const t = c.types.get(variable.type_id);
+        const elements: u64 = if (t.isArray()) t.dimension else 1;
+        const size = @as(u64, t.size) * elements;
+
+        var waste_bits: u64 = 0;
+        if (t.ptr_count == 0) {
+            if (by_name.get(c.getName(t.name))) |sid| {
+                const s = c.structures.get(sid);
+                if (c.types.items(.shape)[s.type_id].size == t.size) {
+                    const gop = try waste_by_struct.getOrPut(sid);
+                    if (!gop.found_existing) {
+                        holes.clearRetainingCapacity();
+                        try c.collectHoles(s, 0, &holes);
+                        gop.value_ptr.* = 0;
+                        for (holes.items) |hole| {
+                            gop.value_ptr.* += hole.size_bits;
+                        }
+                    }
+                    waste_bits = gop.value_ptr.* * elements;
+                }
+            }
+        }
+
+        const placement = placementOf(variable, sections);
+        entries[i] = .{ .variable = variable, .placement = placement, .size = size, .waste_bits = waste_bits };
+        counts[@enumToInt(placement)] += 1;
+        sizes[@enumToInt(placement)] += size;
+    }
+    const tls = @enumToInt(Placement.thread_local);
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.bufferedWriter(stdout_file);
+    const stdout = bw.writer();
+
+    var global_size: u64 = 0;
+    for (sizes[0..tls]) |size| {
+        global_size += size;
+    }
+    try stdout.print("globals={} size={}\n", .{ entries.len - counts[tls], global_size });
+    for (counts[0..tls]) |count, i| {
+        if (count > 0) {
+            try stdout.print("  {s}={} size={}\n", .{ @intToEnum(Placement, i).text(), count, sizes[i] });
+        }
+    }
+    try stdout.print("thread_local={} size={} per thread\n", .{ counts[tls], sizes[tls] });
+
+    std.sort.sort(Entry, entries, {}, sizeGreaterThan);
+    const by_size = entries[0..@minimum(top_n, entries.len)];
+    try stdout.print("Top {} by size:\n", .{by_size.len});
+    for (by_size) |entry| {
+        try printEntry(c, stdout, entry);
+    }
+
+    std.sort.sort(Entry, entries, {}, wasteGreaterThan);
+    var with_waste: usize = 0;
+    while (with_waste < @minimum(top_n, entries.len) and entries[with_waste].waste_bits > 0) : (with_waste += 1) {}
+    try stdout.print("Top {} by waste:\n", .{with_waste});
+    for (entries[0..with_waste]) |entry| {
+        try printEntry(c, stdout, entry);
+    }
+    try bw.flush();
+}
+
+fn printEntry(c: *Context, stdout: anytype, entry: Entry) !void {
+    const t = c.types.get(entry.variable.type_id);
+    try stdout.print("  {s} {s}{s} ", .{
+        entry.placement.text(),
+        if (t.ptr_count == 0) t.qualifiers.text() else "",
+        c.getName(t.name),
+    });
+    try stdout.writeByteNTimes('*', t.ptr_count);
+    if (t.ptr_count > 0) {
+        try stdout.writeAll(t.qualifiers.text());
+    }
+    try stdout.writeAll(entry.variable.name);
+    if (t.isArray()) {
+        try stdout.print("[{}]", .{t.dimension});
+    }
+    try stdout.print("; // size={}", .{entry.size});
+    if (entry.waste_bits > 0) {
+        try stdout.print(", waste={} bytes and {} bits", .{ entry.waste_bits / 8, entry.waste_bits % 8 });
+    }
+    try stdout.writeAll("\n");
+}
@@ -0,0 +1,211 @@
+const std = @import("std");
+const main = @import("main.zig");
+
+const mem = std.mem;
+const os = std.os;
+
+// The ELF -> Dwarf -> Context pipeline as a library. Views point straight into
+// the Context tables and .debug_str, iterators are plain indices, so walking a
+// binary allocates nothing past what opening it did. The views stay valid
+// until the binary is closed.
+
+pub const Context = main.Context;
+pub const StructId = main.StructId;
+pub const StructKind = main.Type.StructType;
+pub const MemberKind = main.StructMember.Kind;
+
+pub const StructureView = struct {
+    id: StructId,
+    name: []const u8,
+    size: u32,
+    kind: StructKind,
+    member_count: u32,
+};
+
+pub const MemberView = struct {
+    name: []const u8,
+    // In bytes from the start of the structure
+    offset: u32,
+    bit_offset: u16,
+    // Zero unless it's a bitfield
+    bit_size: u16,
+    type_name: []const u8,
+    type_size: u32,
+    ptr_count: u8,
+    // Number of elements when the member is an array
+    dimension: ?u32,
+    // Set when the member's type is a structure, union or class
+    struct_id: ?StructId,
+    // Base class subobjects are members too, virtual ones without an offset
+    kind: MemberKind,
+};
+
+pub const NamespaceView = struct {
+    name: []const u8,
+    first_structure: StructId,
+    structure_count: u32,
+};
+
+pub const Binary = struct {
+    arena_instance: std.heap.ArenaAllocator,
+    context: Context,
+    mapping: ?[]align(mem.page_size) u8 = null,
+    // Unqualified name to the first structure with it, built on the first lookup
+    name_index: std.StringHashMapUnmanaged(StructId) = .{},
+
+    // data is relocated in place, it has to be writable and outlive the Binary.
+    pub fn openMemory(gpa: mem.Allocator, data: []u8) !*Binary {
+        var b = try gpa.create(Binary);
+        errdefer gpa.destroy(b);
+        b.* = .{ .arena_instance = std.heap.ArenaAllocator.init(gpa), .context = undefined };
+        errdefer b.arena_instance.deinit();
+
+        const arena = b.arena_instance.allocator();
+        b.context = try main.contextFromElf(data, arena);
+        try b.context.parse();
+        b.context.sortNamespaces();
+        return b;
+    }
+
+    // The file gets a private mapping, so relocating never touches it.
+    pub fn openFd(gpa: mem.Allocator, fd: os.fd_t) !*Binary {
+        const stat = try os.fstat(fd);
+        const size = @intCast(usize, stat.size);
+        const mapping = try os.mmap(null, size, os.PROT.READ | os.PROT.WRITE, os.MAP.PRIVATE, fd, 0);
+        errdefer os.munmap(mapping);
+
+        var b = try openMemory(gpa, mapping);
+        b.mapping = mapping;
+        return b;
+    }
+
+    pub fn close(b: *Binary) void {
+        const gpa = b.arena_instance.child_allocator;
+        if (b.mapping) |mapping| {
+            os.munmap(mapping);
+        }
+        b.arena_instance.deinit();
+        gpa.destroy(b);
+    }
+
+    pub fn structure(b: *Binary, id: StructId) StructureView {
+        const c = &b.context;
+        const s = c.structures.get(id);
+        const stype = c.types.get(s.type_id);
+        return StructureView{
+            .id = id,
+            .name = c.getName(stype.name),
+            .size = stype.size,
+            .kind = stype.struct_type,
+            .member_count = @intCast(u32, s.member_range.len()),
+        };
+    }
+
+    pub fn structures(b: *Binary) StructureIterator {
+        return StructureIterator{ .b = b, .end = @intCast(StructId, b.context.structures.len) };
+    }
+
+    pub fn members(b: *Binary, id: StructId) MemberIterator {
+        const range = b.context.structures.items(.member_range)[id];
+        return MemberIterator{ .b = b, .index = range.start, .end = range.end };
+    }
+
+    pub fn namespaces(b: *Binary) NamespaceIterator {
+        return NamespaceIterator{ .b = b };
+    }
+
+    // Accepts plain and namespace qualified names, ns1::ns2::name.
+    pub fn findStructure(b: *Binary, name: []const u8) !?StructureView {
+        if (mem.indexOf(u8, name, "::") != null) {
+            const s = (try b.context.findStructure(.{ .name = name }, b.arena_instance.child_allocator)) orelse return null;
+            return b.structure(b.context.types.items(.struct_id)[s.type_id]);
+        }
+
+        if (b.name_index.count() == 0) {
+            try b.buildNameIndex();
+        }
+        const id = b.name_index.get(name) orelse return null;
+        return b.structure(id);
+    }
+
+    fn buildNameIndex(b: *Binary) !void {
+        const arena = b.arena_instance.allocator();
+        var it = b.structures();
+        while (it.next()) |s| {
+            const gop = try b.name_index.getOrPut(arena, s.name);
+            if (!gop.found_existing) {
+                gop.value_ptr.* = s.id;
+            }
+        }
+    }
+};
+
+// Named structures with a size, the same ones the printer prints.
+pub const StructureIterator = struct {
+    b: *Binary,
+    index: StructId = 0,
+    end: StructId,
+
+    pub fn next(it: *StructureIterator) ?StructureView {
+        while (it.index < it.end) {
+            const id = it.index;
+            it.index += 1;
+            const view = it.b.structure(id);
+            if (view.size > 0 and view.name.len > 0) {
+                return view;
+            }
+        }
+        return null;
+    }
+};
+
+pub const MemberIterator = struct {
+    b: *Binary,
+    index: main.MemberId,
+    end: main.MemberId,
+
+    pub fn next(it: *MemberIterator) ?MemberView {
+        if (it.index >= it.end) {
+            return null;
+        }
+        const c = &it.b.context;
+        const members = c.members.slice();
+        const member_id = it.index;
+        it.index += 1;
+
+        const type_id = members.items(.type_id)[member_id];
+        const shape = c.types.items(.shape)[type_id];
+        const struct_id = c.types.items(.struct_id)[type_id];
+        return MemberView{
+            .name = c.getName(members.items(.name)[member_id]),
+            .offset = members.items(.mem_loc)[member_id],
+            .bit_offset = members.items(.bit_loc)[member_id],
+            .bit_size = members.items(.bit_size)[member_id],
+            .type_name = c.getName(c.types.items(.name)[type_id]),
+            .type_size = shape.size,
+            .ptr_count = shape.ptr_count,
+            .dimension = if (shape.isArray()) shape.dimension else null,
+            .struct_id = if (struct_id != std.math.maxInt(StructId)) struct_id else null,
+            .kind = members.items(.kind)[member_id],
+        };
+    }
+};
+
+pub const NamespaceIterator = struct {
+    b: *Binary,
+    index: usize = 0,
+
+    pub fn next(it: *NamespaceIterator) ?NamespaceView {
+        const ns = it.b.context.namespaces.items;
+        if (it.index >= ns.len) {
+            return null;
+        }
+        const namespace = ns[it.index];
+        it.index += 1;
+        return NamespaceView{
+            .name = namespace.name,
+            .first_structure = namespace.struct_range.start,
+            .structure_count = @intCast(u32, namespace.struct_range.len()),
+        };
+    }
+};
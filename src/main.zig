@@ -1,6 +1,21 @@
 const std = @import("std");
 const Dwarf = @import("dwarf.zig");
 const elf = @import("elf.zig");
+const archive = @import("archive.zig");
+const batch = @import("batch.zig");
+const btf = @import("btf.zig");
+const deps = @import("deps.zig");
+const globals = @import("globals.zig");
+const serve = @import("serve.zig");
+const profile = @import("profile.zig");
+const sharing = @import("sharing.zig");
+const sample = @import("sample.zig");
+const shard = @import("shard.zig");
+const stream = @import("stream.zig");
+const summary = @import("summary.zig");
+const watch = @import("watch.zig");
+const Emitter = @import("emit.zig");
+const Perf = @import("perf.zig");
 
 const fmt = std.fmt;
 const mem = std.mem;
@@ -13,15 +28,15 @@ pub const Buffer = struct {
     data: []u8,
     curr_pos: u64 = 0,
 
-    pub fn peek(self: *Buffer, amount: u32) []u8 {
+    pub fn peek(self: *Buffer, amount: u64) []u8 {
         return self.data[self.curr_pos .. self.curr_pos + amount];
     }
 
-    pub fn isSpaceLeft(self: *Buffer, amount: u32) bool {
+    pub fn isSpaceLeft(self: *Buffer, amount: u64) bool {
         return self.curr_pos <= (self.data.len + amount);
     }
 
-    pub fn consume(self: *Buffer, amount: u32) ?[]u8 {
+    pub fn consume(self: *Buffer, amount: u64) ?[]u8 {
         self.curr_pos += amount;
         if (self.curr_pos <= self.data.len) {
             return self.data[self.curr_pos - amount .. self.curr_pos];
@@ -30,7 +45,7 @@ pub const Buffer = struct {
         }
     }
 
-    pub fn consumeUnchecked(self: *Buffer, amount: u32) []u8 {
+    pub fn consumeUnchecked(self: *Buffer, amount: u64) []u8 {
         self.curr_pos += amount;
         return self.data[self.curr_pos - amount .. self.curr_pos];
     }
@@ -86,7 +101,7 @@ pub const Buffer = struct {
         return mem.bytesToValue(T, slice[0..@sizeOf(T)]);
     }
 
-    pub fn consumeTypeAligned(self: *Buffer, comptime T: type, alignment: u32) ?T {
+    pub fn consumeTypeAligned(self: *Buffer, comptime T: type, alignment: u64) ?T {
         self.curr_pos += alignment - 1;
         self.curr_pos &= ~(alignment - 1);
 
@@ -140,89 +155,414 @@ pub fn Range(comptime T: type) type {
     };
 }
 
-const TypeError = Dwarf.Error || mem.Allocator.Error;
+const TypeError = Dwarf.Error || mem.Allocator.Error || error{
+    InvalidTypeReference,
+    CyclicTypeReference,
+};
 
-const TypeId = u32;
-const Type = struct {
-    name: []const u8,
+pub const NameId = u32;
+
+// Interned, zero terminated names, id 0 is the empty string. Tables refer to
+// names by a u32 offset instead of carrying a 16 byte slice each.
+//
+// NOTE(radomski): Names living in .debug_str aren't copied or even read while
+// parsing, the id just references them (lazy_bit set) and they get read when
+// something prints them.
+//
+// Only id 0 is canonical. The same name can get a reference and an interned
+// id, or several references when .debug_str holds duplicates, so ids can't be
+// compared or used as keys for the name. Compare the bytes from get().
+pub const NameTable = struct {
+    bytes: std.ArrayListUnmanaged(u8) = .{},
+    map: std.HashMapUnmanaged(NameId, void, std.hash_map.StringIndexContext, std.hash_map.default_max_load_percentage) = .{},
+    debug_str: []const u8,
+
+    const lazy_bit: NameId = 1 << 31;
+    const prefetch_distance = 8;
+
+    pub fn init(allocator: mem.Allocator, debug_str: []const u8) !NameTable {
+        var t = NameTable{ .debug_str = debug_str };
+        try t.bytes.append(allocator, 0);
+        return t;
+    }
+
+    pub fn isReference(id: NameId) bool {
+        return id & lazy_bit != 0;
+    }
+
+    pub fn reference(t: *NameTable, allocator: mem.Allocator, debug_str_offset: usize) !NameId {
+        if (debug_str_offset >= t.debug_str.len) {
+            return Dwarf.Error.EndOfBuffer;
+        }
+        // Anonymous entities may still point at an empty string
+        if (t.debug_str[debug_str_offset] == 0) {
+            return 0;
+        }
+        if (debug_str_offset >= lazy_bit) {
+            return t.intern(allocator, mem.sliceTo(t.debug_str[debug_str_offset..], 0));
+        }
+
+        return lazy_bit | @intCast(NameId, debug_str_offset);
+    }
+
+    pub fn intern(t: *NameTable, allocator: mem.Allocator, name: []const u8) !NameId {
+        if (name.len == 0) {
+            return 0;
+        }
+
+        const gop = try t.map.getOrPutContextAdapted(
+            allocator,
+            name,
+            std.hash_map.StringIndexAdapter{ .bytes = &t.bytes },
+            std.hash_map.StringIndexContext{ .bytes = &t.bytes },
+        );
+        if (!gop.found_existing) {
+            gop.key_ptr.* = @intCast(NameId, t.bytes.items.len);
+            try t.bytes.ensureUnusedCapacity(allocator, name.len + 1);
+            t.bytes.appendSliceAssumeCapacity(name);
+            t.bytes.appendAssumeCapacity(0);
+        }
+
+        return gop.key_ptr.*;
+    }
+
+    pub fn get(t: *const NameTable, id: NameId) []const u8 {
+        if (isReference(id)) {
+            return mem.sliceTo(t.debug_str[id & ~lazy_bit ..], 0);
+        }
+        return mem.sliceTo(@ptrCast([*:0]const u8, t.bytes.items.ptr + id), 0);
+    }
+
+    // Names read ahead of printing, printing takes the slices from here
+    // instead of looking for the terminator in .debug_str again.
+    pub const Resolved = struct {
+        // Sorted, without duplicates
+        ids: []const NameId = &[_]NameId{},
+        names: []const []const u8 = &[_][]const u8{},
+
+        pub fn get(r: *const Resolved, t: *const NameTable, id: NameId) []const u8 {
+            if (isReference(id)) {
+                if (std.sort.binarySearch(NameId, id, r.ids, {}, orderIds)) |i| {
+                    return r.names[i];
+                }
+            }
+            return t.get(id);
+        }
+
+        fn orderIds(context: void, lhs: NameId, rhs: NameId) std.math.Order {
+            _ = context;
+            return std.math.order(lhs, rhs);
+        }
+    };
+
+    // Reads the referenced names in the order given, prefetching the ones a
+    // few steps ahead. Passing ids sorted by offset turns a cache miss per name
+    // into a mostly sequential sweep over .debug_str. Duplicates are dropped
+    // from sorted_ids in place, the result points into it.
+    pub fn resolve(t: *const NameTable, allocator: mem.Allocator, sorted_ids: []NameId) !Resolved {
+        var unique: usize = 0;
+        for (sorted_ids) |id| {
+            if (unique == 0 or sorted_ids[unique - 1] != id) {
+                sorted_ids[unique] = id;
+                unique += 1;
+            }
+        }
+        const ids = sorted_ids[0..unique];
+
+        var names = try allocator.alloc([]const u8, ids.len);
+        for (ids) |id, i| {
+            if (i + prefetch_distance < ids.len) {
+                @prefetch(t.debug_str.ptr + (ids[i + prefetch_distance] & ~lazy_bit), .{});
+            }
+            names[i] = t.get(id);
+        }
+        return Resolved{ .ids = ids, .names = names };
+    }
+};
+
+// Bytes taken by one row of a MultiArrayList(T), fields are stored apart so
+// there is no padding between them.
+fn rowSize(comptime T: type) usize {
+    comptime var size: usize = 0;
+    inline for (std.meta.fields(T)) |field| {
+        size += @sizeOf(field.field_type);
+    }
+    return size;
+}
+
+pub const TypeId = u32;
+// Marks types whose frame is still on the type work stack
+const InProgressTypeId = std.math.maxInt(TypeId) - 1;
+pub const Type = struct {
+    name: NameId,
     size: u32,
     dimension: u32,
     ptr_count: u8,
     struct_type: StructType = .none,
     struct_id: StructId = InvalidStructId,
+    qualifiers: Qualifiers = .{},
+    // A signed integer or one behind typedefs and qualifiers, for BTF
+    is_signed: bool = false,
 
-    const StructType = enum(u8) {
+    pub const StructType = enum(u8) {
         none,
         struct_type,
         union_type,
         class_type,
     };
 
+    // NOTE(radomski): Qualifiers of the type itself, for a pointer the ones
+    // after the last '*'. Typedefs start over, their name says it already.
+    pub const Qualifiers = packed struct {
+        is_const: bool = false,
+        is_volatile: bool = false,
+        is_atomic: bool = false,
+        is_restrict: bool = false,
+        _padding: u4 = 0,
+
+        const texts = blk: {
+            var out: [16][]const u8 = undefined;
+            for (out) |*slot, i| {
+                var joined: []const u8 = "";
+                if (i & 1 != 0) joined = joined ++ "const ";
+                if (i & 2 != 0) joined = joined ++ "volatile ";
+                if (i & 4 != 0) joined = joined ++ "_Atomic ";
+                if (i & 8 != 0) joined = joined ++ "restrict ";
+                slot.* = joined;
+            }
+            break :blk out;
+        };
+
+        pub fn any(q: Qualifiers) bool {
+            return q.is_const or q.is_volatile or q.is_atomic or q.is_restrict;
+        }
+
+        // Space separated with a trailing space, empty without qualifiers
+        pub fn text(q: Qualifiers) []const u8 {
+            const index = @as(usize, @boolToInt(q.is_const)) |
+                @as(usize, @boolToInt(q.is_volatile)) << 1 |
+                @as(usize, @boolToInt(q.is_atomic)) << 2 |
+                @as(usize, @boolToInt(q.is_restrict)) << 3;
+            return texts[index];
+        }
+    };
+
     pub fn isArray(self: Type) bool {
         return self.dimension != std.math.maxInt(@TypeOf(self.dimension));
     }
 };
 
-const StructMember = struct {
+// NOTE(radomski): Everything printing a member looks at besides the name
+// lives in one column, a member then costs one cache line of the types table
+// instead of one per field. get() puts a whole Type together, loops going
+// over many types should read the columns.
+pub const TypeTable = struct {
+    rows: std.MultiArrayList(Row) = .{},
+
+    // NOTE(radomski): A plain struct, not a packed one. Size and dimension
+    // need their 32 bits, so a packed struct would need a u96 and be 16
+    // bytes. As it is the four byte fields fill the last word, no padding.
+    pub const Shape = struct {
+        size: u32,
+        dimension: u32,
+        ptr_count: u8,
+        struct_type: Type.StructType,
+        qualifiers: Type.Qualifiers,
+        is_signed: bool,
+
+        pub fn isArray(self: Shape) bool {
+            return self.dimension != std.math.maxInt(@TypeOf(self.dimension));
+        }
+
+        comptime {
+            std.debug.assert(@sizeOf(Shape) == 12);
+        }
+    };
+
+    pub const Row = struct {
+        name: NameId,
+        shape: Shape,
+        struct_id: StructId,
+    };
+
+    pub const Field = std.MultiArrayList(Row).Field;
+
+    fn FieldType(comptime field: Field) type {
+        return std.meta.fieldInfo(Row, field).field_type;
+    }
+
+    fn toRow(t: Type) Row {
+        return .{
+            .name = t.name,
+            .shape = .{
+                .size = t.size,
+                .dimension = t.dimension,
+                .ptr_count = t.ptr_count,
+                .struct_type = t.struct_type,
+                .qualifiers = t.qualifiers,
+                .is_signed = t.is_signed,
+            },
+            .struct_id = t.struct_id,
+        };
+    }
+
+    pub fn len(table: TypeTable) usize {
+        return table.rows.len;
+    }
+
+    pub fn items(table: TypeTable, comptime field: Field) []FieldType(field) {
+        return table.rows.items(field);
+    }
+
+    pub fn get(table: TypeTable, id: TypeId) Type {
+        const shape = table.rows.items(.shape)[id];
+        return .{
+            .name = table.rows.items(.name)[id],
+            .size = shape.size,
+            .dimension = shape.dimension,
+            .ptr_count = shape.ptr_count,
+            .struct_type = shape.struct_type,
+            .struct_id = table.rows.items(.struct_id)[id],
+            .qualifiers = shape.qualifiers,
+            .is_signed = shape.is_signed,
+        };
+    }
+
+    pub fn set(table: *TypeTable, id: TypeId, t: Type) void {
+        table.rows.set(id, toRow(t));
+    }
+
+    pub fn append(table: *TypeTable, gpa: mem.Allocator, t: Type) !void {
+        try table.rows.append(gpa, toRow(t));
+    }
+
+    pub fn ensureTotalCapacity(table: *TypeTable, gpa: mem.Allocator, capacity: usize) !void {
+        try table.rows.ensureTotalCapacity(gpa, capacity);
+    }
+
+    pub fn resize(table: *TypeTable, gpa: mem.Allocator, new_len: usize) !void {
+        try table.rows.resize(gpa, new_len);
+    }
+};
+
+pub const Variable = struct {
+    // Qualified with the namespaces, class or function it's defined in
     name: []const u8,
     type_id: TypeId,
+    is_tls: bool,
+    // Static location, null when it couldn't be read
+    address: ?u64 = null,
+};
+
+pub const StructMember = struct {
+    name: NameId,
+    type_id: TypeId,
     mem_loc: u32,
     bit_loc: u16,
     bit_size: u16,
+    kind: Kind = .field,
+
+    pub const Kind = enum(u8) {
+        field,
+        // C++ base class subobject, at mem_loc like any member
+        base,
+        // Placed by the most derived class, mem_loc means nothing
+        virtual_base,
+    };
 };
 
-const MemberId = u32;
+pub const MemberId = u32;
 const MemberRange = Range(MemberId);
 
-const StructId = u32;
+pub const StructId = u32;
 const InvalidStructId = std.math.maxInt(StructId);
-const StructRange = Range(StructId);
+pub const StructRange = Range(StructId);
 
-const Structure = struct {
+pub const Structure = struct {
     type_id: TypeId,
     member_range: MemberRange,
     inline_structures: StructRange = .{},
+    // Not POD for the purpose of layout, derived classes may then reuse
+    // its tail padding
+    non_pod: bool = false,
 };
 
-const Namespace = struct {
+pub const Namespace = struct {
     name: []const u8,
     struct_range: StructRange,
 };
 
+pub const ContainerFilter = union(enum) {
+    all,
+    name: []const u8,
+    substring: []const u8,
+
+    pub fn matches(f: ContainerFilter, name: []const u8, active_namespaces: []Namespace) bool {
+        switch (f) {
+            .all => return true,
+            .substring => |substring| return mem.indexOf(u8, name, substring) != null,
+            .name => |query| {
+                if (mem.eql(u8, name, query)) {
+                    return true;
+                }
+
+                // NOTE(radomski): Also accept the qualified name, ns1::ns2::name
+                var rest = query;
+                for (active_namespaces) |ns| {
+                    if (ns.name.len == 0) {
+                        continue;
+                    }
+                    if (!mem.startsWith(u8, rest, ns.name) or !mem.startsWith(u8, rest[ns.name.len..], "::")) {
+                        return false;
+                    }
+                    rest = rest[ns.name.len + 2 ..];
+                }
+                return rest.len != query.len and mem.eql(u8, rest, name);
+            },
+        }
+    }
+};
+
 pub fn Stack(comptime T: type) type {
     return struct {
         mem: []T,
-        top: u16 = 0,
+        top: u32 = 0,
+        allocator: mem.Allocator,
         const Self = @This();
 
-        pub fn init(capacity: u16, gpa: mem.Allocator) !Self {
+        pub fn init(capacity: u32, gpa: mem.Allocator) !Self {
             return Self{
                 .mem = try gpa.alloc(T, capacity),
+                .allocator = gpa,
             };
         }
 
-        pub fn push(s: *Self, obj: T) void {
+        pub fn push(s: *Self, obj: T) !void {
+            if (s.top == s.mem.len) {
+                s.mem = try s.allocator.realloc(s.mem, @maximum(s.mem.len * 2, 16));
+            }
             s.mem[s.top] = obj;
             s.top += 1;
         }
 
-        pub fn popTo(s: *Self, n: u16) void {
+        pub fn popTo(s: *Self, n: u32) void {
             s.top = n;
         }
 
-        pub fn sliceFrom(s: *Self, n: u16) []T {
+        pub fn sliceFrom(s: *Self, n: u32) []T {
             return s.mem[n..s.top];
         }
     };
 }
 
-const Context = struct {
+pub const Context = struct {
     const Self = @This();
 
-    types: std.ArrayList(Type),
+    types: TypeTable = .{},
     type_addresses: []TypeId = &[_]TypeId{},
-    structures: std.ArrayList(Structure),
-    members: std.ArrayList(StructMember),
+    structures: std.MultiArrayList(Structure) = .{},
+    members: std.MultiArrayList(StructMember) = .{},
+    names: NameTable,
     namespaces: std.ArrayListUnmanaged(Namespace) = .{},
     dwarf: Dwarf,
 
@@ -232,12 +572,73 @@ const Context = struct {
     member_scratch_stack: Stack(StructMember),
     structure_scratch_stack: Stack(Structure),
 
+    // Work stacks replacing recursion while parsing, see the frame types
+    type_frames: std.ArrayListUnmanaged(TypeFrame) = .{},
+    struct_frames: std.ArrayListUnmanaged(StructFrame) = .{},
+    open_namespaces: std.ArrayListUnmanaged(Namespace) = .{},
+
+    // CUs in the order they were parsed, with the first structure of each
+    parsed_cus: std.ArrayListUnmanaged(ParsedCu) = .{},
+
+    // Set with --perf-counters, parse then also samples them around every CU
+    perf: ?*Perf = null,
+    cu_counters: std.ArrayListUnmanaged(Perf.Sample) = .{},
+
+    // Set with --print-threads, threads formatting the output, all cores when null
+    print_threads: ?usize = null,
+
+    // Set with --summary, the directory each structure was declared in is
+    // then kept from DW_AT_decl_file, per file of the current CU's line table
+    decl_dirs: bool = false,
+    cu_file_dirs: []NameId = &[_]NameId{},
+    struct_decl_dirs: std.AutoHashMapUnmanaged(TypeId, NameId) = .{},
+
+    // Set with --globals, variables with a static or thread-local location
+    read_variables: bool = false,
+    variables: std.ArrayListUnmanaged(Variable) = .{},
+    // Static members declared in a class, by DIE address, to the class they
+    // get qualified with. Definitions can come before the class, they're
+    // qualified once everything is parsed.
+    static_member_scopes: std.AutoHashMapUnmanaged(usize, []const u8) = .{},
+    static_member_definitions: std.ArrayListUnmanaged(StaticMemberDefinition) = .{},
+
+    pub const ParsedCu = struct {
+        cu_index: u32,
+        first_structure: StructId,
+    };
+
+    const StaticMemberDefinition = struct {
+        variable_index: usize,
+        declaration: usize,
+        name: []const u8,
+    };
+
+    const TypeFrame = struct {
+        global_type_address: usize,
+        die_id: Dwarf.DieId,
+        // Where to continue reading attributes once the inner type is known
+        resume_pos: usize,
+        attr_idx: usize = 0,
+        name: ?NameId = null,
+        size: u32 = 0,
+        inner_type_id: ?u32 = null,
+        decl_file: ?usize = null,
+        is_signed: bool = false,
+    };
+
+    const StructFrame = struct {
+        type_id: TypeId,
+        tag: Dwarf.DW_TAG,
+        has_children: bool,
+        member_top_start: u32,
+        structure_top_start: u32,
+        non_pod: bool = false,
+    };
+
     pub fn init(allocator: mem.Allocator, dwarf: Dwarf) !Self {
         const estimated_num_of_members = dwarf.dies.items.len * 10;
         var c = Context{
-            .types = try std.ArrayList(Type).initCapacity(allocator, estimated_num_of_members),
-            .structures = try std.ArrayList(Structure).initCapacity(allocator, estimated_num_of_members),
-            .members = try std.ArrayList(StructMember).initCapacity(allocator, estimated_num_of_members),
+            .names = try NameTable.init(allocator, dwarf.debug_str.data),
             .dwarf = dwarf,
             .gpa = allocator,
             .arena = allocator,
@@ -245,22 +646,47 @@ const Context = struct {
             .member_scratch_stack = try Stack(StructMember).init(16 * 1024, allocator),
             .structure_scratch_stack = try Stack(Structure).init(4 * 1024, allocator),
         };
+        try c.types.ensureTotalCapacity(allocator, estimated_num_of_members);
+        try c.structures.ensureTotalCapacity(allocator, estimated_num_of_members);
+        try c.members.ensureTotalCapacity(allocator, estimated_num_of_members);
 
         return c;
     }
 
     pub fn addType(c: *Self, t: Type) !TypeId {
-        const id = @intCast(TypeId, c.types.items.len);
-        try c.types.append(t);
+        const id = @intCast(TypeId, c.types.len());
+        try c.types.append(c.gpa, t);
         return id;
     }
 
     pub fn addStruct(c: *Self, s: Structure) !StructId {
-        const id = @intCast(StructId, c.structures.items.len);
-        try c.structures.append(s);
+        const id = @intCast(StructId, c.structures.len);
+        try c.structures.append(c.gpa, s);
         return id;
     }
 
+    pub fn getName(c: *const Self, id: NameId) []const u8 {
+        return c.names.get(id);
+    }
+
+    // NOTE(radomski): Qualifiers aren't kept per pointer level, the pointee's
+    // go in the name instead, const char * is a pointer to `const char`
+    pub fn pointeeName(c: *Self, pointee: Type) !NameId {
+        if (pointee.ptr_count > 0 or !pointee.qualifiers.any()) {
+            return pointee.name;
+        }
+        const name = try mem.concat(c.gpa, u8, &.{ pointee.qualifiers.text(), c.getName(pointee.name) });
+        defer c.gpa.free(name);
+        return c.names.intern(c.arena, name);
+    }
+
+    fn readName(c: *Self, form: Dwarf.DW_FORM, attr_id: usize) !NameId {
+        return switch (try c.dwarf.readStringRef(form, attr_id)) {
+            .offset => |offset| c.names.reference(c.arena, offset),
+            .bytes => |bytes| c.names.intern(c.arena, bytes),
+        };
+    }
+
     fn namespaceLessThan(context: void, a: Namespace, b: Namespace) bool {
         _ = context;
         const a_sr = a.struct_range;
@@ -272,55 +698,149 @@ const Context = struct {
         }
     }
 
-    pub fn run(c: *Self) !void {
-        {
-            var timer = try std.time.Timer.start();
-            var biggest_cu_size: u32 = 0;
-            for (c.dwarf.cus.items) |cu| {
-                biggest_cu_size = @maximum(biggest_cu_size, cu.payload_size + cu.size);
-            }
-            c.type_addresses = try c.gpa.alloc(TypeId, biggest_cu_size);
-            mem.set(TypeId, c.type_addresses, std.math.maxInt(TypeId));
+    pub fn parse(c: *Self) !void {
+        return c.parseSelected(null);
+    }
+
+    // Parses only the CUs whose selected entry is set, all of them for null.
+    pub fn parseSelected(c: *Self, selected: ?[]const bool) !void {
+        var biggest_cu_size: u64 = 0;
+        for (c.dwarf.cus.items) |cu| {
+            biggest_cu_size = @maximum(biggest_cu_size, cu.payload_size + cu.size);
+        }
+        c.type_addresses = try c.gpa.alloc(TypeId, @intCast(usize, biggest_cu_size));
+        mem.set(TypeId, c.type_addresses, std.math.maxInt(TypeId));
 
-            for (c.dwarf.cus.items) |cu| {
-                c.dwarf.setCu(cu);
+        if (c.perf != null) {
+            try c.cu_counters.ensureTotalCapacity(c.arena, c.dwarf.cus.items.len);
+        }
 
-                // TODO(radomski): Kinda stupid?
-                while (c.dwarf.inCurrentCu()) {
-                    try c.readChildren();
+        try c.parsed_cus.ensureTotalCapacity(c.arena, c.dwarf.cus.items.len);
+        for (c.dwarf.cus.items) |cu, cu_index| {
+            if (selected) |s| {
+                if (!s[cu_index]) {
+                    continue;
                 }
+            }
+            c.parsed_cus.appendAssumeCapacity(.{ .cu_index = @intCast(u32, cu_index), .first_structure = @intCast(StructId, c.structures.len) });
+
+            const start_sample = if (c.perf) |perf| perf.read() else Perf.Sample{};
+            c.dwarf.setCu(cu);
+
+            // TODO(radomski): Kinda stupid?
+            while (c.dwarf.inCurrentCu()) {
+                try c.readChildren();
+            }
+
+            mem.set(TypeId, c.type_addresses[0 .. cu.size + cu.payload_size], std.math.maxInt(TypeId));
+            if (c.perf) |perf| {
+                c.cu_counters.appendAssumeCapacity(perf.read().sub(start_sample));
+            }
+        }
 
-                mem.set(TypeId, c.type_addresses[0 .. cu.size + cu.payload_size], std.math.maxInt(TypeId));
+        for (c.static_member_definitions.items) |definition| {
+            if (c.static_member_scopes.get(definition.declaration)) |scope| {
+                c.variables.items[definition.variable_index].name = try mem.concat(c.arena, u8, &.{ scope, definition.name });
             }
+        }
+    }
+
+    fn cuCountersGreaterThan(c: *Self, a: usize, b: usize) bool {
+        return c.cu_counters.items[a].values[0] > c.cu_counters.items[b].values[0];
+    }
+
+    // The CUs that took the most of the first counter, cycles or task-clock.
+    fn printCuCounters(c: *Self, perf: *Perf) !void {
+        const top_cus = 10;
+        var order = try c.arena.alloc(usize, c.cu_counters.items.len);
+        for (order) |*index, i| {
+            index.* = i;
+        }
+        std.sort.sort(usize, order, c, cuCountersGreaterThan);
+
+        for (order[0..@minimum(top_cus, order.len)]) |i| {
+            const cu_index = c.parsed_cus.items[i].cu_index;
+            const cu = c.dwarf.cus.items[cu_index];
+            var label_buffer: [64]u8 = undefined;
+            const label = std.fmt.bufPrint(&label_buffer, "  CU {} at 0x{x} ({})", .{
+                cu_index,
+                cu.offset - cu.size,
+                fmt.fmtIntSizeBin(cu.payload_size),
+            }) catch "  CU";
+            perf.print(label, c.cu_counters.items[i]);
+        }
+    }
+
+    pub fn sortNamespaces(c: *Self) void {
+        mem.reverse(Namespace, c.namespaces.items);
+        std.sort.sort(Namespace, c.namespaces.items, {}, namespaceLessThan);
+    }
+
+    fn printPhaseCounters(c: *Self, label: []const u8, start_sample: Perf.Sample) void {
+        if (c.perf) |perf| {
+            perf.print(label, perf.read().sub(start_sample));
+        }
+    }
+
+    fn readCounters(c: *Self) Perf.Sample {
+        return if (c.perf) |perf| perf.read() else Perf.Sample{};
+    }
+
+    pub fn run(c: *Self) !void {
+        // NOTE(radomski): No units when the tables were loaded from BTF
+        if (c.dwarf.cus.items.len > 0) {
+            const start_sample = c.readCounters();
+            var timer = try std.time.Timer.start();
+            try c.parse();
             const ns = timer.read();
             const elapsed_s = @intToFloat(f64, ns) / time.ns_per_s;
             const throughput = @floatToInt(u64, @intToFloat(f64, c.dwarf.debug_info.data.len) / elapsed_s);
             std.debug.print("Parsing: {}[{}/s]\n", .{ std.fmt.fmtDuration(ns), std.fmt.fmtIntSizeDec(throughput) });
+            c.printPhaseCounters("  counters", start_sample);
+            if (c.perf) |perf| {
+                try c.printCuCounters(perf);
+            }
         }
 
         {
+            const start_sample = c.readCounters();
             var timer = try std.time.Timer.start();
-            mem.reverse(Namespace, c.namespaces.items);
-            std.sort.sort(Namespace, c.namespaces.items, {}, namespaceLessThan);
+            c.sortNamespaces();
             const ns = timer.read();
             std.debug.print("Sorting namespaces: {}\n", .{std.fmt.fmtDuration(ns)});
+            c.printPhaseCounters("  counters", start_sample);
         }
 
         {
+            const start_sample = c.readCounters();
             var timer = try std.time.Timer.start();
             try c.printContainers();
             const ns = timer.read();
             std.debug.print("Printing: {}\n", .{std.fmt.fmtDuration(ns)});
+            c.printPhaseCounters("  counters", start_sample);
         }
 
-        std.log.debug("types {}/{}", .{ c.types.items.len, fmt.fmtIntSizeDec(c.types.items.len * @sizeOf(Type)) });
-        std.log.debug("structures {}/{}", .{ c.structures.items.len, fmt.fmtIntSizeDec(c.structures.items.len * @sizeOf(Structure)) });
-        std.log.debug("members {}/{}", .{ c.members.items.len, fmt.fmtIntSizeDec(c.members.items.len * @sizeOf(StructMember)) });
+        const types_size = c.types.len() * rowSize(TypeTable.Row);
+        const structures_size = c.structures.len * rowSize(Structure);
+        const members_size = c.members.len * rowSize(StructMember);
+        const names_size = c.names.bytes.items.len + c.names.map.capacity() * (@sizeOf(NameId) + 1);
+        std.log.debug("types {}/{}", .{ c.types.len(), fmt.fmtIntSizeDec(types_size) });
+        std.log.debug("structures {}/{}", .{ c.structures.len, fmt.fmtIntSizeDec(structures_size) });
+        std.log.debug("members {}/{}", .{ c.members.len, fmt.fmtIntSizeDec(members_size) });
+        std.log.debug("names {}/{}", .{ c.names.map.count(), fmt.fmtIntSizeDec(names_size) });
+        std.log.debug("tables {}", .{fmt.fmtIntSizeDec(types_size + structures_size + members_size + names_size)});
     }
 
     pub fn readChildren(c: *Context) !void {
+        const open_namespaces_start = c.open_namespaces.items.len;
         while (c.dwarf.readNextDie()) |global_die_address| {
-            const die_id = try c.dwarf.readDieIdAtAddress(global_die_address) orelse break;
+            const die_id = try c.dwarf.readDieIdAtAddress(global_die_address) orelse {
+                if (c.open_namespaces.items.len == open_namespaces_start) {
+                    break;
+                }
+                try c.closeNamespace();
+                continue;
+            };
             const die = c.dwarf.dies.items[die_id];
 
             switch (die.tag) {
@@ -334,23 +854,216 @@ const Context = struct {
                     try c.readTypedefAtAddress(global_die_address, die_id);
                 },
                 Dwarf.DW_TAG.namespace => {
-                    var namespace = try c.readNamespace(global_die_address);
+                    const namespace = try c.readNamespace(global_die_address);
                     if (die.has_children) {
-                        try c.readChildren();
-                        namespace.struct_range.end = @intCast(u32, c.structures.items.len);
-                        if (namespace.struct_range.len() > 0) {
-                            try c.namespaces.append(c.arena, namespace);
-                        }
+                        try c.open_namespaces.append(c.arena, namespace);
+                    }
+                },
+                Dwarf.DW_TAG.variable => {
+                    if (c.read_variables) {
+                        try c.readVariable(die_id, "");
+                    } else {
+                        try c.dwarf.skipDieAndChildren(die_id);
+                    }
+                },
+                Dwarf.DW_TAG.subprogram => {
+                    if (c.read_variables and die.has_children) {
+                        try c.readFunctionStatics(die_id);
+                    } else {
+                        try c.dwarf.skipDieAndChildren(die_id);
                     }
                 },
                 Dwarf.DW_TAG.compile_unit => {
-                    c.dwarf.skipDieAttrs(die_id);
+                    if (c.decl_dirs or c.read_variables) {
+                        try c.readCuAttrs(die_id);
+                    } else {
+                        c.dwarf.skipDieAttrs(die_id);
+                    }
                 },
                 else => {
                     try c.dwarf.skipDieAndChildren(die_id);
                 },
             }
         }
+
+        // NOTE(radomski): Truncated unit, close whatever is still open
+        while (c.open_namespaces.items.len > open_namespaces_start) {
+            try c.closeNamespace();
+        }
+    }
+
+    // The line table directories for --summary, where .debug_addr entries of
+    // the unit start for --globals
+    fn readCuAttrs(c: *Context, die_id: Dwarf.DieId) !void {
+        const die = c.dwarf.dies.items[die_id];
+        var stmt_list: ?usize = null;
+        var comp_dir: []const u8 = "";
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .stmt_list => {
+                    stmt_list = try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx);
+                },
+                .comp_dir => {
+                    comp_dir = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx);
+                },
+                .addr_base => {
+                    c.dwarf.addr_base = try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx);
+                },
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+
+        c.cu_file_dirs = &[_]NameId{};
+        if (!c.decl_dirs) {
+            return;
+        }
+        if (stmt_list) |offset| {
+            // NOTE(radomski): A broken line table only costs the directories
+            const dirs = c.dwarf.readLineFileDirs(offset, comp_dir, c.arena) catch return;
+            c.cu_file_dirs = try c.arena.alloc(NameId, dirs.len);
+            for (dirs) |dir, i| {
+                c.cu_file_dirs[i] = try c.names.intern(c.arena, dir);
+            }
+        }
+    }
+
+    // Static locals of a function, in lexical blocks at any depth. Locals on
+    // the stack or in registers have no static location and are dropped.
+    fn readFunctionStatics(c: *Context, die_id: Dwarf.DieId) !void {
+        const die = c.dwarf.dies.items[die_id];
+        var function_name: []const u8 = "";
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .name => function_name = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx),
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+
+        var depth: usize = 1;
+        while (depth > 0) {
+            const child_global_die_address = c.dwarf.readNextDie() orelse break;
+            const child_die_id = try c.dwarf.readDieIdAtAddress(child_global_die_address) orelse {
+                depth -= 1;
+                continue;
+            };
+            const child_die = c.dwarf.dies.items[child_die_id];
+            switch (child_die.tag) {
+                Dwarf.DW_TAG.variable => try c.readVariable(child_die_id, function_name),
+                Dwarf.DW_TAG.lexical_block => {
+                    c.dwarf.skipDieAttrs(child_die_id);
+                    if (child_die.has_children) {
+                        depth += 1;
+                    }
+                },
+                else => try c.dwarf.skipDieAndChildren(child_die_id),
+            }
+        }
+    }
+
+    // Variables of the unit and its namespaces, or the static locals of
+    // function_name when it's given.
+    fn readVariable(c: *Context, die_id: Dwarf.DieId, function_name: []const u8) !void {
+        const die = c.dwarf.dies.items[die_id];
+        var name: []const u8 = "";
+        var type_id: ?TypeId = null;
+        var location = Dwarf.Location{};
+        var declaration: ?usize = null;
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .name => name = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx),
+                .type => type_id = try c.readVariableType(attr.form, die.attr_range.start + attr_idx),
+                .location => location = try c.dwarf.readVariableLocation(attr.form),
+                .specification, .abstract_origin => declaration = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(
+                    attr.form,
+                    die.attr_range.start + attr_idx,
+                )),
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+        if (die.has_children) {
+            try c.dwarf.skipChildren();
+        }
+        if (location.storage == .none) {
+            return;
+        }
+
+        // Definition of a static member or of a variable declared in a
+        // namespace, the name and the type are on the declaration
+        if (declaration) |address| {
+            try c.dwarf.pushAddress();
+            defer c.dwarf.popAddress();
+            const decl_die_id = try c.dwarf.readDieIdAtAddress(address) orelse return error.InvalidTypeReference;
+            const decl_die = c.dwarf.dies.items[decl_die_id];
+            for (c.dwarf.getAttrs(decl_die.attr_range)) |attr, attr_idx| {
+                switch (attr.at) {
+                    .name => name = try c.dwarf.readString(attr.form, decl_die.attr_range.start + attr_idx),
+                    .type => type_id = try c.readVariableType(attr.form, decl_die.attr_range.start + attr_idx),
+                    else => c.dwarf.skipFormData(attr.form),
+                }
+            }
+        }
+
+        const variable_type_id = type_id orelse return;
+        var qualified = std.ArrayList(u8).init(c.arena);
+        for (c.open_namespaces.items) |ns| {
+            if (ns.name.len > 0) {
+                try qualified.appendSlice(ns.name);
+                try qualified.appendSlice("::");
+            }
+        }
+        if (function_name.len > 0) {
+            try qualified.appendSlice(function_name);
+            try qualified.appendSlice("::");
+        }
+        try qualified.appendSlice(name);
+        if (declaration) |address| {
+            try c.static_member_definitions.append(c.arena, .{
+                .variable_index = c.variables.items.len,
+                .declaration = address,
+                .name = name,
+            });
+        }
+        try c.variables.append(c.arena, .{
+            .name = qualified.items,
+            .type_id = variable_type_id,
+            .is_tls = location.storage == .tls,
+            .address = location.address,
+        });
+    }
+
+    // NOTE(radomski): Declared in the structures being parsed, in the
+    // namespaces open around them
+    fn addStaticMemberScope(c: *Context, global_die_address: usize) !void {
+        var scope = std.ArrayList(u8).init(c.arena);
+        for (c.open_namespaces.items) |ns| {
+            if (ns.name.len > 0) {
+                try scope.appendSlice(ns.name);
+                try scope.appendSlice("::");
+            }
+        }
+        for (c.struct_frames.items) |frame| {
+            const name = c.getName(c.types.items(.name)[frame.type_id]);
+            if (name.len > 0) {
+                try scope.appendSlice(name);
+                try scope.appendSlice("::");
+            }
+        }
+        try c.static_member_scopes.put(c.arena, global_die_address, scope.items);
+    }
+
+    fn readVariableType(c: *Context, form: Dwarf.DW_FORM, attr_id: usize) !TypeId {
+        const global_type_address = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(form, attr_id));
+        try c.dwarf.pushAddress();
+        defer c.dwarf.popAddress();
+        return c.readTypeAtAddressAndNoSkip(global_type_address);
+    }
+
+    fn closeNamespace(c: *Context) !void {
+        var namespace = c.open_namespaces.pop();
+        namespace.struct_range.end = @intCast(u32, c.structures.len);
+        if (namespace.struct_range.len() > 0) {
+            try c.namespaces.append(c.arena, namespace);
+        }
     }
 
     pub fn readNamespace(c: *Context, global_die_address: usize) !Namespace {
@@ -373,23 +1086,23 @@ const Context = struct {
 
         return Namespace{
             .name = name,
-            .struct_range = .{ .start = @intCast(u32, c.structures.items.len) },
+            .struct_range = .{ .start = @intCast(u32, c.structures.len) },
         };
     }
 
     pub fn parseStructure(c: *Context, global_die_address: usize, die_id: Dwarf.DieId, tag: Dwarf.DW_TAG) !Structure {
         const stype_id = try c.readTypeAtAddressAndNoSkip(global_die_address);
-        const stype = c.types.items[stype_id];
+        const stype = c.types.get(stype_id);
         if (stype.struct_id != std.math.maxInt(@TypeOf(stype.struct_id))) {
             try c.dwarf.skipDieAndChildren(die_id);
-            return c.structures.items[stype.struct_id];
+            return c.structures.get(stype.struct_id);
         }
 
         const s = try c.parseStructureImpl(global_die_address, die_id);
 
         const id = try c.addStruct(s);
-        c.types.items[s.type_id].struct_id = id;
-        c.types.items[s.type_id].struct_type = switch (tag) {
+        c.types.items(.struct_id)[s.type_id] = id;
+        c.types.items(.shape)[s.type_id].struct_type = switch (tag) {
             .structure_type => .struct_type,
             .union_type => .union_type,
             .class_type => .class_type,
@@ -399,121 +1112,287 @@ const Context = struct {
         return s;
     }
 
+    // NOTE(radomski): Nested structures get a frame on struct_frames instead of
+    // a recursive call, the innermost one being parsed is always on top.
     pub fn parseStructureImpl(c: *Context, global_die_address: usize, die_id: Dwarf.DieId) TypeError!Structure {
-        const die = c.dwarf.dies.items[die_id];
-        const stype_id = try c.readTypeAtAddressAndSkip(global_die_address);
-
+        const frames_start = c.struct_frames.items.len;
         const member_top_start = c.member_scratch_stack.top;
-        defer c.member_scratch_stack.popTo(member_top_start);
         const structure_top_start = c.structure_scratch_stack.top;
-        defer c.structure_scratch_stack.popTo(structure_top_start);
-
-        if (die.has_children) {
-            while (c.dwarf.readNextDie()) |child_global_die_address| {
-                const child_die_id = try c.dwarf.readDieIdAtAddress(child_global_die_address) orelse break;
-                const child_die = c.dwarf.dies.items[child_die_id];
-
-                switch (child_die.tag) {
-                    Dwarf.DW_TAG.member => {
-                        var add_this_member = true;
-                        var member = mem.zeroes(StructMember);
-                        for (c.dwarf.getAttrs(child_die.attr_range)) |attr, attr_idx| {
-                            switch (attr.at) {
-                                .type => {
-                                    const global_type_address = c.dwarf.toGlobalAddr(@intCast(u32, try c.dwarf.readFormData(
-                                        attr.form,
-                                        child_die.attr_range.start + attr_idx,
-                                    )));
-                                    c.dwarf.pushAddress();
-                                    member.type_id = try c.readTypeAtAddressAndNoSkip(global_type_address);
-                                    c.dwarf.popAddress();
-                                },
-                                .data_member_location => member.mem_loc = @intCast(u32, try c.dwarf.readFormData(
-                                    attr.form,
-                                    child_die.attr_range.start + attr_idx,
-                                )),
-                                .bit_offset => {
-                                    // TODO(radomski): bit_size might not be read at this point
-                                    const form_data = @intCast(u16, try c.dwarf.readFormData(attr.form, child_die.attr_range.start + attr_idx));
-                                    const type_bit_size = c.types.items[member.type_id].size * 8;
-                                    member.bit_loc = @intCast(u16, type_bit_size - (member.bit_size + form_data));
-                                },
-                                .data_bit_offset => {
-                                    // TODO(radomski): bit_size might not be read at this point
-                                    const form_data = try c.dwarf.readFormData(attr.form, child_die.attr_range.start + attr_idx);
-                                    const type_bit_size = c.types.items[member.type_id].size * 8;
-                                    const value = @intCast(u32, form_data % type_bit_size);
-                                    member.mem_loc += @intCast(u32, form_data) / type_bit_size;
-                                    const bit_loc = @intCast(u16, (type_bit_size) - value - member.bit_size);
-                                    member.bit_loc = @intCast(u16, type_bit_size - (member.bit_size + bit_loc));
-                                },
-                                .bit_size => member.bit_size = @intCast(u16, try c.dwarf.readFormData(
-                                    attr.form,
-                                    child_die.attr_range.start + attr_idx,
-                                )),
-                                .name => member.name = try c.dwarf.readString(attr.form, child_die.attr_range.start + attr_idx),
-                                .external => {
-                                    // NOTE(radomski): always assume that it is external
-                                    c.dwarf.skipFormData(attr.form);
-                                    add_this_member = false;
-                                },
-                                else => c.dwarf.skipFormData(attr.form),
-                            }
-                        }
+        errdefer {
+            c.struct_frames.shrinkRetainingCapacity(frames_start);
+            c.member_scratch_stack.popTo(member_top_start);
+            c.structure_scratch_stack.popTo(structure_top_start);
+        }
 
-                        if (add_this_member) {
-                            c.member_scratch_stack.push(member);
-                        }
-                    },
-                    .structure_type => {
-                        const s = try c.parseStructureImpl(child_global_die_address, child_die_id);
-                        c.types.items[s.type_id].struct_type = .struct_type;
-                        c.structure_scratch_stack.push(s);
-                    },
-                    .union_type => {
-                        const s = try c.parseStructureImpl(child_global_die_address, child_die_id);
-                        c.types.items[s.type_id].struct_type = .union_type;
-                        c.structure_scratch_stack.push(s);
-                    },
-                    .class_type => {
-                        const s = try c.parseStructureImpl(child_global_die_address, child_die_id);
-                        c.types.items[s.type_id].struct_type = .class_type;
-                        c.structure_scratch_stack.push(s);
-                    },
-                    else => try c.dwarf.skipDieAndChildren(child_die_id),
-                }
+        try c.pushStructFrame(global_die_address, die_id);
+        while (true) {
+            const frame = c.struct_frames.items[c.struct_frames.items.len - 1];
+            if (frame.has_children and try c.readStructureChildren()) {
+                continue;
             }
-        }
 
-        const member_start_id = c.members.items.len;
-        try c.members.appendSlice(c.member_scratch_stack.sliceFrom(member_top_start));
-        const member_end_id = c.members.items.len;
+            _ = c.struct_frames.pop();
+            const s = try c.finishStructFrame(frame);
+            if (c.struct_frames.items.len == frames_start) {
+                return s;
+            }
 
-        const struct_start_id = c.structures.items.len;
-        for (c.structure_scratch_stack.sliceFrom(structure_top_start)) |s| {
-            const id = try c.addStruct(s);
-            c.types.items[s.type_id].struct_id = id;
+            c.types.items(.shape)[s.type_id].struct_type = switch (frame.tag) {
+                .structure_type => .struct_type,
+                .union_type => .union_type,
+                .class_type => .class_type,
+                else => unreachable,
+            };
+            try c.structure_scratch_stack.push(s);
         }
-        const struct_end_id = c.structures.items.len;
+    }
 
-        const structure = Structure{
+    fn pushStructFrame(c: *Context, global_die_address: usize, die_id: Dwarf.DieId) TypeError!void {
+        const die = c.dwarf.dies.items[die_id];
+        const stype_id = try c.readTypeAtAddressAndSkip(global_die_address);
+        try c.struct_frames.append(c.arena, .{
             .type_id = stype_id,
-            .member_range = MemberRange{
-                .start = @intCast(MemberId, member_start_id),
-                .end = @intCast(MemberId, member_end_id),
-            },
-            .inline_structures = StructRange{
-                .start = @intCast(StructId, struct_start_id),
-                .end = @intCast(StructId, struct_end_id),
-            },
-        };
-
-        return structure;
+            .tag = die.tag,
+            .has_children = die.has_children,
+            .member_top_start = c.member_scratch_stack.top,
+            .structure_top_start = c.structure_scratch_stack.top,
+        });
     }
 
-    pub fn readTypeAtAddressAndNoSkip(c: *Context, global_type_address: usize) TypeError!TypeId {
-        const local_type_address = c.dwarf.toLocalAddr(global_type_address);
-        if (c.type_addresses[local_type_address] != std.math.maxInt(TypeId)) {
+    // Reads children of the structure on top of struct_frames until they end,
+    // or until a nested structure got its own frame, then returns true.
+    fn readStructureChildren(c: *Context) TypeError!bool {
+        const frame = &c.struct_frames.items[c.struct_frames.items.len - 1];
+        while (c.dwarf.readNextDie()) |child_global_die_address| {
+            const child_die_id = try c.dwarf.readDieIdAtAddress(child_global_die_address) orelse break;
+            const child_die = c.dwarf.dies.items[child_die_id];
+
+            switch (child_die.tag) {
+                Dwarf.DW_TAG.member => {
+                    if (try c.readMember(child_die_id, frame)) |member| {
+                        try c.member_scratch_stack.push(member);
+                    } else if (c.read_variables) {
+                        try c.addStaticMemberScope(child_global_die_address);
+                    }
+                },
+                // Static members since DWARF 5
+                Dwarf.DW_TAG.variable => {
+                    if (c.read_variables) {
+                        try c.addStaticMemberScope(child_global_die_address);
+                    }
+                    try c.dwarf.skipDieAndChildren(child_die_id);
+                },
+                Dwarf.DW_TAG.inheritance => {
+                    frame.non_pod = true;
+                    try c.member_scratch_stack.push(try c.readInheritance(child_die_id));
+                },
+                Dwarf.DW_TAG.subprogram => {
+                    // NOTE(radomski): Only read while it can still change
+                    // anything, most classes have plenty of methods
+                    if (!frame.non_pod) {
+                        frame.non_pod = try c.isNonPodMethod(child_die_id, frame.type_id);
+                        if (child_die.has_children) {
+                            try c.dwarf.skipChildren();
+                        }
+                    } else {
+                        try c.dwarf.skipDieAndChildren(child_die_id);
+                    }
+                },
+                .structure_type,
+                .union_type,
+                .class_type,
+                => {
+                    try c.pushStructFrame(child_global_die_address, child_die_id);
+                    return true;
+                },
+                else => try c.dwarf.skipDieAndChildren(child_die_id),
+            }
+        }
+
+        return false;
+    }
+
+    fn readMember(c: *Context, die_id: Dwarf.DieId, frame: *StructFrame) TypeError!?StructMember {
+        const die = c.dwarf.dies.items[die_id];
+        var add_this_member = true;
+        var member = mem.zeroes(StructMember);
+        // Members of a class are private unless said otherwise
+        var accessibility: usize = if (frame.tag == .class_type) DW_ACCESS_private else DW_ACCESS_public;
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .accessibility => accessibility = try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx),
+                // _vptr, only there with virtual functions or bases
+                .artificial => {
+                    c.dwarf.skipFormData(attr.form);
+                    frame.non_pod = true;
+                },
+                .type => {
+                    const global_type_address = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(
+                        attr.form,
+                        die.attr_range.start + attr_idx,
+                    ));
+                    try c.dwarf.pushAddress();
+                    member.type_id = try c.readTypeAtAddressAndNoSkip(global_type_address);
+                    c.dwarf.popAddress();
+                },
+                .data_member_location => member.mem_loc = @intCast(u32, try c.dwarf.readFormData(
+                    attr.form,
+                    die.attr_range.start + attr_idx,
+                )),
+                .bit_offset => {
+                    // TODO(radomski): bit_size might not be read at this point
+                    const form_data = @intCast(u16, try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx));
+                    const type_bit_size = c.types.items(.shape)[member.type_id].size * 8;
+                    member.bit_loc = @intCast(u16, type_bit_size - (member.bit_size + form_data));
+                },
+                .data_bit_offset => {
+                    // TODO(radomski): bit_size might not be read at this point
+                    const form_data = try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx);
+                    const type_bit_size = c.types.items(.shape)[member.type_id].size * 8;
+                    const value = @intCast(u32, form_data % type_bit_size);
+                    member.mem_loc += @intCast(u32, form_data) / type_bit_size;
+                    const bit_loc = @intCast(u16, (type_bit_size) - value - member.bit_size);
+                    member.bit_loc = @intCast(u16, type_bit_size - (member.bit_size + bit_loc));
+                },
+                .bit_size => member.bit_size = @intCast(u16, try c.dwarf.readFormData(
+                    attr.form,
+                    die.attr_range.start + attr_idx,
+                )),
+                .name => member.name = try c.readName(attr.form, die.attr_range.start + attr_idx),
+                .external => {
+                    // NOTE(radomski): always assume that it is external
+                    c.dwarf.skipFormData(attr.form);
+                    add_this_member = false;
+                },
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+
+        if (!add_this_member) {
+            return null;
+        }
+        if (accessibility != DW_ACCESS_public) {
+            frame.non_pod = true;
+        }
+        const struct_id = c.types.items(.struct_id)[member.type_id];
+        if (struct_id != InvalidStructId and c.structures.items(.non_pod)[struct_id]) {
+            frame.non_pod = true;
+        }
+        return member;
+    }
+
+    const DW_ACCESS_public = 1;
+    const DW_ACCESS_private = 3;
+
+    fn readInheritance(c: *Context, die_id: Dwarf.DieId) TypeError!StructMember {
+        const die = c.dwarf.dies.items[die_id];
+        var member = mem.zeroes(StructMember);
+        member.kind = .base;
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .type => {
+                    const global_type_address = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(
+                        attr.form,
+                        die.attr_range.start + attr_idx,
+                    ));
+                    try c.dwarf.pushAddress();
+                    member.type_id = try c.readTypeAtAddressAndNoSkip(global_type_address);
+                    c.dwarf.popAddress();
+                },
+                .data_member_location => {
+                    // NOTE(radomski): Virtual bases are found through the
+                    // vtable, their location is an expression doing that
+                    if (try c.dwarf.readMemberLocation(attr.form, die.attr_range.start + attr_idx)) |offset| {
+                        member.mem_loc = @intCast(u32, offset);
+                    } else {
+                        member.kind = .virtual_base;
+                    }
+                },
+                .virtuality => {
+                    if (try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx) != 0) {
+                        member.kind = .virtual_base;
+                    }
+                },
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+        if (member.kind == .virtual_base) {
+            member.mem_loc = 0;
+        }
+        return member;
+    }
+
+    // User declared constructors, destructors, copy assignment and virtual
+    // functions make a class non-POD.
+    fn isNonPodMethod(c: *Context, die_id: Dwarf.DieId, class_type_id: TypeId) TypeError!bool {
+        const die = c.dwarf.dies.items[die_id];
+        var name: []const u8 = "";
+        var artificial = false;
+        var virtual = false;
+        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
+            switch (attr.at) {
+                .name => name = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx),
+                .artificial => {
+                    c.dwarf.skipFormData(attr.form);
+                    artificial = true;
+                },
+                .virtuality => {
+                    virtual = try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx) != 0;
+                },
+                else => c.dwarf.skipFormData(attr.form),
+            }
+        }
+
+        if (virtual) {
+            return true;
+        }
+        if (artificial) {
+            return false;
+        }
+        // Constructors of a template are named without the arguments
+        const class_name = c.getName(c.types.items(.name)[class_type_id]);
+        const ctor_name = class_name[0 .. mem.indexOfScalar(u8, class_name, '<') orelse class_name.len];
+        return name.len > 0 and (mem.eql(u8, name, ctor_name) or name[0] == '~' or mem.eql(u8, name, "operator="));
+    }
+
+    fn finishStructFrame(c: *Context, frame: StructFrame) TypeError!Structure {
+        defer c.member_scratch_stack.popTo(frame.member_top_start);
+        defer c.structure_scratch_stack.popTo(frame.structure_top_start);
+
+        const member_start_id = c.members.len;
+        const new_members = c.member_scratch_stack.sliceFrom(frame.member_top_start);
+        try c.members.ensureUnusedCapacity(c.gpa, new_members.len);
+        for (new_members) |member| {
+            c.members.appendAssumeCapacity(member);
+        }
+        const member_end_id = c.members.len;
+
+        const struct_start_id = c.structures.len;
+        for (c.structure_scratch_stack.sliceFrom(frame.structure_top_start)) |s| {
+            const id = try c.addStruct(s);
+            c.types.items(.struct_id)[s.type_id] = id;
+        }
+        const struct_end_id = c.structures.len;
+
+        const structure = Structure{
+            .type_id = frame.type_id,
+            .non_pod = frame.non_pod,
+            .member_range = MemberRange{
+                .start = @intCast(MemberId, member_start_id),
+                .end = @intCast(MemberId, member_end_id),
+            },
+            .inline_structures = StructRange{
+                .start = @intCast(StructId, struct_start_id),
+                .end = @intCast(StructId, struct_end_id),
+            },
+        };
+
+        return structure;
+    }
+
+    pub fn readTypeAtAddressAndNoSkip(c: *Context, global_type_address: usize) TypeError!TypeId {
+        const local_type_address = c.dwarf.toLocalAddr(global_type_address);
+        if (c.type_addresses[local_type_address] != std.math.maxInt(TypeId)) {
             return c.type_addresses[local_type_address];
         }
 
@@ -531,27 +1410,89 @@ const Context = struct {
         return try c.readTypeAtAddressIfNotCached(global_type_address);
     }
 
+    // NOTE(radomski): Every type still waiting on its DW_AT_type has a frame on
+    // type_frames, long pointer/typedef/array chains only cost arena memory.
     pub fn readTypeAtAddressIfNotCached(c: *Context, global_type_address: usize) TypeError!TypeId {
-        const die_id = try c.dwarf.readDieIdAtAddress(global_type_address) orelse unreachable;
-        const die = c.dwarf.dies.items[die_id];
-        const default_name = if (die.tag == .structure_type or die.tag == .union_type or die.tag == .class_type) "" else "void";
+        const frames_start = c.type_frames.items.len;
+        errdefer {
+            for (c.type_frames.items[frames_start..]) |frame| {
+                c.type_addresses[c.dwarf.toLocalAddr(frame.global_type_address)] = std.math.maxInt(TypeId);
+            }
+            c.type_frames.shrinkRetainingCapacity(frames_start);
+        }
+
+        try c.pushTypeFrame(global_type_address);
+        while (true) {
+            const frame = &c.type_frames.items[c.type_frames.items.len - 1];
+            c.dwarf.debug_info.curr_pos = frame.resume_pos;
+            if (try c.readTypeAttrs(frame)) |inner_type_address| {
+                try c.pushTypeFrame(inner_type_address);
+                continue;
+            }
+
+            const id = try c.finishTypeFrame(frame.*);
+            _ = c.type_frames.pop();
+            if (c.type_frames.items.len == frames_start) {
+                return id;
+            }
+            c.type_frames.items[c.type_frames.items.len - 1].inner_type_id = id;
+        }
+    }
+
+    fn pushTypeFrame(c: *Context, global_type_address: usize) TypeError!void {
+        const die_id = try c.dwarf.readDieIdAtAddress(global_type_address) orelse return error.InvalidTypeReference;
+        try c.type_frames.append(c.arena, .{
+            .global_type_address = global_type_address,
+            .die_id = die_id,
+            .resume_pos = c.dwarf.debug_info.curr_pos,
+        });
+        c.type_addresses[c.dwarf.toLocalAddr(global_type_address)] = InProgressTypeId;
+    }
+
+    // Reads attributes of the type on top of type_frames, stops at a DW_AT_type
+    // that isn't cached yet and returns its address.
+    fn readTypeAttrs(c: *Context, frame: *TypeFrame) TypeError!?usize {
+        const die = c.dwarf.dies.items[frame.die_id];
+        const attrs = c.dwarf.getAttrs(die.attr_range);
+        while (frame.attr_idx < attrs.len) {
+            const attr = attrs[frame.attr_idx];
+            const attr_id = die.attr_range.start + frame.attr_idx;
+            frame.attr_idx += 1;
 
-        var name: ?[]const u8 = null;
-        var size: u32 = 0;
-        var inner_type_id: ?u32 = null;
-        for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
             switch (attr.at) {
                 Dwarf.DW_AT.name => {
-                    name = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx);
+                    frame.name = try c.readName(attr.form, attr_id);
                 },
                 Dwarf.DW_AT.byte_size => {
-                    size = @intCast(u32, try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx));
+                    frame.size = @intCast(u32, try c.dwarf.readFormData(attr.form, attr_id));
+                },
+                Dwarf.DW_AT.encoding => {
+                    const encoding = try c.dwarf.readFormData(attr.form, attr_id);
+                    frame.is_signed = encoding == Dwarf.DW_ATE_signed or encoding == Dwarf.DW_ATE_signed_char;
+                },
+                Dwarf.DW_AT.decl_file => {
+                    if (c.decl_dirs) {
+                        frame.decl_file = try c.dwarf.readFormData(attr.form, attr_id);
+                    } else {
+                        c.dwarf.skipFormData(attr.form);
+                    }
                 },
                 Dwarf.DW_AT.type => {
-                    const inner_type_address = c.dwarf.toGlobalAddr(@intCast(u32, try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx)));
-                    c.dwarf.pushAddress();
-                    inner_type_id = try c.readTypeAtAddressAndNoSkip(inner_type_address);
-                    c.dwarf.popAddress();
+                    const inner_type_address = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(attr.form, attr_id));
+                    const local_type_address = c.dwarf.toLocalAddr(inner_type_address);
+                    if (local_type_address >= c.type_addresses.len) {
+                        return error.InvalidTypeReference;
+                    }
+
+                    const cached_id = c.type_addresses[local_type_address];
+                    if (cached_id == InProgressTypeId) {
+                        return error.CyclicTypeReference;
+                    } else if (cached_id != std.math.maxInt(TypeId)) {
+                        frame.inner_type_id = cached_id;
+                    } else {
+                        frame.resume_pos = c.dwarf.debug_info.curr_pos;
+                        return inner_type_address;
+                    }
                 },
                 else => {
                     c.dwarf.skipFormData(attr.form);
@@ -559,6 +1500,17 @@ const Context = struct {
             }
         }
 
+        return null;
+    }
+
+    fn finishTypeFrame(c: *Context, frame: TypeFrame) TypeError!TypeId {
+        const die = c.dwarf.dies.items[frame.die_id];
+        const is_container = die.tag == .structure_type or die.tag == .union_type or die.tag == .class_type;
+        const default_name = if (is_container) "" else "void";
+        var name = frame.name;
+        var size = frame.size;
+        const inner_type_id = frame.inner_type_id;
+
         var dimension: u32 = std.math.maxInt(u32);
         if (die.tag == Dwarf.DW_TAG.array_type) {
             dimension = 1;
@@ -585,37 +1537,70 @@ const Context = struct {
         }
 
         var ptr_count: u8 = 0;
+        var qualifiers = Type.Qualifiers{};
+        var is_signed = frame.is_signed;
         if (die.tag == Dwarf.DW_TAG.pointer_type) {
             size = c.dwarf.getPointerSize();
             ptr_count = 1;
             if (inner_type_id) |inner_id| {
+                const inner_type = c.types.get(inner_id);
                 if (name == null) {
-                    name = c.types.items[inner_id].name;
+                    name = try c.pointeeName(inner_type);
                 }
 
-                ptr_count += c.types.items[inner_id].ptr_count;
+                ptr_count += inner_type.ptr_count;
             }
         } else {
             if (inner_type_id) |inner_id| {
+                const inner_type = c.types.get(inner_id);
                 if (name == null) {
-                    name = c.types.items[inner_id].name;
+                    name = inner_type.name;
                 }
                 if (size == 0) {
-                    size = c.types.items[inner_id].size;
-                    if (c.types.items[inner_id].isArray()) {
-                        size *= c.types.items[inner_id].dimension;
+                    size = inner_type.size;
+                    if (inner_type.isArray()) {
+                        size *= inner_type.dimension;
                     }
                 }
+                if (inner_type.ptr_count == 0) {
+                    is_signed = inner_type.is_signed;
+                }
+
+                switch (die.tag) {
+                    .const_type, .volatile_type, .atomic_type, .restrict_type => {
+                        // NOTE(radomski): int *const is still a pointer
+                        ptr_count = inner_type.ptr_count;
+                        qualifiers = inner_type.qualifiers;
+                    },
+                    .array_type => qualifiers = inner_type.qualifiers,
+                    else => {},
+                }
+            }
+
+            switch (die.tag) {
+                .const_type => qualifiers.is_const = true,
+                .volatile_type => qualifiers.is_volatile = true,
+                .atomic_type => qualifiers.is_atomic = true,
+                .restrict_type => qualifiers.is_restrict = true,
+                else => {},
             }
         }
 
         const id = try c.addType(Type{
-            .name = if (name) |n| n else default_name,
+            .name = if (name) |n| n else try c.names.intern(c.arena, default_name),
             .size = size,
             .ptr_count = ptr_count,
             .dimension = dimension,
+            .qualifiers = qualifiers,
+            .is_signed = is_signed,
         });
-        c.type_addresses[c.dwarf.toLocalAddr(global_type_address)] = id;
+        c.type_addresses[c.dwarf.toLocalAddr(frame.global_type_address)] = id;
+
+        if (frame.decl_file) |file| {
+            if (is_container and file < c.cu_file_dirs.len) {
+                try c.struct_decl_dirs.put(c.arena, id, c.cu_file_dirs[file]);
+            }
+        }
 
         return id;
     }
@@ -623,19 +1608,19 @@ const Context = struct {
     pub fn readTypedefAtAddress(c: *Context, global_typedef_address: usize, die_id: Dwarf.DieId) !void {
         const die = c.dwarf.dies.items[die_id];
 
-        var name: []const u8 = "";
+        var name: NameId = 0;
         var s: Structure = undefined;
         var container_type: Type.StructType = .none;
 
         for (c.dwarf.getAttrs(die.attr_range)) |attr, attr_idx| {
             switch (attr.at) {
                 Dwarf.DW_AT.name => {
-                    name = try c.dwarf.readString(attr.form, die.attr_range.start + attr_idx);
+                    name = try c.readName(attr.form, die.attr_range.start + attr_idx);
                 },
                 Dwarf.DW_AT.type => {
-                    const inner_type_address = c.dwarf.toGlobalAddr(@intCast(u32, try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx)));
+                    const inner_type_address = c.dwarf.toGlobalAddr(try c.dwarf.readFormData(attr.form, die.attr_range.start + attr_idx));
 
-                    c.dwarf.pushAddress();
+                    try c.dwarf.pushAddress();
                     defer c.dwarf.popAddress();
 
                     const inner_die_id = try c.dwarf.readDieIdAtAddress(inner_type_address) orelse unreachable;
@@ -648,9 +1633,9 @@ const Context = struct {
                     };
                     if (container_type != .none) {
                         const inner_type_id = try c.readTypeAtAddressAndSkip(inner_type_address);
-                        const inner_type = c.types.items[inner_type_id];
-                        if (inner_type.struct_id != InvalidStructId) {
-                            s = c.structures.items[inner_type.struct_id];
+                        const inner_struct_id = c.types.items(.struct_id)[inner_type_id];
+                        if (inner_struct_id != InvalidStructId) {
+                            s = c.structures.get(inner_struct_id);
                         } else {
                             s = try c.parseStructure(inner_type_address, inner_die_id, inner_die.tag);
                         }
@@ -663,137 +1648,201 @@ const Context = struct {
         }
 
         if (container_type != .none) {
+            const inner_type = c.types.get(s.type_id);
             const id = try c.addType(Type{
                 .name = name,
-                .size = c.types.items[s.type_id].size,
-                .ptr_count = c.types.items[s.type_id].ptr_count,
-                .dimension = c.types.items[s.type_id].dimension,
+                .size = inner_type.size,
+                .ptr_count = inner_type.ptr_count,
+                .dimension = inner_type.dimension,
                 .struct_type = container_type,
             });
             c.type_addresses[c.dwarf.toLocalAddr(global_typedef_address)] = id;
+            if (c.struct_decl_dirs.get(s.type_id)) |dir| {
+                try c.struct_decl_dirs.put(c.arena, id, dir);
+            }
             const container = Structure{
                 .type_id = id,
                 .member_range = s.member_range,
                 .inline_structures = s.inline_structures,
+                .non_pod = s.non_pod,
             };
 
             const struct_id = try c.addStruct(container);
-            c.types.items[id].struct_id = struct_id;
+            c.types.items(.struct_id)[id] = struct_id;
         }
     }
 
     pub fn printStructImpl(
         c: *Context,
         s: Structure,
-        stdout: anytype,
+        e: Emitter,
+        names: *const NameTable.Resolved,
         left_pad: usize,
         mem_offset: usize,
         member_name: []const u8,
         active_namespaces: []Namespace,
-    ) !void {
-        const members = c.members.items[s.member_range.start..s.member_range.end];
+        is_base: bool,
+    ) mem.Allocator.Error!void {
+        const members = c.members.slice();
+        const member_names = members.items(.name);
+        const member_type_ids = members.items(.type_id);
+        const member_kinds = members.items(.kind);
+        const mem_locs = members.items(.mem_loc);
+        const bit_locs = members.items(.bit_loc);
+        const bit_sizes = members.items(.bit_size);
+        const type_names = c.types.items(.name);
+        const shapes = c.types.items(.shape);
+        const struct_ids = c.types.items(.struct_id);
 
         var type_name_pad: usize = 0;
         var member_name_pad: usize = 0;
-        for (members) |member| {
-            const mtype = c.types.items[member.type_id];
-            const skip = s.inline_structures.contains(mtype.struct_id) or (mtype.name.len == 0 and mtype.struct_type != .none);
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const type_id = member_type_ids[member_id];
+            const shape = shapes[type_id];
+            const skip = member_kinds[member_id] != .field or s.inline_structures.contains(struct_ids[type_id]) or (type_names[type_id] == 0 and shape.struct_type != .none);
             if (skip) {
                 continue;
             }
 
-            type_name_pad = @maximum(type_name_pad, mtype.name.len + mtype.ptr_count);
-            if (mtype.isArray()) {
-                member_name_pad = @maximum(member_name_pad, member.name.len + fmt.count("[{d}]", .{mtype.dimension}));
-            } else if (member.bit_size != 0) {
-                member_name_pad = @maximum(member_name_pad, member.name.len + fmt.count(":{}", .{member.bit_size}));
+            const member_name_len = names.get(&c.names, member_names[member_id]).len;
+            type_name_pad = @maximum(type_name_pad, shape.qualifiers.text().len + names.get(&c.names, type_names[type_id]).len + shape.ptr_count);
+            if (shape.isArray()) {
+                member_name_pad = @maximum(member_name_pad, member_name_len + "[]".len + Emitter.digitCount(shape.dimension));
+            } else if (bit_sizes[member_id] != 0) {
+                member_name_pad = @maximum(member_name_pad, member_name_len + ":".len + Emitter.digitCount(bit_sizes[member_id]));
             } else {
-                member_name_pad = @maximum(member_name_pad, member.name.len);
+                member_name_pad = @maximum(member_name_pad, member_name_len);
             }
         }
 
-        const stype = c.types.items[s.type_id];
+        const stype = c.types.get(s.type_id);
         const container_prefix = switch (stype.struct_type) {
             .struct_type => "struct",
             .union_type => "union",
             .class_type => "class",
             else => unreachable,
         };
-        if (stype.name.len == 0) {
-            try stdout.print("{s: >[2]} {{ // size={}\n", .{ container_prefix, stype.size, left_pad + container_prefix.len });
-        } else {
-            try stdout.print("{s: >[1]} ", .{ container_prefix, left_pad + container_prefix.len });
-
+        try e.spaces(left_pad);
+        try e.bytes(container_prefix);
+        try e.bytes(" ");
+        if (stype.name != 0) {
             for (active_namespaces) |ns| {
                 if (ns.name.len > 0) {
-                    try stdout.print("{s}::", .{ns.name});
+                    try e.bytes(ns.name);
+                    try e.bytes("::");
                 }
             }
-
-            try stdout.print("{s} {{ // size={}\n", .{ stype.name, stype.size });
+            try e.bytes(names.get(&c.names, stype.name));
+            try e.bytes(" ");
         }
+        try e.bytes(if (is_base) "{ // base, size=" else "{ // size=");
+        try e.int(stype.size);
+        try e.bytes("\n");
+
         var current_offset: u32 = 0;
-        for (members) |member| {
-            if (stype.struct_type != .union_type and current_offset != member.mem_loc * 8 + member.bit_loc) {
-                try stdout.print("{s: >[2]}// HOLE => {d} bytes\n", .{
-                    "",
-                    ((member.mem_loc * 8 + member.bit_loc) - current_offset) / 8,
-                    left_pad + 2,
-                });
+        member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const type_id = member_type_ids[member_id];
+            const shape = shapes[type_id];
+            const kind = member_kinds[member_id];
+            if (kind == .virtual_base) {
+                try e.spaces(left_pad + 2);
+                try e.bytes("// VIRTUAL BASE => ");
+                try e.bytes(names.get(&c.names, type_names[type_id]));
+                try e.bytes(", size=");
+                try e.int(shape.size);
+                try e.bytes("\n");
+                continue;
+            }
+
+            // NOTE(radomski): Members before current_offset sit in the tail
+            // padding of a base
+            const member_loc = mem_locs[member_id];
+            const bit_loc = bit_locs[member_id];
+            const bit_size = bit_sizes[member_id];
+            const member_offset = member_loc * 8 + bit_loc;
+            if (stype.struct_type != .union_type and current_offset != member_offset) {
+                if (member_offset > current_offset) {
+                    try e.spaces(left_pad + 2);
+                    try e.bytes("// HOLE => ");
+                    try e.int((member_offset - current_offset) / 8);
+                    try e.bytes(" bytes\n");
+                }
 
-                current_offset = member.mem_loc * 8 + member.bit_loc;
+                current_offset = member_offset;
             }
 
-            const mtype = c.types.items[member.type_id];
-            if (s.inline_structures.contains(mtype.struct_id) or (mtype.name.len == 0 and mtype.struct_type != .none)) {
+            if (kind == .base) {
+                try c.printBase(s, member_id, e, names, left_pad + 2, mem_offset);
+                current_offset += shape.size * 8;
+                continue;
+            }
+
+            const struct_id = struct_ids[type_id];
+            if (s.inline_structures.contains(struct_id) or (type_names[type_id] == 0 and shape.struct_type != .none)) {
                 try c.printStructImpl(
-                    c.structures.items[mtype.struct_id],
-                    stdout,
+                    c.structures.get(struct_id),
+                    e,
+                    names,
                     left_pad + 2,
-                    member.mem_loc + mem_offset,
-                    member.name,
+                    member_loc + mem_offset,
+                    names.get(&c.names, member_names[member_id]),
                     &[_]Namespace{},
+                    false,
                 );
-                current_offset += mtype.size * 8;
+                current_offset += shape.size * 8;
                 continue;
             }
 
-            try stdout.print("{s: >[4]} {s:*<[5]}{s: <[6]}{s}", .{
-                mtype.name,
-                "",
-                "",
-                member.name,
-                left_pad + 2 + mtype.name.len,
-                mtype.ptr_count,
-                type_name_pad - mtype.name.len - mtype.ptr_count,
-            });
-            var written = member.name.len;
-            var size = mtype.size;
-            if (mtype.isArray()) {
-                try stdout.print("[{d}]", .{mtype.dimension});
-                size *= @intCast(u32, mtype.dimension);
-                written += fmt.count("[{d}]", .{mtype.dimension});
-            }
-            const mem_loc = mem_offset + member.mem_loc;
-            if (member.bit_size == 0) {
+            const type_name = names.get(&c.names, type_names[type_id]);
+            const name = names.get(&c.names, member_names[member_id]);
+            const qualifiers = shape.qualifiers.text();
+            try e.spaces(left_pad + 2);
+            if (shape.ptr_count == 0) {
+                try e.bytes(qualifiers);
+            }
+            try e.bytes(type_name);
+            try e.bytes(" ");
+            try e.byteNTimes('*', shape.ptr_count);
+            if (shape.ptr_count > 0) {
+                try e.bytes(qualifiers);
+            }
+            try e.spaces(type_name_pad - qualifiers.len - type_name.len - shape.ptr_count);
+            try e.bytes(name);
+            var written = name.len;
+            var size = shape.size;
+            if (shape.isArray()) {
+                try e.bytes("[");
+                try e.int(shape.dimension);
+                try e.bytes("]");
+                size *= @intCast(u32, shape.dimension);
+                written += "[]".len + Emitter.digitCount(shape.dimension);
+            }
+            const mem_loc = mem_offset + member_loc;
+            if (bit_size == 0) {
                 current_offset += size * 8;
-                try stdout.print(";{s: <[3]} // size={}, offset={}\n", .{
-                    "",
-                    size,
-                    mem_loc,
-                    member_name_pad - written,
-                });
+                try e.bytes(";");
+                try e.spaces(member_name_pad - written);
+                try e.bytes(" // size=");
+                try e.int(size);
+                try e.bytes(", offset=");
+                try e.int(mem_loc);
+                try e.bytes("\n");
             } else {
-                current_offset += member.bit_size;
-                written += fmt.count(":{d}", .{member.bit_size});
-                try stdout.print(":{};{s: <[5]} // size={}, offset={}:{}\n", .{
-                    member.bit_size,
-                    "",
-                    size,
-                    mem_loc,
-                    member.bit_loc,
-                    member_name_pad - written,
-                });
+                current_offset += bit_size;
+                written += ":".len + Emitter.digitCount(bit_size);
+                try e.bytes(":");
+                try e.int(bit_size);
+                try e.bytes(";");
+                try e.spaces(member_name_pad - written);
+                try e.bytes(" // size=");
+                try e.int(size);
+                try e.bytes(", offset=");
+                try e.int(mem_loc);
+                try e.bytes(":");
+                try e.int(bit_loc);
+                try e.bytes("\n");
             }
         }
 
@@ -803,96 +1852,604 @@ const Context = struct {
             const padding_bits = @truncate(u3, whole_padding_bits);
             const padding_bytes = whole_padding_bits / 8;
 
-            if (padding_bits != 0 and padding_bytes != 0) {
-                try stdout.print("{s: >[3]}// HOLE => {d} bytes and {d} bits\n", .{ "", padding_bytes, padding_bits, left_pad + 2 });
-            } else if (padding_bits != 0 and padding_bytes == 0) {
-                try stdout.print("{s: >[2]}// HOLE => {d} bits\n", .{ "", padding_bits, left_pad + 2 });
-            } else if (padding_bits == 0 and padding_bytes != 0) {
-                try stdout.print("{s: >[2]}// HOLE => {d} bytes\n", .{ "", padding_bytes, left_pad + 2 });
+            if (padding_bits != 0 or padding_bytes != 0) {
+                try e.spaces(left_pad + 2);
+                try e.bytes("// HOLE => ");
+                if (padding_bytes != 0) {
+                    try e.int(padding_bytes);
+                    try e.bytes(" bytes");
+                }
+                if (padding_bits != 0 and padding_bytes != 0) {
+                    try e.bytes(" and ");
+                }
+                if (padding_bits != 0) {
+                    try e.int(padding_bits);
+                    try e.bytes(" bits");
+                }
+                try e.bytes("\n");
             }
         }
 
+        try e.spaces(left_pad);
         if (member_name.len > 0) {
-            try stdout.print("{s: <[2]}}} {s};\n", .{ "", member_name, left_pad });
+            try e.bytes("} ");
+            try e.bytes(member_name);
+            try e.bytes(";\n");
         } else {
-            try stdout.print("{s: <[1]}}};\n", .{ "", left_pad });
+            try e.bytes("};\n");
         }
     }
 
     pub fn printStruct(
         c: *Context,
         s: Structure,
-        stdout: anytype,
+        out: *std.ArrayList(u8),
         active_namespaces: []Namespace,
     ) !void {
-        try c.printStructImpl(s, stdout, 0, 0, "", active_namespaces);
+        try c.printStructResolved(s, out, active_namespaces, &NameTable.Resolved{});
+    }
+
+    // Takes the names resolved for the chunk s is in, see warmNames
+    pub fn printStructResolved(
+        c: *Context,
+        s: Structure,
+        out: *std.ArrayList(u8),
+        active_namespaces: []Namespace,
+        names: *const NameTable.Resolved,
+    ) !void {
+        try c.printStructImpl(s, Emitter.init(out), names, 0, 0, "", active_namespaces, false);
+    }
+
+    // Base class subobject inline at its offset, then whether the members
+    // after it can go in its tail padding. Following the Itanium C++ ABI
+    // that's never the case for a POD base.
+    fn printBase(c: *Context, s: Structure, member_id: MemberId, e: Emitter, names: *const NameTable.Resolved, left_pad: usize, mem_offset: usize) mem.Allocator.Error!void {
+        const member = c.members.get(member_id);
+        const btype = c.types.get(member.type_id);
+        if (btype.struct_id == InvalidStructId) {
+            try e.spaces(left_pad);
+            try e.bytes("// BASE => ");
+            try e.bytes(names.get(&c.names, btype.name));
+            try e.bytes(", size=");
+            try e.int(btype.size);
+            try e.bytes(", offset=");
+            try e.int(mem_offset + member.mem_loc);
+            try e.bytes("\n");
+            return;
+        }
+
+        const base = c.structures.get(btype.struct_id);
+        try c.printStructImpl(base, e, names, left_pad, mem_offset + member.mem_loc, "", &[_]Namespace{}, true);
+
+        // Empty bases always overlap what comes after them
+        const tail_bytes = btype.size -| @intCast(u32, (c.dataEnd(base) + 7) / 8);
+        if (base.member_range.len() == 0 or tail_bytes == 0) {
+            return;
+        }
+
+        const base_end = (@as(u64, member.mem_loc) + btype.size) * 8;
+        var reused = false;
+        var next_id = member_id + 1;
+        while (next_id < s.member_range.end) : (next_id += 1) {
+            const next = c.members.get(next_id);
+            if (next.kind != .virtual_base) {
+                reused = @as(u64, next.mem_loc) * 8 + next.bit_loc < base_end;
+                break;
+            }
+        }
+
+        try e.spaces(left_pad);
+        try e.bytes("// TAIL PADDING => ");
+        try e.int(tail_bytes);
+        try e.bytes(" bytes of ");
+        try e.bytes(names.get(&c.names, btype.name));
+        if (base.non_pod) {
+            try e.bytes(if (reused) ", reused\n" else ", reusable\n");
+        } else {
+            try e.bytes(", not reusable, POD base\n");
+        }
+    }
+
+    // Bits up to the end of the last member, the tail padding starts there.
+    // Bases count up to their own data end, like in the Itanium C++ ABI dsize.
+    pub fn dataEnd(c: *Context, s: Structure) u64 {
+        const members = c.members.slice();
+        const member_type_ids = members.items(.type_id);
+        const member_kinds = members.items(.kind);
+        const mem_locs = members.items(.mem_loc);
+        const bit_locs = members.items(.bit_loc);
+        const bit_sizes = members.items(.bit_size);
+        const shapes = c.types.items(.shape);
+        const struct_ids = c.types.items(.struct_id);
+
+        var end: u64 = 0;
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const kind = member_kinds[member_id];
+            if (kind == .virtual_base) {
+                continue;
+            }
+            const type_id = member_type_ids[member_id];
+            const shape = shapes[type_id];
+            const offset = @as(u64, mem_locs[member_id]) * 8 + bit_locs[member_id];
+            var bits: u64 = undefined;
+            if (kind == .base and struct_ids[type_id] != InvalidStructId) {
+                bits = c.dataEnd(c.structures.get(struct_ids[type_id]));
+            } else if (bit_sizes[member_id] != 0) {
+                bits = bit_sizes[member_id];
+            } else {
+                bits = @as(u64, shape.size) * 8;
+                if (shape.isArray()) {
+                    bits *= shape.dimension;
+                }
+            }
+            end = @maximum(end, offset + bits);
+        }
+        return end;
+    }
+
+    pub const Hole = struct {
+        offset_bits: u64,
+        size_bits: u64,
+    };
+
+    // NOTE(radomski): Walks the members the same way printStructImpl does, so
+    // the holes match what gets printed.
+    pub fn collectHoles(c: *Context, s: Structure, mem_offset: u64, holes: *std.ArrayList(Hole)) mem.Allocator.Error!void {
+        const members = c.members.slice();
+        const member_type_ids = members.items(.type_id);
+        const member_kinds = members.items(.kind);
+        const mem_locs = members.items(.mem_loc);
+        const bit_locs = members.items(.bit_loc);
+        const bit_sizes = members.items(.bit_size);
+        const type_names = c.types.items(.name);
+        const shapes = c.types.items(.shape);
+        const struct_ids = c.types.items(.struct_id);
+
+        const stype = c.types.get(s.type_id);
+        var current_offset: u64 = 0;
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const kind = member_kinds[member_id];
+            if (kind == .virtual_base) {
+                continue;
+            }
+            const member_offset = @as(u64, mem_locs[member_id]) * 8 + bit_locs[member_id];
+            if (stype.struct_type != .union_type and current_offset != member_offset) {
+                if (member_offset > current_offset) {
+                    try holes.append(.{ .offset_bits = mem_offset * 8 + current_offset, .size_bits = member_offset - current_offset });
+                } else {
+                    // In the tail padding of a base, it's no hole anymore
+                    trimHoles(holes, mem_offset * 8 + member_offset);
+                }
+                current_offset = member_offset;
+            }
+
+            const type_id = member_type_ids[member_id];
+            const shape = shapes[type_id];
+            const struct_id = struct_ids[type_id];
+            const is_base = kind == .base and struct_id != InvalidStructId;
+            if (is_base or s.inline_structures.contains(struct_id) or (type_names[type_id] == 0 and shape.struct_type != .none)) {
+                try c.collectHoles(c.structures.get(struct_id), mem_offset + mem_locs[member_id], holes);
+                current_offset += @as(u64, shape.size) * 8;
+                continue;
+            }
+
+            if (bit_sizes[member_id] == 0) {
+                var size: u64 = shape.size;
+                if (shape.isArray()) {
+                    size *= shape.dimension;
+                }
+                current_offset += size * 8;
+            } else {
+                current_offset += bit_sizes[member_id];
+            }
+        }
+
+        const size_bits = @as(u64, stype.size) * 8;
+        if (stype.struct_type != .union_type and current_offset < size_bits) {
+            try holes.append(.{ .offset_bits = mem_offset * 8 + current_offset, .size_bits = size_bits - current_offset });
+        }
+    }
+
+    fn trimHoles(holes: *std.ArrayList(Hole), offset_bits: u64) void {
+        while (holes.items.len > 0) {
+            const last = &holes.items[holes.items.len - 1];
+            if (last.offset_bits >= offset_bits) {
+                _ = holes.pop();
+            } else {
+                last.size_bits = @minimum(last.size_bits, offset_bits - last.offset_bits);
+                return;
+            }
+        }
+    }
+
+    pub fn writeMembersAtOffset(
+        c: *Context,
+        s: Structure,
+        stdout: anytype,
+        mem_offset: usize,
+        offset: usize,
+        path: *std.ArrayList(u8),
+    ) !usize {
+        const members = c.members.slice();
+        const member_names = members.items(.name);
+        const member_type_ids = members.items(.type_id);
+        const member_kinds = members.items(.kind);
+        const mem_locs = members.items(.mem_loc);
+        const bit_locs = members.items(.bit_loc);
+        const bit_sizes = members.items(.bit_size);
+        const type_names = c.types.items(.name);
+        const shapes = c.types.items(.shape);
+        const struct_ids = c.types.items(.struct_id);
+
+        const stype = c.types.get(s.type_id);
+        var found: usize = 0;
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const type_id = member_type_ids[member_id];
+            const shape = shapes[type_id];
+            var size: usize = shape.size;
+            if (shape.isArray()) {
+                size *= shape.dimension;
+            }
+            const kind = member_kinds[member_id];
+            const mem_loc = mem_offset + mem_locs[member_id];
+            if (kind == .virtual_base or offset < mem_loc or offset >= mem_loc + @maximum(size, 1)) {
+                continue;
+            }
+            const struct_id = struct_ids[type_id];
+            if (kind == .base and struct_id != InvalidStructId) {
+                found += try c.writeMembersAtOffset(c.structures.get(struct_id), stdout, mem_loc, offset, path);
+                continue;
+            }
+
+            const path_len = path.items.len;
+            defer path.shrinkRetainingCapacity(path_len);
+            try path.appendSlice(c.getName(member_names[member_id]));
+
+            const bit_size = bit_sizes[member_id];
+            if (s.inline_structures.contains(struct_id) or (type_names[type_id] == 0 and shape.struct_type != .none)) {
+                try path.append('.');
+                found += try c.writeMembersAtOffset(c.structures.get(struct_id), stdout, mem_loc, offset, path);
+            } else if (bit_size == 0) {
+                try stdout.print("{s} // size={}, offset={}\n", .{ path.items, size, mem_loc });
+                found += 1;
+            } else {
+                try stdout.print("{s}:{} // size={}, offset={}:{}\n", .{ path.items, bit_size, size, mem_loc, bit_locs[member_id] });
+                found += 1;
+            }
+        }
+
+        if (found == 0 and path.items.len == 0 and offset < stype.size) {
+            try stdout.print("// HOLE at offset={}\n", .{offset});
+            found += 1;
+        }
+
+        return found;
+    }
+
+    pub fn printContainersSerial(c: *Context) !void {
+        const stdout_file = std.io.getStdOut();
+        var out = try std.ArrayList(u8).initCapacity(c.gpa, output_buffer_size);
+        defer out.deinit();
+
+        // Same warming as the parallel path, a chunk at a time
+        var start: usize = 0;
+        while (start < c.structures.len) : (start += min_structures_per_chunk) {
+            const end = @minimum(c.structures.len, start + min_structures_per_chunk);
+            var scratch_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+            defer scratch_instance.deinit();
+            const scratch = scratch_instance.allocator();
+            const names = try c.warmNames(start, end, scratch);
+
+            var it = try c.containerIteratorRange(.all, start, end, scratch);
+            defer it.deinit();
+            while (try it.next()) |s| {
+                try c.printStructResolved(s, &out, it.activeNamespaces(), &names);
+                if (out.items.len >= output_buffer_size) {
+                    try stdout_file.writeAll(out.items);
+                    out.clearRetainingCapacity();
+                }
+            }
+        }
+
+        try stdout_file.writeAll(out.items);
+    }
+
+    const output_buffer_size = 1 * MegaByte;
+
+    const min_structures_per_chunk = 256;
+
+    const PrintChunk = struct {
+        start: usize,
+        end: usize,
+        text: std.ArrayList(u8),
+        err: ?anyerror = null,
+        done: std.Thread.ResetEvent = .{},
+    };
+
+    const ParallelPrint = struct {
+        c: *Context,
+        chunks: []PrintChunk,
+        stdout_file: std.fs.File,
+        next_chunk: usize = 0,
+        write_err: ?anyerror = null,
+    };
+
+    fn collectNameReferences(c: *Context, s: Structure, ids: *std.ArrayList(NameId)) mem.Allocator.Error!void {
+        const stype = c.types.get(s.type_id);
+        if (NameTable.isReference(stype.name)) {
+            try ids.append(stype.name);
+        }
+
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            const member = c.members.get(member_id);
+            const mtype = c.types.get(member.type_id);
+            if (NameTable.isReference(member.name)) {
+                try ids.append(member.name);
+            }
+            if (s.inline_structures.contains(mtype.struct_id) or (mtype.name == 0 and mtype.struct_type != .none)) {
+                try c.collectNameReferences(c.structures.get(mtype.struct_id), ids);
+            } else if (NameTable.isReference(mtype.name)) {
+                try ids.append(mtype.name);
+            }
+        }
+    }
+
+    // NOTE(radomski): Names are read in .debug_str order for the whole chunk
+    // up front, printing then takes them from the result. Lives in scratch.
+    fn warmNames(c: *Context, start: usize, end: usize, scratch: mem.Allocator) !NameTable.Resolved {
+        var ids = std.ArrayList(NameId).init(scratch);
+
+        var it = try c.containerIteratorRange(.all, start, end, scratch);
+        defer it.deinit();
+        while (try it.next()) |s| {
+            try c.collectNameReferences(s, &ids);
+        }
+
+        std.sort.sort(NameId, ids.items, {}, comptime std.sort.asc(NameId));
+        return c.names.resolve(scratch, ids.items);
+    }
+
+    fn formatChunk(c: *Context, chunk: *PrintChunk, scratch: mem.Allocator) !void {
+        const names = try c.warmNames(chunk.start, chunk.end, scratch);
+
+        var it = try c.containerIteratorRange(.all, chunk.start, chunk.end, scratch);
+        defer it.deinit();
+
+        while (try it.next()) |s| {
+            try c.printStructResolved(s, &chunk.text, it.activeNamespaces(), &names);
+        }
+    }
+
+    fn formatChunks(p: *ParallelPrint) void {
+        while (true) {
+            const i = @atomicRmw(usize, &p.next_chunk, .Add, 1, .Monotonic);
+            if (i >= p.chunks.len) {
+                break;
+            }
+
+            // NOTE(radomski): Scratch memory of the worker, gone with the
+            // chunk. The arena isn't shared, so it needs no locking.
+            var scratch_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+            defer scratch_instance.deinit();
+
+            const chunk = &p.chunks[i];
+            p.c.formatChunk(chunk, scratch_instance.allocator()) catch |err| {
+                chunk.err = err;
+            };
+            chunk.done.set();
+        }
+    }
+
+    // NOTE(radomski): Chunks are handed out in order, so waiting on them in
+    // order never waits on a chunk nobody picked up. Nothing is written past
+    // a chunk that failed, the output would have a hole in the middle.
+    fn writeChunks(p: *ParallelPrint) void {
+        var failed = false;
+        for (p.chunks) |*chunk| {
+            chunk.done.wait();
+            failed = failed or chunk.err != null;
+            if (p.write_err == null and !failed) {
+                p.stdout_file.writeAll(chunk.text.items) catch |err| {
+                    p.write_err = err;
+                };
+            }
+            chunk.text.deinit();
+        }
     }
 
+    // Formats chunks of structures on every core while a writer thread emits
+    // the finished chunks in structures order, the output is the same as
+    // printContainersSerial.
     pub fn printContainers(c: *Context) !void {
-        const stdout_file = std.io.getStdOut().writer();
-        var bw = std.io.BufferedWriter(16 * KiloByte, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
-        const stdout = bw.writer();
-
-        var active_namespaces_stack = try std.ArrayListUnmanaged(Namespace).initCapacity(c.arena, 64);
-        var next_namespace_index: usize = 0;
-
-        for (c.structures.items) |s, sid| {
-            while (true) {
-                const last_opt = active_namespaces_stack.popOrNull();
-                if (last_opt) |last| {
-                    if (last.struct_range.contains(@intCast(u32, sid))) {
-                        active_namespaces_stack.appendAssumeCapacity(last);
+        const structure_count = c.structures.len;
+        const thread_count = c.print_threads orelse (std.Thread.getCpuCount() catch 1);
+        // NOTE(radomski): Several chunks per thread so a chunk full of huge
+        // structures doesn't leave the other threads idle.
+        const chunk_size = @maximum(min_structures_per_chunk, structure_count / (thread_count * 8) + 1);
+        const chunk_count = (structure_count + chunk_size - 1) / chunk_size;
+        if (thread_count <= 1 or chunk_count <= 1) {
+            return c.printContainersSerial();
+        }
+
+        // NOTE(radomski): Texts are filled by the workers and freed by the
+        // writer thread, so their allocator has to be thread safe
+        var text_gpa_instance = std.heap.GeneralPurposeAllocator(.{ .thread_safe = true }){};
+        defer _ = text_gpa_instance.deinit();
+        const text_gpa = text_gpa_instance.allocator();
+
+        var chunks = try c.gpa.alloc(PrintChunk, chunk_count);
+        defer c.gpa.free(chunks);
+        for (chunks) |*chunk, i| {
+            chunk.* = .{
+                .start = i * chunk_size,
+                .end = @minimum(structure_count, (i + 1) * chunk_size),
+                .text = std.ArrayList(u8).init(text_gpa),
+            };
+        }
+
+        var p = ParallelPrint{ .c = c, .chunks = chunks, .stdout_file = std.io.getStdOut() };
+        const writer_thread = std.Thread.spawn(.{}, writeChunks, .{&p}) catch {
+            return c.printContainersSerial();
+        };
+
+        var workers = try std.ArrayList(std.Thread).initCapacity(c.gpa, thread_count - 1);
+        defer workers.deinit();
+        while (workers.items.len < thread_count - 1) {
+            const thread = std.Thread.spawn(.{}, formatChunks, .{&p}) catch break;
+            workers.appendAssumeCapacity(thread);
+        }
+        formatChunks(&p);
+        for (workers.items) |thread| {
+            thread.join();
+        }
+        writer_thread.join();
+
+        // The first failed chunk is where the output stopped
+        for (chunks) |chunk| {
+            if (chunk.err) |err| {
+                return err;
+            }
+        }
+        if (p.write_err) |err| {
+            return err;
+        }
+    }
+
+    pub const ContainerIterator = struct {
+        c: *Context,
+        filter: ContainerFilter,
+        allocator: mem.Allocator,
+        sid: usize = 0,
+        end_sid: usize,
+        next_namespace_index: usize = 0,
+        active_namespaces_stack: std.ArrayListUnmanaged(Namespace),
+
+        pub fn next(it: *ContainerIterator) !?Structure {
+            const c = it.c;
+            while (it.sid < it.end_sid) {
+                const sid = it.sid;
+                it.sid += 1;
+
+                while (true) {
+                    const last_opt = it.active_namespaces_stack.popOrNull();
+                    if (last_opt) |last| {
+                        if (last.struct_range.contains(@intCast(u32, sid))) {
+                            try it.active_namespaces_stack.append(it.allocator, last);
+                            break;
+                        }
+                    } else {
                         break;
                     }
-                } else {
-                    break;
                 }
-            }
 
-            while (true) {
-                if (next_namespace_index >= c.namespaces.items.len) {
-                    break;
+                while (true) {
+                    if (it.next_namespace_index >= c.namespaces.items.len) {
+                        break;
+                    }
+                    const ns = c.namespaces.items[it.next_namespace_index];
+                    if (ns.struct_range.contains(@intCast(u32, sid))) {
+                        try it.active_namespaces_stack.append(it.allocator, ns);
+                        it.next_namespace_index += 1;
+                    } else {
+                        break;
+                    }
                 }
-                const ns = c.namespaces.items[next_namespace_index];
-                if (ns.struct_range.contains(@intCast(u32, sid))) {
-                    active_namespaces_stack.appendAssumeCapacity(ns);
-                    next_namespace_index += 1;
-                } else {
-                    break;
+
+                const s = c.structures.get(sid);
+                const stype = c.types.get(s.type_id);
+                if (stype.size > 0 and stype.name != 0 and it.filter.matches(c.getName(stype.name), it.active_namespaces_stack.items)) {
+                    return s;
                 }
             }
 
-            const stype = c.types.items[s.type_id];
-            if (stype.size > 0 and stype.name.len > 0) {
-                try c.printStruct(s, stdout, active_namespaces_stack.items);
+            return null;
+        }
+
+        pub fn activeNamespaces(it: *ContainerIterator) []Namespace {
+            return it.active_namespaces_stack.items;
+        }
+
+        pub fn deinit(it: *ContainerIterator) void {
+            it.active_namespaces_stack.deinit(it.allocator);
+        }
+    };
+
+    pub fn containerIterator(c: *Context, filter: ContainerFilter) !ContainerIterator {
+        return c.containerIteratorRange(filter, 0, c.structures.len, c.arena);
+    }
+
+    // Iterates structures in [start, end). Namespaces open at start are put on
+    // the stack up front, so the result is the same as iterating from 0.
+    pub fn containerIteratorRange(
+        c: *Context,
+        filter: ContainerFilter,
+        start: usize,
+        end: usize,
+        allocator: mem.Allocator,
+    ) !ContainerIterator {
+        var it = ContainerIterator{
+            .c = c,
+            .filter = filter,
+            .allocator = allocator,
+            .sid = start,
+            .end_sid = end,
+            .active_namespaces_stack = try std.ArrayListUnmanaged(Namespace).initCapacity(allocator, 16),
+        };
+        errdefer it.deinit();
+
+        while (it.next_namespace_index < c.namespaces.items.len) : (it.next_namespace_index += 1) {
+            const ns = c.namespaces.items[it.next_namespace_index];
+            if (ns.struct_range.start > start) {
+                break;
+            }
+            if (ns.struct_range.contains(@intCast(u32, start))) {
+                try it.active_namespaces_stack.append(allocator, ns);
             }
         }
 
-        try bw.flush();
+        return it;
     }
-};
 
-pub fn main() !void {
-    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
-    defer arena_instance.deinit();
-    const arena = arena_instance.allocator();
+    // NOTE(radomski): The namespace stack comes from allocator and not from
+    // c.arena. A cached Context answers many requests and its arena would
+    // otherwise grow with every one of them.
+    pub fn writeContainers(c: *Context, out: *std.ArrayList(u8), filter: ContainerFilter, allocator: mem.Allocator) !usize {
+        var it = try c.containerIteratorRange(filter, 0, c.structures.len, allocator);
+        defer it.deinit();
+
+        var written: usize = 0;
+        while (try it.next()) |s| {
+            try c.printStruct(s, out, it.activeNamespaces());
+            written += 1;
+        }
 
-    if (std.os.argv.len != 2) {
-        std.log.warn("usage: {s} <exec path>", .{std.os.argv[0]});
-        return;
+        return written;
     }
 
-    const exec_path = mem.span(std.os.argv[1]);
-    const file = try std.fs.cwd().openFile(exec_path, .{});
-    defer file.close();
-    const file_size = try file.getEndPos();
-    var exec_bin = try arena.alloc(u8, file_size);
-    const read = try file.readAll(exec_bin);
-    std.debug.assert(read == file_size);
+    pub fn findStructure(c: *Context, filter: ContainerFilter, allocator: mem.Allocator) !?Structure {
+        var it = try c.containerIteratorRange(filter, 0, c.structures.len, allocator);
+        defer it.deinit();
+        return it.next();
+    }
+};
+
+// Types from the .BTF section when there is one, or from raw BTF, since it
+// loads in a fraction of the time. DWARF otherwise.
+pub fn contextFromElf(exec_bin: []u8, arena: mem.Allocator) !Context {
+    if (btf.find(exec_bin)) |source| {
+        return btf.contextFromBtf(source, arena);
+    }
+    return contextFromDwarf(exec_bin, null, arena);
+}
+
+// Parsing phases report to perf when it's given
+pub fn contextFromDwarf(exec_bin: []u8, perf_opt: ?*Perf, arena: mem.Allocator) !Context {
     var buffer = Buffer{ .data = exec_bin, .curr_pos = 0 };
     var sections = try elf.getSectionsDebugSections(&buffer, arena);
-
-    var timer = try std.time.Timer.start();
     var dwarf = try Dwarf.init(
         sections.binary_bitness,
         &sections.debug_abbrev,
@@ -901,8 +2458,246 @@ pub fn main() !void {
         sections.debug_str_offsets,
         arena,
     );
-    const ns = timer.read();
-    std.debug.print("Dwarf init: {}\n", .{std.fmt.fmtDuration(ns)});
-    var context = try Context.init(arena, dwarf);
+    dwarf.debug_line = sections.debug_line;
+    dwarf.debug_line_str = sections.debug_line_str;
+    dwarf.debug_addr = sections.debug_addr;
+    var c = try Context.init(arena, dwarf);
+    c.perf = perf_opt;
+    return c;
+}
+
+// BTF when the binary has it, DWARF otherwise, timing how long it takes.
+fn loadContext(exec_bin: []u8, perf_opt: ?*Perf, arena: mem.Allocator) !Context {
+    const start_sample = if (perf_opt) |perf| perf.read() else Perf.Sample{};
+    var timer = try std.time.Timer.start();
+    const context = if (btf.find(exec_bin)) |source| blk: {
+        var loaded = try btf.contextFromBtf(source, arena);
+        loaded.perf = perf_opt;
+        std.debug.print("BTF load: {}\n", .{std.fmt.fmtDuration(timer.read())});
+        break :blk loaded;
+    } else blk: {
+        const loaded = try contextFromDwarf(exec_bin, perf_opt, arena);
+        std.debug.print("Dwarf init: {}\n", .{std.fmt.fmtDuration(timer.read())});
+        break :blk loaded;
+    };
+
+    if (perf_opt) |perf| {
+        perf.print("  counters", perf.read().sub(start_sample));
+    }
+    return context;
+}
+
+// `dis -`, only the ranges the parser needs are kept in memory.
+fn readStdin() ![]u8 {
+    var stats = stream.Stats{};
+    var timer = try std.time.Timer.start();
+    const data = try stream.readElf(std.io.getStdIn().reader(), &stats);
+    std.debug.print("Stream: read {} in {}, kept {}\n", .{
+        std.fmt.fmtIntSizeBin(stats.streamed),
+        std.fmt.fmtDuration(timer.read()),
+        std.fmt.fmtIntSizeBin(stats.kept),
+    });
+    return data;
+}
+
+pub fn main() !void {
+    var arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_instance.deinit();
+    const arena = arena_instance.allocator();
+
+    const args = try std.process.argsAlloc(arena);
+    if (args.len >= 2 and mem.eql(u8, args[1], "serve")) {
+        return serve.run(args[2..]);
+    }
+    if (args.len >= 2 and mem.eql(u8, args[1], "watch")) {
+        return watch.run(args[2..]);
+    }
+
+    if (args.len >= 2 and mem.eql(u8, args[1], "merge")) {
+        return shard.merge(args[2..], arena);
+    }
+
+    var paths = std.ArrayList([]const u8).init(arena);
+    var with_deps = false;
+    var perf_counters = false;
+    var print_threads: ?usize = null;
+    var shard_spec: ?shard.Spec = null;
+    var shard_out: ?[]const u8 = null;
+    var emit_btf_path: ?[]const u8 = null;
+    var sample_percent: ?f64 = null;
+    var sample_seed: ?u64 = null;
+    var summary_only = false;
+    var summary_top: usize = 10;
+    var profile_path: ?[]const u8 = null;
+    var line_size: u64 = profile.default_line_size;
+    var false_sharing = false;
+    var globals_only = false;
+    var lock_types = std.ArrayList([]const u8).init(arena);
+    var atomic_types = std.ArrayList([]const u8).init(arena);
+    var arg_index: usize = 1;
+    while (arg_index < args.len) : (arg_index += 1) {
+        const arg = args[arg_index];
+        if (mem.eql(u8, arg, "--with-deps")) {
+            with_deps = true;
+        } else if (mem.eql(u8, arg, "--perf-counters")) {
+            perf_counters = true;
+        } else if (mem.eql(u8, arg, "--print-threads") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            print_threads = @maximum(try fmt.parseInt(usize, args[arg_index], 10), 1);
+        } else if (mem.eql(u8, arg, "--shard") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            shard_spec = try shard.parseSpec(args[arg_index]);
+        } else if (mem.eql(u8, arg, "--out") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            shard_out = args[arg_index];
+        } else if (mem.eql(u8, arg, "--emit-btf") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            emit_btf_path = args[arg_index];
+        } else if (mem.startsWith(u8, arg, "--sample=")) {
+            sample_percent = try sample.parsePercent(arg["--sample=".len..]);
+        } else if (mem.eql(u8, arg, "--seed") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            sample_seed = try fmt.parseInt(u64, args[arg_index], 10);
+        } else if (mem.eql(u8, arg, "--summary")) {
+            summary_only = true;
+        } else if (mem.eql(u8, arg, "--top") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            summary_top = try fmt.parseInt(usize, args[arg_index], 10);
+        } else if (mem.eql(u8, arg, "--profile") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            profile_path = args[arg_index];
+        } else if (mem.eql(u8, arg, "--line-size") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            line_size = try fmt.parseInt(u64, args[arg_index], 10);
+        } else if (mem.eql(u8, arg, "--globals")) {
+            globals_only = true;
+        } else if (mem.eql(u8, arg, "--false-sharing")) {
+            false_sharing = true;
+        } else if (mem.eql(u8, arg, "--lock-type") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            try lock_types.append(args[arg_index]);
+        } else if (mem.eql(u8, arg, "--atomic-type") and arg_index + 1 < args.len) {
+            arg_index += 1;
+            try atomic_types.append(args[arg_index]);
+        } else {
+            try paths.append(arg);
+        }
+    }
+
+    if (paths.items.len > 1 and !with_deps) {
+        return batch.runFiles(paths.items, arena);
+    }
+    if (paths.items.len != 1) {
+        std.log.warn("usage: {s} <exec path> [--with-deps] [--perf-counters] [--print-threads <N>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --emit-btf <out path>", .{args[0]});
+        std.log.warn("       {s} <exec path> --sample=<P>% [--seed <n>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --summary [--top <N>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --globals [--top <N>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --profile <path> [--line-size <bytes>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --false-sharing [--lock-type <name>]... [--atomic-type <name>]... [--profile <path>] [--line-size <bytes>]", .{args[0]});
+        std.log.warn("       {s} <exec path> --shard <i>/<n> [--out <path>]", .{args[0]});
+        std.log.warn("       {s} - < <exec path>    (buffers up to the section headers, in most binaries the whole file)", .{args[0]});
+        std.log.warn("       {s} merge <shard path>...", .{args[0]});
+        std.log.warn("       {s} <object path> <object path>...", .{args[0]});
+        std.log.warn("       {s} serve --socket <path> [--cache-size <MiB>]", .{args[0]});
+        std.log.warn("       {s} watch <dir> [--top <N>]", .{args[0]});
+        return;
+    }
+
+    const exec_path = paths.items[0];
+    // NOTE(radomski): Both go back to the file, deps for $ORIGIN and the
+    // libraries next to it, shards to map it
+    if (mem.eql(u8, exec_path, "-") and (with_deps or shard_spec != null)) {
+        std.log.err("--with-deps and --shard need a path, they can't read from -", .{});
+        return error.InvalidArgument;
+    }
+    const exec_bin = if (mem.eql(u8, exec_path, "-")) try readStdin() else blk: {
+        const file = try std.fs.cwd().openFile(exec_path, .{});
+        defer file.close();
+
+        var magic: [archive.archive_magic.len]u8 = undefined;
+        if (try file.preadAll(&magic, 0) == magic.len and archive.isArchive(&magic)) {
+            return archive.run(file, exec_path, arena);
+        }
+        if (with_deps) {
+            return deps.run(file, exec_path, arena);
+        }
+        if (shard_spec) |spec| {
+            return shard.run(file, exec_path, spec, shard_out, arena);
+        }
+
+        const file_size = try file.getEndPos();
+        var data = try arena.alloc(u8, file_size);
+        const read = try file.readAll(data);
+        std.debug.assert(read == file_size);
+        break :blk data;
+    };
+
+    var perf_opt: ?Perf = null;
+    if (perf_counters) {
+        perf_opt = Perf.open();
+        if (perf_opt) |perf| {
+            std.debug.print("Perf counters: {s}\n", .{perf.kind()});
+        } else {
+            std.log.warn("perf_event_open failed, running without counters", .{});
+        }
+    }
+    defer {
+        if (perf_opt) |*perf| {
+            perf.deinit();
+        }
+    }
+
+    var context = try loadContext(exec_bin, if (perf_opt) |*perf| perf else null, arena);
+    if (sample_percent) |percent| {
+        const seed = sample_seed orelse @truncate(u64, @bitCast(u128, time.nanoTimestamp()));
+        return sample.run(&context, percent, seed, arena);
+    }
+    if (summary_only) {
+        context.decl_dirs = true;
+        var timer = try std.time.Timer.start();
+        try context.parse();
+        context.sortNamespaces();
+        std.debug.print("Parsing: {}\n", .{fmt.fmtDuration(timer.read())});
+        return summary.run(&context, summary_top, arena);
+    }
+    if (globals_only) {
+        context.read_variables = true;
+        try context.parse();
+        // NOTE(radomski): Raw BTF has neither sections nor variables
+        const sections: []const elf.AllocatedSection = elf.allocatedSections(exec_bin, arena) catch |err| switch (err) {
+            error.NotElf => &[_]elf.AllocatedSection{},
+            else => return err,
+        };
+        return globals.run(&context, sections, summary_top, arena);
+    }
+    if (false_sharing) {
+        try context.parse();
+        context.sortNamespaces();
+        return sharing.run(&context, .{
+            .line_size = @maximum(line_size, 1),
+            .lock_types = lock_types.items,
+            .atomic_types = atomic_types.items,
+            .profile_path = profile_path,
+        }, arena);
+    }
+    if (profile_path) |path| {
+        try context.parse();
+        context.sortNamespaces();
+        return profile.run(&context, path, @maximum(line_size, 1), arena);
+    }
+    if (emit_btf_path) |path| {
+        try context.parse();
+        context.sortNamespaces();
+        const stats = try btf.emitFile(&context, path, arena);
+        std.debug.print("BTF: {} types, {} of strings, {} written to {s}\n", .{
+            stats.types,
+            fmt.fmtIntSizeBin(stats.strings_size),
+            fmt.fmtIntSizeBin(stats.size),
+            path,
+        });
+        return;
+    }
+    context.print_threads = print_threads;
     try context.run();
 }
@@ -0,0 +1,261 @@
+const std = @import("std");
+const linux = std.os.linux;
+
+// Hardware performance counters through perf_event_open, for --perf-counters.
+// The counters run from open until deinit, phases take a sample before and
+// after and report the difference. When the hardware events can't be opened,
+// in a VM or with a strict perf_event_paranoid, software events are used.
+
+const PERF_TYPE_HARDWARE = 0;
+const PERF_TYPE_SOFTWARE = 1;
+
+const PERF_COUNT_HW_CPU_CYCLES = 0;
+const PERF_COUNT_HW_INSTRUCTIONS = 1;
+const PERF_COUNT_HW_CACHE_MISSES = 3;
+const PERF_COUNT_HW_BRANCH_MISSES = 5;
+
+const PERF_COUNT_SW_TASK_CLOCK = 1;
+const PERF_COUNT_SW_PAGE_FAULTS = 2;
+const PERF_COUNT_SW_CONTEXT_SWITCHES = 3;
+
+const PERF_FORMAT_TOTAL_TIME_ENABLED = 1 << 0;
+const PERF_FORMAT_TOTAL_TIME_RUNNING = 1 << 1;
+
+const attr_flag_inherit = 1 << 1;
+const attr_flag_exclude_kernel = 1 << 5;
+const attr_flag_exclude_hv = 1 << 6;
+
+// PERF_ATTR_SIZE_VER5, the bitfields are folded into flags
+const EventAttr = extern struct {
+    type: u32,
+    size: u32 = @sizeOf(EventAttr),
+    config: u64,
+    sample_period: u64 = 0,
+    sample_type: u64 = 0,
+    read_format: u64 = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+    flags: u64 = attr_flag_inherit | attr_flag_exclude_kernel | attr_flag_exclude_hv,
+    wakeup_events: u32 = 0,
+    bp_type: u32 = 0,
+    config1: u64 = 0,
+    config2: u64 = 0,
+    branch_sample_type: u64 = 0,
+    sample_regs_user: u64 = 0,
+    sample_stack_user: u32 = 0,
+    clockid: i32 = 0,
+    sample_regs_intr: u64 = 0,
+    aux_watermark: u32 = 0,
+    sample_max_stack: u16 = 0,
+    reserved: u16 = 0,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(EventAttr) == 112);
+}
+
+pub const Event = struct {
+    name: []const u8,
+    type: u32,
+    config: u64,
+};
+
+const hardware_events = [_]Event{
+    .{ .name = "cycles", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_CPU_CYCLES },
+    .{ .name = "instructions", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_INSTRUCTIONS },
+    .{ .name = "branch-misses", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_BRANCH_MISSES },
+    .{ .name = "llc-misses", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_CACHE_MISSES },
+};
+
+const software_events = [_]Event{
+    .{ .name = "task-clock-ns", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_TASK_CLOCK },
+    .{ .name = "page-faults", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_PAGE_FAULTS },
+    .{ .name = "context-switches", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+pub const max_events = hardware_events.len;
+
+pub const Sample = struct {
+    values: [max_events]u64 = [_]u64{0} ** max_events,
+
+    pub fn sub(end: Sample, start: Sample) Sample {
+        var result = Sample{};
+        for (result.values) |*value, i| {
+            value.* = end.values[i] -| start.values[i];
+        }
+        return result;
+    }
+};
+
+events: [max_events]Event = undefined,
+fds: [max_events]linux.fd_t = undefined,
+len: usize = 0,
+hardware: bool = false,
+// Slots of the events ipc is computed from, null when they didn't open
+cycles: ?usize = null,
+instructions: ?usize = null,
+
+const Self = @This();
+
+const OpenFn = fn (event: Event, group_fd: linux.fd_t) ?linux.fd_t;
+
+fn openEvent(event: Event, group_fd: linux.fd_t) ?linux.fd_t {
+    var attr = EventAttr{ .type = event.type, .config = event.config };
+    // pid 0 and cpu -1, this process on whatever CPU it runs
+    const rc = linux.syscall5(
+        .perf_event_open,
+        @ptrToInt(&attr),
+        0,
+        @bitCast(usize, @as(isize, -1)),
+        @bitCast(usize, @as(isize, group_fd)),
+        0,
+    );
+    if (linux.getErrno(rc) != .SUCCESS) {
+        return null;
+    }
+    return @intCast(linux.fd_t, rc);
+}
+
+// NOTE(radomski): The events are one group so they're scheduled together, but
+// read one by one since inherited counters, the only way to see the printing
+// threads, can't be read with PERF_FORMAT_GROUP.
+fn openGroup(p: *Self, events: []const Event, comptime openFn: OpenFn) bool {
+    for (events) |event| {
+        const group_fd: linux.fd_t = if (p.len == 0) -1 else p.fds[0];
+        const fd = openFn(event, group_fd) orelse {
+            if (p.len == 0) {
+                return false;
+            }
+            continue;
+        };
+        if (event.type == PERF_TYPE_HARDWARE and event.config == PERF_COUNT_HW_CPU_CYCLES) {
+            p.cycles = p.len;
+        } else if (event.type == PERF_TYPE_HARDWARE and event.config == PERF_COUNT_HW_INSTRUCTIONS) {
+            p.instructions = p.len;
+        }
+        p.events[p.len] = event;
+        p.fds[p.len] = fd;
+        p.len += 1;
+    }
+    return true;
+}
+
+pub fn open() ?Self {
+    return openWith(openEvent);
+}
+
+fn openWith(comptime openFn: OpenFn) ?Self {
+    var p = Self{};
+    if (p.openGroup(&hardware_events, openFn)) {
+        p.hardware = true;
+        return p;
+    }
+    if (p.openGroup(&software_events, openFn)) {
+        return p;
+    }
+    return null;
+}
+
+pub fn deinit(p: *Self) void {
+    for (p.fds[0..p.len]) |fd| {
+        _ = linux.close(fd);
+    }
+}
+
+// Values scaled up by enabled / running time, in case the kernel had to
+// multiplex the counters.
+pub fn read(p: *Self) Sample {
+    var sample = Sample{};
+    for (p.fds[0..p.len]) |fd, i| {
+        var buffer: [3]u64 = undefined;
+        const rc = linux.read(fd, @ptrCast([*]u8, &buffer), @sizeOf(@TypeOf(buffer)));
+        if (linux.getErrno(rc) != .SUCCESS or rc != @sizeOf(@TypeOf(buffer))) {
+            continue;
+        }
+        const value = buffer[0];
+        const enabled = buffer[1];
+        const running = buffer[2];
+        sample.values[i] = if (running == 0 or running == enabled) value else @floatToInt(u64, @intToFloat(f64, value) * @intToFloat(f64, enabled) / @intToFloat(f64, running));
+    }
+    return sample;
+}
+
+pub fn kind(p: Self) []const u8 {
+    return if (p.hardware) "hardware" else "software";
+}
+
+// Instructions per cycle, only when both counters opened
+pub fn ipc(p: Self, delta: Sample) ?f64 {
+    const cycles = p.cycles orelse return null;
+    const instructions = p.instructions orelse return null;
+    if (delta.values[cycles] == 0) {
+        return null;
+    }
+    return @intToFloat(f64, delta.values[instructions]) / @intToFloat(f64, delta.values[cycles]);
+}
+
+pub fn print(p: Self, label: []const u8, delta: Sample) void {
+    std.debug.print("{s}:", .{label});
+    for (p.events[0..p.len]) |event, i| {
+        std.debug.print(" {s}={}", .{ event.name, delta.values[i] });
+    }
+    if (p.ipc(delta)) |value| {
+        std.debug.print(" ipc={d:.2}", .{value});
+    }
+    std.debug.print("\n", .{});
+}
+
+// Fake file descriptors, the tests never read or close them
+fn openAll(event: Event, group_fd: linux.fd_t) ?linux.fd_t {
+    _ = group_fd;
+    return @intCast(linux.fd_t, 100 + event.config);
+}
+
+fn openNoHardware(event: Event, group_fd: linux.fd_t) ?linux.fd_t {
+    return if (event.type == PERF_TYPE_HARDWARE) null else openAll(event, group_fd);
+}
+
+fn openNoInstructions(event: Event, group_fd: linux.fd_t) ?linux.fd_t {
+    return if (event.type == PERF_TYPE_HARDWARE and event.config == PERF_COUNT_HW_INSTRUCTIONS) null else openAll(event, group_fd);
+}
+
+fn openNothing(event: Event, group_fd: linux.fd_t) ?linux.fd_t {
+    _ = event;
+    _ = group_fd;
+    return null;
+}
+
+test "hardware counters" {
+    const p = openWith(openAll).?;
+    try std.testing.expect(p.hardware);
+    try std.testing.expectEqual(@as(usize, hardware_events.len), p.len);
+
+    var delta = Sample{};
+    delta.values[p.cycles.?] = 200;
+    delta.values[p.instructions.?] = 300;
+    try std.testing.expectEqual(@as(?f64, 1.5), p.ipc(delta));
+}
+
+test "no ipc without instructions" {
+    const p = openWith(openNoInstructions).?;
+    try std.testing.expect(p.hardware);
+    try std.testing.expectEqual(@as(usize, hardware_events.len - 1), p.len);
+    try std.testing.expectEqual(@as(?usize, null), p.instructions);
+
+    var delta = Sample{};
+    for (delta.values) |*value| {
+        value.* = 100;
+    }
+    try std.testing.expectEqual(@as(?f64, null), p.ipc(delta));
+}
+
+test "software fallback" {
+    const p = openWith(openNoHardware).?;
+    try std.testing.expect(!p.hardware);
+    try std.testing.expectEqualStrings("software", p.kind());
+    try std.testing.expectEqual(@as(usize, software_events.len), p.len);
+    try std.testing.expectEqual(@as(?usize, null), p.cycles);
+    try std.testing.expectEqual(@as(?f64, null), p.ipc(Sample{}));
+}
+
+test "no counters" {
+    try std.testing.expect(openWith(openNothing) == null);
+}
@@ -0,0 +1,433 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const batch = @import("batch.zig");
+const elf = @import("elf.zig");
+
+const fs = std.fs;
+const mem = std.mem;
+const os = std.os;
+const linux = os.linux;
+
+// Reads batch inputs given by path ahead of the parsing workers. Only the ELF
+// header, the section header table, the section names and then the sections
+// the parser uses are read, into a zero filled buffer as big as the file so
+// offsets stay the same. With io_uring several files are in flight from one
+// thread, otherwise a small pool of threads does the same with pread.
+
+pub const Error = error{
+    ReadFailed,
+    UnexpectedEndOfFile,
+};
+
+pub const Backend = enum {
+    io_uring,
+    pread,
+};
+
+pub const Stats = struct {
+    backend: Backend,
+    files: usize = 0,
+    reads: usize = 0,
+    bytes_read: u64 = 0,
+    max_file_bytes: u64 = 0,
+    max_queue_depth: usize = 0,
+    queue_depth_sum: usize = 0,
+
+    pub fn print(stats: Stats) void {
+        const files = @maximum(stats.files, 1);
+        const reads = @maximum(stats.reads, 1);
+        std.debug.print("Prefetch ({s}): {} files, {} reads, {} total, {} per file on average, {} max\n", .{
+            @tagName(stats.backend),
+            stats.files,
+            stats.reads,
+            std.fmt.fmtIntSizeBin(stats.bytes_read),
+            std.fmt.fmtIntSizeBin(stats.bytes_read / files),
+            std.fmt.fmtIntSizeBin(stats.max_file_bytes),
+        });
+        std.debug.print("Prefetch queue depth: {} max, {d:.1} on average\n", .{
+            stats.max_queue_depth,
+            @intToFloat(f64, stats.queue_depth_sum) / @intToFloat(f64, reads),
+        });
+    }
+};
+
+// Files loaded but not yet released by the workers
+const files_ahead = 32;
+const max_files_in_flight = 16;
+const max_reads_per_file = 16;
+const ring_entries = max_files_in_flight * max_reads_per_file;
+const pread_threads = 8;
+
+const Stage = enum {
+    header,
+    section_headers,
+    section_names,
+    sections,
+    done,
+};
+
+const RangeList = std.BoundedArray(elf.FileRange, max_reads_per_file);
+
+// Ranges to read once everything up to stage has been read.
+fn stageRanges(stage: Stage, data: []u8, ranges: *RangeList) !void {
+    switch (stage) {
+        .header => try ranges.append(.{ .offset = 0, .size = @minimum(data.len, elf.elf_header_size) }),
+        .section_headers => try ranges.append(try elf.sectionHeaderTableRange(data)),
+        .section_names => try ranges.append(try elf.sectionNamesRange(data)),
+        .sections => try elf.debugSectionRanges(data, ranges),
+        .done => {},
+    }
+}
+
+fn nextStage(stage: Stage) Stage {
+    return @intToEnum(Stage, @enumToInt(stage) + 1);
+}
+
+inputs: []batch.Input,
+loaded: []std.Thread.ResetEvent,
+errors: []?anyerror,
+gpa: mem.Allocator,
+mutex: std.Thread.Mutex = .{},
+released_cond: std.Thread.Condition = .{},
+released: usize = 0,
+next_input: usize = 0,
+pread_in_flight: usize = 0,
+stats: Stats,
+threads: std.ArrayListUnmanaged(std.Thread) = .{},
+ring: ?linux.IO_Uring = null,
+
+const Self = @This();
+
+pub fn needed(inputs: []const batch.Input) bool {
+    for (inputs) |input| {
+        if (input.path != null) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE(radomski): DIS_PREFETCH=pread skips io_uring, so the fallback can be
+// tested and timed on a machine where io_uring works
+fn requestedBackend() Backend {
+    const value = os.getenv("DIS_PREFETCH") orelse return .io_uring;
+    return std.meta.stringToEnum(Backend, value) orelse blk: {
+        std.log.warn("unknown DIS_PREFETCH backend {s}, using io_uring", .{value});
+        break :blk .io_uring;
+    };
+}
+
+pub fn init(inputs: []batch.Input, gpa: mem.Allocator) !Self {
+    var p = Self{
+        .inputs = inputs,
+        .loaded = try gpa.alloc(std.Thread.ResetEvent, inputs.len),
+        .errors = try gpa.alloc(?anyerror, inputs.len),
+        .gpa = gpa,
+        .stats = .{ .backend = .pread },
+    };
+    mem.set(std.Thread.ResetEvent, p.loaded, .{});
+    mem.set(?anyerror, p.errors, null);
+
+    if (builtin.os.tag == .linux and requestedBackend() == .io_uring) {
+        if (linux.IO_Uring.init(ring_entries, 0)) |ring| {
+            p.ring = ring;
+            p.stats.backend = .io_uring;
+        } else |err| {
+            std.log.debug("io_uring unavailable ({s}), prefetching with pread", .{@errorName(err)});
+        }
+    }
+    return p;
+}
+
+pub fn start(p: *Self) !void {
+    if (p.ring != null) {
+        try p.threads.append(p.gpa, try std.Thread.spawn(.{}, uringLoop, .{p}));
+    } else {
+        const thread_count = @minimum(pread_threads, p.inputs.len);
+        try p.threads.ensureTotalCapacity(p.gpa, thread_count);
+        while (p.threads.items.len < thread_count) {
+            p.threads.appendAssumeCapacity(try std.Thread.spawn(.{}, preadLoop, .{p}));
+        }
+    }
+}
+
+pub fn deinit(p: *Self) void {
+    for (p.threads.items) |thread| {
+        thread.join();
+    }
+    p.threads.deinit(p.gpa);
+    if (p.ring) |*ring| {
+        ring.deinit();
+    }
+    p.gpa.free(p.loaded);
+    p.gpa.free(p.errors);
+}
+
+// Blocks until input i can be parsed.
+pub fn acquire(p: *Self, i: usize) !void {
+    p.loaded[i].wait();
+    if (p.errors[i]) |err| {
+        return err;
+    }
+}
+
+// Every input has to be released once the worker is done with it, it's what
+// lets the prefetcher move ahead.
+pub fn release(p: *Self, i: usize) void {
+    if (p.inputs[i].path != null and p.inputs[i].data.len > 0) {
+        std.heap.page_allocator.free(p.inputs[i].data);
+        p.inputs[i].data = &[_]u8{};
+    }
+
+    p.mutex.lock();
+    p.released += 1;
+    p.mutex.unlock();
+    p.released_cond.broadcast();
+}
+
+// Hands out the next input to load. Inputs which are already in memory are
+// marked loaded on the way.
+fn claimNext(p: *Self, block: bool) ?usize {
+    p.mutex.lock();
+    defer p.mutex.unlock();
+    while (p.next_input < p.inputs.len) {
+        const i = p.next_input;
+        if (p.inputs[i].path == null) {
+            p.next_input += 1;
+            p.loaded[i].set();
+            continue;
+        }
+        if (i >= p.released + files_ahead) {
+            if (!block) {
+                return null;
+            }
+            p.released_cond.wait(&p.mutex);
+            continue;
+        }
+        p.next_input += 1;
+        return i;
+    }
+    return null;
+}
+
+fn hasUnclaimed(p: *Self) bool {
+    p.mutex.lock();
+    defer p.mutex.unlock();
+    return p.next_input < p.inputs.len;
+}
+
+fn recordFile(p: *Self, bytes: u64) void {
+    p.mutex.lock();
+    defer p.mutex.unlock();
+    p.stats.files += 1;
+    p.stats.bytes_read += bytes;
+    p.stats.max_file_bytes = @maximum(p.stats.max_file_bytes, bytes);
+}
+
+fn recordReads(p: *Self, reads: usize, depth: usize) void {
+    p.mutex.lock();
+    defer p.mutex.unlock();
+    p.stats.reads += reads;
+    p.stats.queue_depth_sum += reads * depth;
+    p.stats.max_queue_depth = @maximum(p.stats.max_queue_depth, depth);
+}
+
+fn openInput(p: *Self, i: usize) !fs.File {
+    const file = try fs.cwd().openFile(p.inputs[i].path.?, .{});
+    errdefer file.close();
+    const size = try file.getEndPos();
+    p.inputs[i].data = try std.heap.page_allocator.alloc(u8, size);
+    return file;
+}
+
+// A file which isn't ELF is left empty instead of failing, the same as archive
+// members which aren't.
+fn finishInput(p: *Self, i: usize, result: anyerror!void, bytes: u64) void {
+    result catch |err| {
+        if (p.inputs[i].data.len > 0) {
+            std.heap.page_allocator.free(p.inputs[i].data);
+            p.inputs[i].data = &[_]u8{};
+        }
+        if (err != elf.Error.NotElf) {
+            p.errors[i] = err;
+        }
+    };
+    p.recordFile(bytes);
+    p.loaded[i].set();
+}
+
+fn loadWithPread(p: *Self, i: usize, bytes: *u64) !void {
+    const file = try p.openInput(i);
+    defer file.close();
+    const data = p.inputs[i].data;
+
+    var stage = Stage.header;
+    while (stage != .done) : (stage = nextStage(stage)) {
+        var ranges = RangeList.init(0) catch unreachable;
+        try stageRanges(stage, data, &ranges);
+        for (ranges.slice()) |range| {
+            const depth = @atomicRmw(usize, &p.pread_in_flight, .Add, 1, .Monotonic) + 1;
+            defer _ = @atomicRmw(usize, &p.pread_in_flight, .Sub, 1, .Monotonic);
+            p.recordReads(1, depth);
+
+            const read = try file.preadAll(data[range.offset .. range.offset + range.size], range.offset);
+            if (read != range.size) {
+                return Error.UnexpectedEndOfFile;
+            }
+            bytes.* += range.size;
+        }
+    }
+}
+
+fn preadLoop(p: *Self) void {
+    while (p.claimNext(true)) |i| {
+        var bytes: u64 = 0;
+        p.finishInput(i, p.loadWithPread(i, &bytes), bytes);
+    }
+}
+
+const Read = struct {
+    slot: *Slot,
+    buffer: []u8,
+    offset: u64,
+};
+
+const Slot = struct {
+    input: usize = 0,
+    file: ?fs.File = null,
+    stage: Stage = .header,
+    reads: [max_reads_per_file]Read = undefined,
+    pending: usize = 0,
+    bytes: u64 = 0,
+    err: ?anyerror = null,
+};
+
+fn queueRead(p: *Self, read: *Read) !void {
+    _ = try p.ring.?.read(@ptrToInt(read), read.slot.file.?.handle, .{ .buffer = read.buffer }, read.offset);
+}
+
+// Queues the reads of the slot's current stage, skipping the stages that have
+// nothing to read.
+fn queueStage(p: *Self, slot: *Slot) !void {
+    const data = p.inputs[slot.input].data;
+    while (slot.stage != .done) {
+        var ranges = RangeList.init(0) catch unreachable;
+        try stageRanges(slot.stage, data, &ranges);
+        for (ranges.slice()) |range, i| {
+            slot.reads[i] = .{ .slot = slot, .buffer = data[range.offset .. range.offset + range.size], .offset = range.offset };
+            try p.queueRead(&slot.reads[i]);
+            slot.pending += 1;
+            slot.bytes += range.size;
+        }
+        if (slot.pending > 0) {
+            return;
+        }
+        slot.stage = nextStage(slot.stage);
+    }
+}
+
+fn startSlot(p: *Self, slot: *Slot, i: usize) void {
+    slot.* = .{ .input = i };
+    slot.file = p.openInput(i) catch |err| {
+        slot.err = err;
+        return;
+    };
+    p.queueStage(slot) catch |err| {
+        slot.err = err;
+    };
+}
+
+// True once the slot has nothing left in flight.
+fn completeRead(p: *Self, read: *Read, res: i32) bool {
+    const slot = read.slot;
+    if (slot.err == null) {
+        if (res <= 0) {
+            slot.err = if (res == 0) Error.UnexpectedEndOfFile else Error.ReadFailed;
+        } else if (@intCast(usize, res) < read.buffer.len) {
+            // Short read, ask for the rest
+            read.buffer = read.buffer[@intCast(usize, res)..];
+            read.offset += @intCast(u64, res);
+            if (p.queueRead(read)) {
+                return false;
+            } else |err| {
+                slot.err = err;
+            }
+        }
+    }
+
+    slot.pending -= 1;
+    if (slot.pending > 0) {
+        return false;
+    }
+    if (slot.err == null) {
+        slot.stage = nextStage(slot.stage);
+        p.queueStage(slot) catch |err| {
+            slot.err = err;
+        };
+    }
+    return slot.pending == 0;
+}
+
+fn finishSlot(p: *Self, slot: *Slot) void {
+    if (slot.file) |file| {
+        file.close();
+    }
+    const result: anyerror!void = if (slot.err) |err| err else {};
+    p.finishInput(slot.input, result, slot.bytes);
+}
+
+fn uringLoop(p: *Self) void {
+    var slots = [_]Slot{.{}} ** max_files_in_flight;
+    var free_slots: [max_files_in_flight]*Slot = undefined;
+    for (slots) |*slot, i| {
+        free_slots[i] = slot;
+    }
+    var free_count: usize = max_files_in_flight;
+    var in_flight_reads: usize = 0;
+
+    while (true) {
+        // NOTE(radomski): Only block waiting for the workers when nothing is
+        // in flight, completions are what the workers are waiting for.
+        while (free_count > 0) {
+            const i = p.claimNext(free_count == max_files_in_flight) orelse break;
+            free_count -= 1;
+            const slot = free_slots[free_count];
+            p.startSlot(slot, i);
+            if (slot.pending == 0) {
+                p.finishSlot(slot);
+                free_slots[free_count] = slot;
+                free_count += 1;
+            }
+        }
+
+        const queued = p.ring.?.sq_ready();
+        if (queued > 0) {
+            _ = p.ring.?.submit() catch |err| {
+                // NOTE(radomski): The entries stay queued, try again
+                std.log.warn("io_uring submit: {s}", .{@errorName(err)});
+                continue;
+            };
+            in_flight_reads += queued;
+            p.recordReads(queued, in_flight_reads);
+        }
+
+        if (free_count == max_files_in_flight) {
+            if (!p.hasUnclaimed()) {
+                break;
+            }
+            continue;
+        }
+
+        const cqe = p.ring.?.copy_cqe() catch |err| {
+            std.log.warn("io_uring wait: {s}", .{@errorName(err)});
+            continue;
+        };
+        in_flight_reads -= 1;
+        const read = @intToPtr(*Read, cqe.user_data);
+        if (p.completeRead(read, cqe.res)) {
+            p.finishSlot(read.slot);
+            free_slots[free_count] = read.slot;
+            free_count += 1;
+        }
+    }
+}
@@ -0,0 +1,456 @@
+const std = @import("std");
+const main = @import("main.zig");
+const Context = main.Context;
+const Structure = main.Structure;
+const MemberId = main.MemberId;
+
+const fmt = std.fmt;
+const mem = std.mem;
+
+// --profile <path>, layouts with the hottest fields in the first cache lines.
+// The profile has a `Type::member count` per line, `#` starts a comment, and
+// the type may be namespace qualified.
+//
+// Members that have to stay together are placed as one unit: bitfields
+// sharing storage, anything overlapping them, and inline structures. Bases and
+// _vptr stay first. Hot units go first by count, cold ones by alignment, each
+// one in the first gap it fits in.
+//
+// Lines touched per access assume every access to the object touches its
+// hottest field, and every other field independently with count/max_count.
+
+pub const Error = error{
+    MalformedProfile,
+};
+
+pub const default_line_size = 64;
+// NOTE(radomski): Alignment isn't in the tables, it's the natural one for
+// the size, no more than what the current offset allows
+const max_alignment = 16;
+
+pub const Counts = std.StringHashMapUnmanaged(u64);
+
+pub const ProfiledType = struct {
+    name: []const u8,
+    counts: Counts = .{},
+    found: bool = false,
+};
+
+const Unit = struct {
+    first: MemberId,
+    end: MemberId,
+    offset: u64,
+    size: u64,
+    alignment: u64,
+    count: u64 = 0,
+    pinned: bool = false,
+    new_offset: u64 = 0,
+};
+
+const Gap = struct {
+    start: u64,
+    end: u64,
+};
+
+pub const Profile = struct {
+    types: std.StringArrayHashMapUnmanaged(ProfiledType) = .{},
+    // Unqualified name to the profiled types that may match it
+    by_short_name: std.StringHashMapUnmanaged(std.ArrayListUnmanaged(usize)) = .{},
+};
+
+fn shortName(name: []const u8) []const u8 {
+    const pos = mem.lastIndexOf(u8, name, "::") orelse return name;
+    return name[pos + 2 ..];
+}
+
+pub fn load(profile_path: []const u8, arena: mem.Allocator) !Profile {
+    const text = try std.fs.cwd().readFileAlloc(arena, profile_path, std.math.maxInt(u32));
+    return parse(text, arena);
+}
+
+// Profiled type for the structure, each one matches at most one structure
+pub fn find(profile: *Profile, name: []const u8, namespaces: []main.Namespace) ?*ProfiledType {
+    const candidates = profile.by_short_name.get(name) orelse return null;
+    for (candidates.items) |index| {
+        const candidate = &profile.types.values()[index];
+        if (!candidate.found and main.ContainerFilter.matches(main.ContainerFilter{ .name = candidate.name }, name, namespaces)) {
+            candidate.found = true;
+            return candidate;
+        }
+    }
+    return null;
+}
+
+fn parse(text: []const u8, arena: mem.Allocator) !Profile {
+    var profile = Profile{};
+    var lines = mem.split(u8, text, "\n");
+    var line_number: usize = 0;
+    while (lines.next()) |raw_line| {
+        line_number += 1;
+        const line = mem.trim(u8, raw_line[0 .. mem.indexOfScalar(u8, raw_line, '#') orelse raw_line.len], " \t\r");
+        if (line.len == 0) {
+            continue;
+        }
+
+        var fields = mem.tokenize(u8, line, " \t");
+        const path = fields.next() orelse continue;
+        const count_text = fields.next() orelse "";
+        const separator = mem.lastIndexOf(u8, path, "::");
+        const count: ?u64 = fmt.parseInt(u64, count_text, 10) catch null;
+        if (separator == null or separator.? == 0 or count == null or fields.next() != null) {
+            std.log.err("profile line {}: expected `Type::member count`", .{line_number});
+            return Error.MalformedProfile;
+        }
+
+        const type_name = path[0..separator.?];
+        const gop = try profile.types.getOrPut(arena, type_name);
+        if (!gop.found_existing) {
+            gop.value_ptr.* = .{ .name = type_name };
+            const short = try profile.by_short_name.getOrPut(arena, shortName(type_name));
+            if (!short.found_existing) {
+                short.value_ptr.* = .{};
+            }
+            try short.value_ptr.append(arena, gop.index);
+        }
+        const member = try gop.value_ptr.counts.getOrPut(arena, path[separator.? + 2 ..]);
+        member.value_ptr.* = if (member.found_existing) member.value_ptr.* + count.? else count.?;
+    }
+    return profile;
+}
+
+fn naturalAlignment(c: *Context, type_id: main.TypeId) u64 {
+    const t = c.types.get(type_id);
+    if (t.ptr_count == 0 and t.struct_type != .none and t.struct_id != std.math.maxInt(main.StructId)) {
+        const s = c.structures.get(t.struct_id);
+        var alignment: u64 = 1;
+        var member_id = s.member_range.start;
+        while (member_id < s.member_range.end) : (member_id += 1) {
+            if (c.members.items(.kind)[member_id] != .virtual_base) {
+                alignment = @maximum(alignment, naturalAlignment(c, c.members.items(.type_id)[member_id]));
+            }
+        }
+        return alignment;
+    }
+    if (t.size == 0) {
+        return 1;
+    }
+    return @minimum(max_alignment, @as(u64, 1) << @intCast(u6, @ctz(t.size)));
+}
+
+fn memberSize(c: *Context, member_id: MemberId) u64 {
+    const t = c.types.get(c.members.items(.type_id)[member_id]);
+    var size: u64 = t.size;
+    if (t.isArray()) {
+        size *= t.dimension;
+    }
+    return size;
+}
+
+// Count of the member, plus the ones of the members of anonymous inline
+// structures and bases, which are accessed through the outer type's name.
+fn memberCount(c: *Context, counts: *const Counts, member_id: MemberId) u64 {
+    const member = c.members.get(member_id);
+    var count = counts.get(c.getName(member.name)) orelse 0;
+    const t = c.types.get(member.type_id);
+    const flattened = member.kind == .base or (t.name == 0 and t.struct_type != .none);
+    if (flattened and t.struct_id != std.math.maxInt(main.StructId)) {
+        const s = c.structures.get(t.struct_id);
+        var inner_id = s.member_range.start;
+        while (inner_id < s.member_range.end) : (inner_id += 1) {
+            count += memberCount(c, counts, inner_id);
+        }
+    }
+    return count;
+}
+
+fn collectUnits(c: *Context, s: Structure, counts: *const Counts, units: *std.ArrayList(Unit)) !void {
+    units.clearRetainingCapacity();
+    var member_id = s.member_range.start;
+    while (member_id < s.member_range.end) : (member_id += 1) {
+        const member = c.members.get(member_id);
+        if (member.kind == .virtual_base) {
+            continue;
+        }
+
+        const size = @maximum(memberSize(c, member_id), 1);
+        var alignment = naturalAlignment(c, member.type_id);
+        if (member.mem_loc != 0) {
+            alignment = @minimum(alignment, @as(u64, 1) << @intCast(u6, @ctz(member.mem_loc)));
+        }
+        const count = memberCount(c, counts, member_id);
+        const pinned = member.kind == .base or mem.startsWith(u8, c.getName(member.name), "_vptr");
+
+        // NOTE(radomski): Bitfields sharing storage, or anything living in
+        // the storage or tail padding of the one before, moves with it
+        if (units.items.len > 0) {
+            const last = &units.items[units.items.len - 1];
+            if (member.mem_loc < last.offset + last.size) {
+                last.end = member_id + 1;
+                last.size = @maximum(last.size, member.mem_loc + size - last.offset);
+                last.alignment = @maximum(last.alignment, alignment);
+                last.count += count;
+                last.pinned = last.pinned or pinned;
+                continue;
+            }
+        }
+
+        try units.append(.{
+            .first = member_id,
+            .end = member_id + 1,
+            .offset = member.mem_loc,
+            .size = size,
+            .alignment = alignment,
+            .count = count,
+            .pinned = pinned,
+        });
+    }
+}
+
+fn unitLessThan(context: void, a: Unit, b: Unit) bool {
+    _ = context;
+    if (a.pinned != b.pinned) {
+        return a.pinned;
+    }
+    if (a.pinned) {
+        return a.offset < b.offset;
+    }
+    if (a.count != b.count) {
+        return a.count > b.count;
+    }
+    if (a.alignment != b.alignment) {
+        return a.alignment > b.alignment;
+    }
+    if (a.size != b.size) {
+        return a.size > b.size;
+    }
+    return a.offset < b.offset;
+}
+
+// Places the units in order, each in the first gap left by the ones before
+// it, otherwise at the end. Returns the end of the last one.
+fn place(units: []Unit, gaps: *std.ArrayList(Gap)) !u64 {
+    gaps.clearRetainingCapacity();
+    var end: u64 = 0;
+    for (units) |*unit| {
+        for (gaps.items) |*gap, i| {
+            const start = mem.alignForward(gap.start, unit.alignment);
+            if (start + unit.size > gap.end) {
+                continue;
+            }
+            unit.new_offset = start;
+            const after = Gap{ .start = start + unit.size, .end = gap.end };
+            gap.end = start;
+            if (after.start < after.end) {
+                try gaps.insert(i + 1, after);
+            }
+            break;
+        } else {
+            unit.new_offset = mem.alignForward(end, unit.alignment);
+            if (unit.new_offset > end) {
+                try gaps.append(.{ .start = end, .end = unit.new_offset });
+            }
+            end = unit.new_offset + unit.size;
+        }
+    }
+    return end;
+}
+
+// Expected distinct cache lines touched per access to the object.
+fn linesPerAccess(units: []const Unit, use_new: bool, size: u64, line_size: u64, arena: mem.Allocator) !f64 {
+    var max_count: u64 = 0;
+    for (units) |unit| {
+        max_count = @maximum(max_count, unit.count);
+    }
+    if (max_count == 0) {
+        return 0;
+    }
+
+    // Probability of each line staying untouched
+    var untouched = try arena.alloc(f64, @maximum(1, (size + line_size - 1) / line_size));
+    mem.set(f64, untouched, 1);
+    for (units) |unit| {
+        if (unit.count == 0) {
+            continue;
+        }
+        const p = @intToFloat(f64, unit.count) / @intToFloat(f64, max_count);
+        const offset = if (use_new) unit.new_offset else unit.offset;
+        var line = offset / line_size;
+        while (line <= (offset + unit.size - 1) / line_size and line < untouched.len) : (line += 1) {
+            untouched[line] *= 1 - p;
+        }
+    }
+
+    var lines: f64 = 0;
+    for (untouched) |q| {
+        lines += 1 - q;
+    }
+    return lines;
+}
+
+fn printUnit(c: *Context, stdout: anytype, s: Structure, unit: Unit, counts: *const Counts) !void {
+    var member_id = unit.first;
+    while (member_id < unit.end) : (member_id += 1) {
+        const member = c.members.get(member_id);
+        const mtype = c.types.get(member.type_id);
+        const offset = unit.new_offset + member.mem_loc - unit.offset;
+        const count = memberCount(c, counts, member_id);
+
+        const inline_struct = s.inline_structures.contains(mtype.struct_id) or (mtype.name == 0 and mtype.struct_type != .none);
+        if (member.kind == .base) {
+            try stdout.print("  {s} // base, size={}, offset={}", .{ c.getName(mtype.name), mtype.size, offset });
+        } else if (inline_struct) {
+            const prefix = if (mtype.struct_type == .union_type) "union" else "struct";
+            const name = if (mtype.name != 0) c.getName(mtype.name) else "{...}";
+            try stdout.print("  {s} {s} {s}; // size={}, offset={}", .{ prefix, name, c.getName(member.name), mtype.size, offset });
+        } else {
+            const qualifiers = mtype.qualifiers.text();
+            try stdout.print("  {s}{s} ", .{ if (mtype.ptr_count == 0) qualifiers else "", c.getName(mtype.name) });
+            try stdout.writeByteNTimes('*', mtype.ptr_count);
+            if (mtype.ptr_count > 0) {
+                try stdout.writeAll(qualifiers);
+            }
+            try stdout.writeAll(c.getName(member.name));
+            if (mtype.isArray()) {
+                try stdout.print("[{}]", .{mtype.dimension});
+            }
+            if (member.bit_size != 0) {
+                try stdout.print(":{}; // size={}, offset={}:{}", .{ member.bit_size, mtype.size, offset, member.bit_loc });
+            } else {
+                try stdout.print("; // size={}, offset={}", .{ memberSize(c, member_id), offset });
+            }
+        }
+        if (count > 0) {
+            try stdout.print(", count={}", .{count});
+        }
+        try stdout.writeAll("\n");
+    }
+}
+
+fn printLayout(
+    c: *Context,
+    stdout: anytype,
+    s: Structure,
+    name: []const u8,
+    units: []const Unit,
+    counts: *const Counts,
+    new_size: u64,
+    lines_before: f64,
+    lines_after: f64,
+) !void {
+    const stype = c.types.get(s.type_id);
+    const prefix = if (stype.struct_type == .class_type) "class" else "struct";
+    try stdout.print("{s} {s} {{ // size={}, was {}, lines per access {d:.2} => {d:.2}", .{
+        prefix,
+        name,
+        new_size,
+        stype.size,
+        lines_before,
+        lines_after,
+    });
+    if (lines_before > 0) {
+        try stdout.print(" ({d:.1}%)", .{(lines_after - lines_before) * 100 / lines_before});
+    }
+    try stdout.writeAll("\n");
+
+    var offset: u64 = 0;
+    for (units) |unit| {
+        if (unit.new_offset > offset) {
+            try stdout.print("  // HOLE => {} bytes\n", .{unit.new_offset - offset});
+        }
+        try printUnit(c, stdout, s, unit, counts);
+        offset = unit.new_offset + unit.size;
+    }
+    if (new_size > offset) {
+        try stdout.print("  // HOLE => {} bytes\n", .{new_size - offset});
+    }
+    try stdout.writeAll("};\n");
+}
+
+fn newOffsetLessThan(context: void, a: Unit, b: Unit) bool {
+    _ = context;
+    return a.new_offset < b.new_offset;
+}
+
+pub fn run(c: *Context, profile_path: []const u8, line_size: u64, arena: mem.Allocator) !void {
+    var profile = try load(profile_path, arena);
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.bufferedWriter(stdout_file);
+    const stdout = bw.writer();
+
+    var units = std.ArrayList(Unit).init(arena);
+    var gaps = std.ArrayList(Gap).init(arena);
+    var weighted_before: f64 = 0;
+    var weighted_after: f64 = 0;
+    var weight: f64 = 0;
+
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        const stype = c.types.get(s.type_id);
+        const profiled = find(&profile, c.getName(stype.name), it.activeNamespaces()) orelse continue;
+
+        if (stype.struct_type == .union_type) {
+            std.log.warn("{s} is a union, its members all start at 0", .{profiled.name});
+            continue;
+        }
+
+        try collectUnits(c, s, &profiled.counts, &units);
+        var max_count: u64 = 0;
+        var struct_alignment: u64 = 1;
+        for (units.items) |unit| {
+            max_count = @maximum(max_count, unit.count);
+            struct_alignment = @maximum(struct_alignment, unit.alignment);
+        }
+        var counts_it = profiled.counts.keyIterator();
+        while (counts_it.next()) |member_name| {
+            if (!hasMember(c, s, member_name.*)) {
+                std.log.warn("{s} has no member {s}", .{ profiled.name, member_name.* });
+            }
+        }
+
+        std.sort.sort(Unit, units.items, {}, unitLessThan);
+        const end = try place(units.items, &gaps);
+        const new_size = mem.alignForward(end, struct_alignment);
+        std.sort.sort(Unit, units.items, {}, newOffsetLessThan);
+
+        const lines_before = try linesPerAccess(units.items, false, stype.size, line_size, arena);
+        const lines_after = try linesPerAccess(units.items, true, new_size, line_size, arena);
+        try printLayout(c, stdout, s, profiled.name, units.items, &profiled.counts, new_size, lines_before, lines_after);
+
+        weighted_before += lines_before * @intToFloat(f64, max_count);
+        weighted_after += lines_after * @intToFloat(f64, max_count);
+        weight += @intToFloat(f64, max_count);
+    }
+
+    for (profile.types.values()) |profiled| {
+        if (!profiled.found) {
+            std.log.warn("no structure named {s}", .{profiled.name});
+        }
+    }
+
+    if (weighted_before > 0) {
+        try stdout.print("Lines per access over all profiled types: {d:.2} => {d:.2} ({d:.1}%)\n", .{
+            weighted_before / weight,
+            weighted_after / weight,
+            (weighted_after - weighted_before) * 100 / weighted_before,
+        });
+    }
+    try bw.flush();
+}
+
+fn hasMember(c: *Context, s: Structure, name: []const u8) bool {
+    var member_id = s.member_range.start;
+    while (member_id < s.member_range.end) : (member_id += 1) {
+        const member = c.members.get(member_id);
+        if (mem.eql(u8, c.getName(member.name), name)) {
+            return true;
+        }
+        const t = c.types.get(member.type_id);
+        const flattened = member.kind == .base or (t.name == 0 and t.struct_type != .none);
+        if (flattened and t.struct_id != std.math.maxInt(main.StructId) and hasMember(c, c.structures.get(t.struct_id), name)) {
+            return true;
+        }
+    }
+    return false;
+}
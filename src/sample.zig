@@ -0,0 +1,243 @@
+const std = @import("std");
+const main = @import("main.zig");
+const summary = @import("summary.zig");
+const Context = main.Context;
+
+const fmt = std.fmt;
+const mem = std.mem;
+
+// --sample=P%, estimates of whole binary statistics from a fraction of the
+// CUs. CUs are split into strata holding equal shares of the payload, P% of
+// every stratum is drawn at random and parsed with the usual Context, and
+// every statistic is extrapolated per stratum with a ratio estimator over
+// payload_size, which is known for all CUs without parsing them.
+
+pub const Error = error{
+    InvalidSamplePercent,
+    NoUnitsToSample,
+};
+
+const stratum_count = 8;
+// Two per stratum at least, one CU gives no variance
+const min_per_stratum = 2;
+// 95% confidence
+const z_score = 1.96;
+
+const size_bucket_labels = summary.size_bucket_labels;
+const hole_bucket_labels = [_][]const u8{ "<1", "1", "2-3", "4-7", "8-15", ">=16" };
+
+const structures_metric = 0;
+const padding_metric = 1;
+const holes_metric = 2;
+const size_buckets_start = 3;
+const hole_buckets_start = size_buckets_start + size_bucket_labels.len;
+const metric_count = hole_buckets_start + hole_bucket_labels.len;
+
+// Measured per sampled CU, each estimated on its own
+const Measurement = [metric_count]f64;
+
+const Estimate = struct {
+    total: f64,
+    margin: f64,
+};
+
+pub fn parsePercent(text: []const u8) !f64 {
+    const number = if (mem.endsWith(u8, text, "%")) text[0 .. text.len - 1] else text;
+    const percent = fmt.parseFloat(f64, number) catch return Error.InvalidSamplePercent;
+    if (!(percent > 0 and percent <= 100)) {
+        return Error.InvalidSamplePercent;
+    }
+    return percent;
+}
+
+fn holeBucket(size_bits: u64) usize {
+    const bytes = size_bits / 8;
+    if (bytes == 0) {
+        return 0;
+    }
+    return 1 + @minimum(hole_bucket_labels.len - 2, std.math.log2_int(u64, bytes));
+}
+
+fn payloadLessThan(c: *Context, a: usize, b: usize) bool {
+    return c.dwarf.cus.items[a].payload_size < c.dwarf.cus.items[b].payload_size;
+}
+
+fn measure(c: *Context, measurements: []Measurement, slot_of: []const u32, arena: mem.Allocator) !void {
+    // NOTE(radomski): Typedef copies are skipped like in --summary, so the
+    // estimates are of the totals it prints
+    var seen_members = std.AutoHashMap(u32, void).init(arena);
+
+    var holes = std.ArrayList(Context.Hole).init(arena);
+    var parsed_index: usize = 0;
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        if (s.member_range.len() > 0) {
+            const gop = try seen_members.getOrPut(s.member_range.start);
+            if (gop.found_existing) {
+                continue;
+            }
+        }
+
+        const sid = it.sid - 1;
+        while (parsed_index + 1 < c.parsed_cus.items.len and c.parsed_cus.items[parsed_index + 1].first_structure <= sid) {
+            parsed_index += 1;
+        }
+        const m = &measurements[slot_of[c.parsed_cus.items[parsed_index].cu_index]];
+
+        m[structures_metric] += 1;
+        m[size_buckets_start + summary.sizeBucket(c.types.items(.shape)[s.type_id].size)] += 1;
+
+        holes.clearRetainingCapacity();
+        try c.collectHoles(s, 0, &holes);
+        for (holes.items) |hole| {
+            m[padding_metric] += @intToFloat(f64, hole.size_bits) / 8;
+            m[holes_metric] += 1;
+            m[hole_buckets_start + holeBucket(hole.size_bits)] += 1;
+        }
+    }
+}
+
+pub fn run(c: *Context, percent: f64, seed: u64, arena: mem.Allocator) !void {
+    const cus = c.dwarf.cus.items;
+    if (cus.len == 0) {
+        return Error.NoUnitsToSample;
+    }
+
+    var order = try arena.alloc(usize, cus.len);
+    for (order) |*index, i| {
+        index.* = i;
+    }
+    std.sort.sort(usize, order, c, payloadLessThan);
+
+    var total_payload: u64 = 0;
+    for (cus) |cu| {
+        total_payload += cu.payload_size;
+    }
+
+    // Consecutive runs of CUs, smallest first, each with about an equal share
+    // of the payload
+    var strata: [stratum_count]std.ArrayListUnmanaged(usize) = [_]std.ArrayListUnmanaged(usize){.{}} ** stratum_count;
+    var stratum_payload = [_]u64{0} ** stratum_count;
+    var payload_before: u64 = 0;
+    for (order) |cu_index| {
+        const h = @minimum(stratum_count - 1, payload_before * stratum_count / @maximum(total_payload, 1));
+        try strata[h].append(arena, cu_index);
+        stratum_payload[h] += cus[cu_index].payload_size;
+        payload_before += cus[cu_index].payload_size;
+    }
+
+    var prng = std.rand.DefaultPrng.init(seed);
+    const random = prng.random();
+    var selected = try arena.alloc(bool, cus.len);
+    mem.set(bool, selected, false);
+    var sampled_cus: usize = 0;
+    var sampled_payload: u64 = 0;
+    for (strata) |stratum| {
+        const population = stratum.items.len;
+        const wanted = @floatToInt(usize, @ceil(@intToFloat(f64, population) * percent / 100));
+        const n = @minimum(population, @maximum(wanted, min_per_stratum));
+        // Partial Fisher-Yates, the first n end up a uniform sample
+        var i: usize = 0;
+        while (i < n) : (i += 1) {
+            const j = random.intRangeLessThan(usize, i, population);
+            mem.swap(usize, &stratum.items[i], &stratum.items[j]);
+            selected[stratum.items[i]] = true;
+            sampled_payload += cus[stratum.items[i]].payload_size;
+        }
+        sampled_cus += n;
+    }
+
+    var timer = try std.time.Timer.start();
+    try c.parseSelected(selected);
+    c.sortNamespaces();
+    const parse_ns = timer.read();
+
+    var slot_of = try arena.alloc(u32, cus.len);
+    for (c.parsed_cus.items) |parsed, slot| {
+        slot_of[parsed.cu_index] = @intCast(u32, slot);
+    }
+    var measurements = try arena.alloc(Measurement, c.parsed_cus.items.len);
+    for (measurements) |*m| {
+        m.* = [_]f64{0} ** metric_count;
+    }
+    try measure(c, measurements, slot_of, arena);
+
+    var estimates = [_]Estimate{.{ .total = 0, .margin = 0 }} ** metric_count;
+    var variances = [_]f64{0} ** metric_count;
+    for (strata) |stratum, h| {
+        const population = stratum.items.len;
+        var n: usize = 0;
+        while (n < population and selected[stratum.items[n]]) : (n += 1) {}
+        if (n == 0) {
+            continue;
+        }
+        const sample = stratum.items[0..n];
+
+        var x_sum: f64 = 0;
+        for (sample) |cu_index| {
+            x_sum += @intToFloat(f64, cus[cu_index].payload_size);
+        }
+
+        for (estimates) |*estimate, metric| {
+            var y_sum: f64 = 0;
+            for (sample) |cu_index| {
+                y_sum += measurements[slot_of[cu_index]][metric];
+            }
+            // Every CU of the stratum empty, nothing to scale by
+            if (x_sum == 0) {
+                estimate.total += y_sum * @intToFloat(f64, population) / @intToFloat(f64, n);
+                continue;
+            }
+
+            const ratio = y_sum / x_sum;
+            estimate.total += ratio * @intToFloat(f64, stratum_payload[h]);
+            if (n == population or n < 2) {
+                continue;
+            }
+
+            var residuals: f64 = 0;
+            for (sample) |cu_index| {
+                const d = measurements[slot_of[cu_index]][metric] - ratio * @intToFloat(f64, cus[cu_index].payload_size);
+                residuals += d * d;
+            }
+            const big_n = @intToFloat(f64, population);
+            const small_n = @intToFloat(f64, n);
+            variances[metric] += big_n * big_n * (1 - small_n / big_n) / small_n * residuals / (small_n - 1);
+        }
+    }
+    for (estimates) |*estimate, metric| {
+        estimate.margin = z_score * @sqrt(variances[metric]);
+    }
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.bufferedWriter(stdout_file);
+    const stdout = bw.writer();
+    try stdout.print("Sampled {} of {} CUs ({d:.1}%), {} of {} payload ({d:.1}%), {} strata, seed {}\n", .{
+        sampled_cus,
+        cus.len,
+        @intToFloat(f64, sampled_cus) * 100 / @intToFloat(f64, cus.len),
+        fmt.fmtIntSizeBin(sampled_payload),
+        fmt.fmtIntSizeBin(total_payload),
+        @intToFloat(f64, sampled_payload) * 100 / @intToFloat(f64, @maximum(total_payload, 1)),
+        stratum_count,
+        seed,
+    });
+    try stdout.print("Parsed in {}, estimated totals with 95% intervals:\n", .{fmt.fmtDuration(parse_ns)});
+    try printEstimate(stdout, "structures", estimates[structures_metric]);
+    try printEstimate(stdout, "padding bytes", estimates[padding_metric]);
+    try printEstimate(stdout, "holes", estimates[holes_metric]);
+    try stdout.writeAll("Structure sizes in bytes:\n");
+    for (size_bucket_labels) |label, i| {
+        try printEstimate(stdout, label, estimates[size_buckets_start + i]);
+    }
+    try stdout.writeAll("Hole sizes in bytes:\n");
+    for (hole_bucket_labels) |label, i| {
+        try printEstimate(stdout, label, estimates[hole_buckets_start + i]);
+    }
+    try bw.flush();
+}
+
+fn printEstimate(stdout: anytype, label: []const u8, estimate: Estimate) !void {
+    try stdout.print("  {s:<14} {d:>14.0} +- {d:.0}\n", .{ label, estimate.total, estimate.margin });
+}
@@ -0,0 +1,307 @@
+const std = @import("std");
+const elf = @import("elf.zig");
+const main = @import("main.zig");
+const Buffer = main.Buffer;
+const Context = main.Context;
+
+const fs = std.fs;
+const mem = std.mem;
+const net = std.net;
+
+const KiloByte = 1024;
+const MegaByte = KiloByte * 1024;
+
+// Requests are single lines with space separated fields:
+//
+//   type <binary path> <type name>
+//   offset <binary path> <type name> <byte offset>
+//   filter <binary path> <substring>
+//   shutdown
+//
+// Every response starts with a status line, either "ok <payload length>\n"
+// followed by exactly that many bytes of payload, or "error <message>\n".
+// Type names can be bare or namespace qualified (ns::name).
+
+const CacheEntry = struct {
+    path: []const u8,
+    mtime: i128,
+    build_id: []const u8,
+    arena_instance: std.heap.ArenaAllocator,
+    context: Context,
+    memory_size: usize,
+    last_used: u64,
+};
+
+const Server = struct {
+    gpa: mem.Allocator,
+    entries: std.ArrayListUnmanaged(*CacheEntry) = .{},
+    memory_limit: usize,
+    memory_used: usize = 0,
+    tick: u64 = 0,
+
+    const Self = @This();
+
+    const Status = enum {
+        keep_running,
+        shutdown,
+    };
+
+    fn destroyEntry(s: *Self, entry: *CacheEntry) void {
+        s.memory_used -= entry.memory_size;
+        s.gpa.free(entry.path);
+        s.gpa.free(entry.build_id);
+        entry.arena_instance.deinit();
+        s.gpa.destroy(entry);
+    }
+
+    fn removeEntry(s: *Self, index: usize) void {
+        const entry = s.entries.swapRemove(index);
+        s.destroyEntry(entry);
+    }
+
+    fn evictToLimit(s: *Self, keep: *CacheEntry) void {
+        while (s.memory_used > s.memory_limit) {
+            var lru_index: ?usize = null;
+            for (s.entries.items) |entry, i| {
+                if (entry == keep) {
+                    continue;
+                }
+                if (lru_index == null or entry.last_used < s.entries.items[lru_index.?].last_used) {
+                    lru_index = i;
+                }
+            }
+
+            if (lru_index) |i| {
+                std.log.info("evicting {s}", .{s.entries.items[i].path});
+                s.removeEntry(i);
+            } else {
+                break;
+            }
+        }
+    }
+
+    fn load(s: *Self, path: []const u8, stat: fs.File.Stat) !*CacheEntry {
+        var entry = try s.gpa.create(CacheEntry);
+        errdefer s.gpa.destroy(entry);
+        entry.arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+        errdefer entry.arena_instance.deinit();
+        const arena = entry.arena_instance.allocator();
+
+        const file = try fs.cwd().openFile(path, .{});
+        defer file.close();
+        var exec_bin = try arena.alloc(u8, stat.size);
+        const read = try file.readAll(exec_bin);
+        if (read != stat.size) {
+            return error.UnexpectedEndOfFile;
+        }
+
+        var build_id_buffer = Buffer{ .data = exec_bin };
+        const build_id = try s.gpa.dupe(u8, elf.getBuildId(&build_id_buffer));
+        errdefer s.gpa.free(build_id);
+
+        entry.context = try main.contextFromElf(exec_bin, arena);
+        try entry.context.parse();
+        entry.context.sortNamespaces();
+
+        var memory_size: usize = 0;
+        var it = entry.arena_instance.state.buffer_list.first;
+        while (it) |node| : (it = node.next) {
+            memory_size += node.data.len;
+        }
+
+        entry.path = try s.gpa.dupe(u8, path);
+        entry.mtime = stat.mtime;
+        entry.build_id = build_id;
+        entry.memory_size = memory_size;
+        entry.last_used = s.tick;
+        return entry;
+    }
+
+    fn buildIdOf(s: *Self, path: []const u8) ![]const u8 {
+        const file = try fs.cwd().openFile(path, .{});
+        defer file.close();
+        const size = try file.getEndPos();
+        if (size == 0) {
+            return &[_]u8{};
+        }
+
+        const mapping = try std.os.mmap(null, size, std.os.PROT.READ, std.os.MAP.PRIVATE, file.handle, 0);
+        defer std.os.munmap(mapping);
+
+        var buffer = Buffer{ .data = mapping };
+        return s.gpa.dupe(u8, elf.getBuildId(&buffer));
+    }
+
+    fn getContext(s: *Self, path: []const u8) !*Context {
+        s.tick += 1;
+        const stat = blk: {
+            const file = try fs.cwd().openFile(path, .{});
+            defer file.close();
+            break :blk try file.stat();
+        };
+
+        for (s.entries.items) |entry, i| {
+            if (!mem.eql(u8, entry.path, path)) {
+                continue;
+            }
+
+            if (entry.mtime == stat.mtime) {
+                entry.last_used = s.tick;
+                return &entry.context;
+            }
+
+            // NOTE(radomski): Deliberately not a reload on every mtime change,
+            // a rebuild that produced the same build-id only touched the mtime
+            // and keeps the parsed context. Without a build-id there is nothing
+            // to compare, so those reload whenever the mtime moves.
+            const build_id = try s.buildIdOf(path);
+            defer s.gpa.free(build_id);
+            if (build_id.len > 0 and mem.eql(u8, build_id, entry.build_id)) {
+                entry.mtime = stat.mtime;
+                entry.last_used = s.tick;
+                return &entry.context;
+            }
+
+            s.removeEntry(i);
+            break;
+        }
+
+        const entry = try s.load(path, stat);
+        s.memory_used += entry.memory_size;
+        s.entries.append(s.gpa, entry) catch |err| {
+            s.destroyEntry(entry);
+            return err;
+        };
+        s.evictToLimit(entry);
+
+        return &entry.context;
+    }
+
+    fn handleRequest(s: *Self, line: []const u8, payload: *std.ArrayList(u8)) !Status {
+        var it = mem.tokenize(u8, line, " \t\r");
+        const command = it.next() orelse return error.EmptyRequest;
+        const writer = payload.writer();
+
+        if (mem.eql(u8, command, "shutdown")) {
+            return .shutdown;
+        } else if (mem.eql(u8, command, "type")) {
+            const path = it.next() orelse return error.MissingBinaryPath;
+            const name = it.next() orelse return error.MissingTypeName;
+            const c = try s.getContext(path);
+            if (try c.writeContainers(payload, .{ .name = name }, s.gpa) == 0) {
+                return error.TypeNotFound;
+            }
+        } else if (mem.eql(u8, command, "offset")) {
+            const path = it.next() orelse return error.MissingBinaryPath;
+            const name = it.next() orelse return error.MissingTypeName;
+            const offset = try std.fmt.parseInt(usize, it.next() orelse return error.MissingOffset, 0);
+            const c = try s.getContext(path);
+            const structure = (try c.findStructure(.{ .name = name }, s.gpa)) orelse return error.TypeNotFound;
+
+            var member_path = std.ArrayList(u8).init(s.gpa);
+            defer member_path.deinit();
+            if (try c.writeMembersAtOffset(structure, writer, 0, offset, &member_path) == 0) {
+                return error.OffsetOutOfRange;
+            }
+        } else if (mem.eql(u8, command, "filter")) {
+            const path = it.next() orelse return error.MissingBinaryPath;
+            const substring = it.next() orelse return error.MissingFilter;
+            const c = try s.getContext(path);
+            _ = try c.writeContainers(payload, .{ .substring = substring }, s.gpa);
+        } else {
+            return error.UnknownCommand;
+        }
+
+        return .keep_running;
+    }
+
+    fn handleConnection(s: *Self, stream: net.Stream) !Status {
+        var br = std.io.bufferedReader(stream.reader());
+        const reader = br.reader();
+        var bw = std.io.bufferedWriter(stream.writer());
+        const writer = bw.writer();
+
+        var line_buffer: [4 * KiloByte]u8 = undefined;
+        var payload = std.ArrayList(u8).init(s.gpa);
+        defer payload.deinit();
+
+        while (try reader.readUntilDelimiterOrEof(&line_buffer, '\n')) |line| {
+            payload.clearRetainingCapacity();
+            const status = s.handleRequest(line, &payload) catch |err| {
+                try writer.print("error {s}\n", .{@errorName(err)});
+                try bw.flush();
+                continue;
+            };
+
+            try writer.print("ok {}\n", .{payload.items.len});
+            try writer.writeAll(payload.items);
+            try bw.flush();
+
+            if (status == .shutdown) {
+                return .shutdown;
+            }
+        }
+
+        return .keep_running;
+    }
+};
+
+pub fn run(args: [][:0]u8) !void {
+    var gpa_instance = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa_instance.deinit();
+    const gpa = gpa_instance.allocator();
+
+    var socket_path: ?[]const u8 = null;
+    var cache_size_mb: usize = 1024;
+    var i: usize = 0;
+    while (i < args.len) : (i += 1) {
+        if (mem.eql(u8, args[i], "--socket") and i + 1 < args.len) {
+            i += 1;
+            socket_path = args[i];
+        } else if (mem.eql(u8, args[i], "--cache-size") and i + 1 < args.len) {
+            i += 1;
+            cache_size_mb = try std.fmt.parseInt(usize, args[i], 10);
+        } else {
+            std.log.err("unknown serve argument {s}", .{args[i]});
+            return error.InvalidArgument;
+        }
+    }
+
+    const path = socket_path orelse {
+        std.log.err("serve requires --socket <path>", .{});
+        return error.InvalidArgument;
+    };
+
+    var s = Server{ .gpa = gpa, .memory_limit = cache_size_mb * MegaByte };
+    defer {
+        while (s.entries.items.len > 0) {
+            s.removeEntry(s.entries.items.len - 1);
+        }
+        s.entries.deinit(gpa);
+    }
+
+    fs.cwd().deleteFile(path) catch |err| switch (err) {
+        error.FileNotFound => {},
+        else => return err,
+    };
+    defer fs.cwd().deleteFile(path) catch {};
+
+    const address = try net.Address.initUnix(path);
+    var server = net.StreamServer.init(.{});
+    defer server.deinit();
+    try server.listen(address);
+    std.log.info("listening on {s}", .{path});
+
+    while (true) {
+        const connection = try server.accept();
+        defer connection.stream.close();
+
+        const status = s.handleConnection(connection.stream) catch |err| {
+            std.log.warn("connection dropped: {s}", .{@errorName(err)});
+            continue;
+        };
+        if (status == .shutdown) {
+            break;
+        }
+    }
+}
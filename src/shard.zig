@@ -0,0 +1,249 @@
+const std = @import("std");
+const main = @import("main.zig");
+const elf = @import("elf.zig");
+const Buffer = main.Buffer;
+
+const fs = std.fs;
+const mem = std.mem;
+
+// --shard i/n parses only the CUs assigned to shard i and writes what it would
+// have printed, per CU, into a partial result file. `dis merge` puts the CUs
+// of all the shards back into CU order, which is exactly the order a single
+// process prints them in, since nothing printed depends on other CUs.
+//
+// Partial result format, text header then one record per CU with output:
+//   dis-shard 1
+//   shard <i> <n>
+//   input <cu count> <file size> <build id hex or ->
+//   cu <index> <length>\n<length bytes of output>
+
+const format_magic = "dis-shard 1";
+
+pub const Error = error{
+    InvalidShardSpec,
+    MalformedShard,
+    MismatchedShards,
+    MissingShard,
+};
+
+pub const Spec = struct {
+    // 1 based, as written on the command line
+    index: u32,
+    count: u32,
+};
+
+pub fn parseSpec(text: []const u8) !Spec {
+    const slash = mem.indexOfScalar(u8, text, '/') orelse return Error.InvalidShardSpec;
+    const index = std.fmt.parseInt(u32, text[0..slash], 10) catch return Error.InvalidShardSpec;
+    const count = std.fmt.parseInt(u32, text[slash + 1 ..], 10) catch return Error.InvalidShardSpec;
+    if (count == 0 or index == 0 or index > count) {
+        return Error.InvalidShardSpec;
+    }
+    return Spec{ .index = index, .count = count };
+}
+
+fn biggerCuFirst(sizes: []const u64, a: usize, b: usize) bool {
+    if (sizes[a] == sizes[b]) {
+        return a < b;
+    }
+    return sizes[a] > sizes[b];
+}
+
+// Biggest CU first to the least loaded shard, ties going to the lower index,
+// so every shard comes up with the same assignment on its own.
+pub fn assignCus(sizes: []const u64, shard_count: u32, allocator: mem.Allocator) ![]u32 {
+    var order = try allocator.alloc(usize, sizes.len);
+    defer allocator.free(order);
+    for (order) |*index, i| {
+        index.* = i;
+    }
+    std.sort.sort(usize, order, sizes, biggerCuFirst);
+
+    var loads = try allocator.alloc(u64, shard_count);
+    defer allocator.free(loads);
+    mem.set(u64, loads, 0);
+
+    var assignment = try allocator.alloc(u32, sizes.len);
+    for (order) |cu_index| {
+        var least_loaded: u32 = 0;
+        for (loads) |load, shard| {
+            if (load < loads[least_loaded]) {
+                least_loaded = @intCast(u32, shard);
+            }
+        }
+        assignment[cu_index] = least_loaded;
+        loads[least_loaded] += sizes[cu_index];
+    }
+    return assignment;
+}
+
+fn writeRecord(writer: anytype, cu_index: u32, text: []const u8) !void {
+    if (text.len == 0) {
+        return;
+    }
+    try writer.print("cu {} {}\n", .{ cu_index, text.len });
+    try writer.writeAll(text);
+}
+
+pub fn run(file: fs.File, path: []const u8, spec: Spec, out_path_opt: ?[]const u8, arena: mem.Allocator) !void {
+    const data = try file.readToEndAlloc(arena, std.math.maxInt(usize));
+    var buffer = Buffer{ .data = data };
+    const build_id = elf.getBuildId(&buffer);
+
+    var c = try main.contextFromDwarf(data, null, arena);
+    const cus = c.dwarf.cus.items;
+    var sizes = try arena.alloc(u64, cus.len);
+    for (cus) |cu, i| {
+        sizes[i] = cu.size + cu.payload_size;
+    }
+    const assignment = try assignCus(sizes, spec.count, arena);
+    var selected = try arena.alloc(bool, cus.len);
+    for (assignment) |shard, i| {
+        selected[i] = shard == spec.index - 1;
+    }
+
+    var timer = try std.time.Timer.start();
+    try c.parseSelected(selected);
+    c.sortNamespaces();
+
+    const out_path = out_path_opt orelse try std.fmt.allocPrint(arena, "{s}.shard-{}-of-{}", .{ fs.path.basename(path), spec.index, spec.count });
+    const out_file = try fs.cwd().createFile(out_path, .{});
+    defer out_file.close();
+    var bw = std.io.bufferedWriter(out_file.writer());
+    const writer = bw.writer();
+
+    try writer.print("{s}\nshard {} {}\n", .{ format_magic, spec.index, spec.count });
+    try writer.print("input {} {} ", .{ cus.len, data.len });
+    if (build_id.len > 0) {
+        try writer.print("{s}\n", .{std.fmt.fmtSliceHexLower(build_id)});
+    } else {
+        try writer.writeAll("-\n");
+    }
+
+    var text = std.ArrayList(u8).init(arena);
+    var parsed_index: usize = 0;
+    var current_cu: u32 = 0;
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        const sid = it.sid - 1;
+        while (parsed_index + 1 < c.parsed_cus.items.len and c.parsed_cus.items[parsed_index + 1].first_structure <= sid) {
+            parsed_index += 1;
+        }
+
+        const cu_index = c.parsed_cus.items[parsed_index].cu_index;
+        if (cu_index != current_cu) {
+            try writeRecord(writer, current_cu, text.items);
+            text.clearRetainingCapacity();
+            current_cu = cu_index;
+        }
+        try c.printStruct(s, &text, it.activeNamespaces());
+    }
+    try writeRecord(writer, current_cu, text.items);
+    try bw.flush();
+
+    std.debug.print("Shard {}/{}: {} of {} CUs in {}, written to {s}\n", .{
+        spec.index,
+        spec.count,
+        mem.count(bool, selected, &[_]bool{true}),
+        cus.len,
+        std.fmt.fmtDuration(timer.read()),
+        out_path,
+    });
+}
+
+const Record = struct {
+    cu_index: u32,
+    text: []const u8,
+};
+
+fn recordLessThan(context: void, a: Record, b: Record) bool {
+    _ = context;
+    return a.cu_index < b.cu_index;
+}
+
+fn nextLine(data: []const u8, pos: *usize) ![]const u8 {
+    const end = mem.indexOfScalarPos(u8, data, pos.*, '\n') orelse return Error.MalformedShard;
+    const line = data[pos.*..end];
+    pos.* = end + 1;
+    return line;
+}
+
+fn expectLine(data: []const u8, pos: *usize, prefix: []const u8) !mem.TokenIterator(u8) {
+    const line = try nextLine(data, pos);
+    if (!mem.startsWith(u8, line, prefix)) {
+        return Error.MalformedShard;
+    }
+    return mem.tokenize(u8, line[prefix.len..], " ");
+}
+
+// Out of range for T is as malformed as not being a number
+fn parseField(comptime T: type, it: *mem.TokenIterator(u8)) !T {
+    const field = it.next() orelse return Error.MalformedShard;
+    return std.fmt.parseInt(T, field, 10) catch Error.MalformedShard;
+}
+
+pub fn merge(paths: []const []const u8, arena: mem.Allocator) !void {
+    var records = std.ArrayList(Record).init(arena);
+    var input_line: ?[]const u8 = null;
+    var shards_seen: []bool = &[_]bool{};
+
+    for (paths) |path| {
+        const data = try fs.cwd().readFileAlloc(arena, path, std.math.maxInt(usize));
+        var pos: usize = 0;
+        if (!mem.eql(u8, try nextLine(data, &pos), format_magic)) {
+            std.log.warn("{s}: not a shard file", .{path});
+            return Error.MalformedShard;
+        }
+
+        var shard_fields = try expectLine(data, &pos, "shard ");
+        const index = try parseField(u32, &shard_fields);
+        const count = try parseField(u32, &shard_fields);
+        if (shards_seen.len == 0) {
+            shards_seen = try arena.alloc(bool, count);
+            mem.set(bool, shards_seen, false);
+        }
+        if (count != shards_seen.len or index == 0 or index > count or shards_seen[index - 1]) {
+            std.log.warn("{s}: shard {}/{} doesn't fit with the others", .{ path, index, count });
+            return Error.MismatchedShards;
+        }
+        shards_seen[index - 1] = true;
+
+        const line = try nextLine(data, &pos);
+        if (input_line) |expected| {
+            if (!mem.eql(u8, line, expected)) {
+                std.log.warn("{s}: made from a different input", .{path});
+                return Error.MismatchedShards;
+            }
+        } else {
+            input_line = line;
+        }
+
+        while (pos < data.len) {
+            var fields = try expectLine(data, &pos, "cu ");
+            const cu_index = try parseField(u32, &fields);
+            const len = try parseField(usize, &fields);
+            if (data.len - pos < len) {
+                return Error.MalformedShard;
+            }
+            try records.append(.{ .cu_index = cu_index, .text = data[pos .. pos + len] });
+            pos += len;
+        }
+    }
+
+    for (shards_seen) |seen, i| {
+        if (!seen) {
+            std.log.warn("shard {}/{} is missing", .{ i + 1, shards_seen.len });
+            return Error.MissingShard;
+        }
+    }
+
+    std.sort.sort(Record, records.items, {}, recordLessThan);
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.BufferedWriter(16 * 1024, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
+    for (records.items) |record| {
+        try bw.writer().writeAll(record.text);
+    }
+    try bw.flush();
+}
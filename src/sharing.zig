@@ -0,0 +1,352 @@
+const std = @import("std");
+const main = @import("main.zig");
+const profile = @import("profile.zig");
+const summary = @import("summary.zig");
+const Context = main.Context;
+const Structure = main.Structure;
+const Type = main.Type;
+
+const mem = std.mem;
+
+// --false-sharing, cache lines of a structure holding more than one atomic or
+// lock, or one of them next to a hot field. Each of those is written by its
+// own threads, every write takes the line away from the cores using the rest.
+// Lines are counted from the start of the structure as if it was line aligned.
+//
+// Plain fields are assumed to be read-mostly. Which of them are hot comes from
+// the --profile file if there is one, see profile.zig for the format.
+
+pub const Kind = enum {
+    plain,
+    atomic,
+    lock,
+};
+
+pub const Options = struct {
+    line_size: u64 = profile.default_line_size,
+    lock_types: []const []const u8 = &.{},
+    atomic_types: []const []const u8 = &.{},
+    profile_path: ?[]const u8 = null,
+};
+
+// NOTE(radomski): Member types only have their unqualified name, std::mutex
+// is `mutex` here. Templates match with any arguments.
+const builtin_lock_types = [_][]const u8{
+    "mutex",
+    "recursive_mutex",
+    "timed_mutex",
+    "recursive_timed_mutex",
+    "shared_mutex",
+    "shared_timed_mutex",
+    "pthread_mutex_t",
+    "pthread_rwlock_t",
+    "pthread_spinlock_t",
+    "spinlock_t",
+    "raw_spinlock_t",
+    "rwlock_t",
+};
+const builtin_atomic_types = [_][]const u8{
+    "atomic",
+    "__atomic_base",
+    "atomic_ref",
+    "atomic64_t",
+};
+// <stdatomic.h> typedefs, also in std:: from <atomic>, and the kernel's
+// atomic_t. Matched whole, atomic_stats is somebody's plain structure.
+const stdatomic_types = [_][]const u8{
+    "atomic_bool",
+    "atomic_char",
+    "atomic_schar",
+    "atomic_uchar",
+    "atomic_short",
+    "atomic_ushort",
+    "atomic_int",
+    "atomic_uint",
+    "atomic_long",
+    "atomic_ulong",
+    "atomic_llong",
+    "atomic_ullong",
+    "atomic_char8_t",
+    "atomic_char16_t",
+    "atomic_char32_t",
+    "atomic_wchar_t",
+    "atomic_int_least8_t",
+    "atomic_uint_least8_t",
+    "atomic_int_least16_t",
+    "atomic_uint_least16_t",
+    "atomic_int_least32_t",
+    "atomic_uint_least32_t",
+    "atomic_int_least64_t",
+    "atomic_uint_least64_t",
+    "atomic_int_fast8_t",
+    "atomic_uint_fast8_t",
+    "atomic_int_fast16_t",
+    "atomic_uint_fast16_t",
+    "atomic_int_fast32_t",
+    "atomic_uint_fast32_t",
+    "atomic_int_fast64_t",
+    "atomic_uint_fast64_t",
+    "atomic_intptr_t",
+    "atomic_uintptr_t",
+    "atomic_size_t",
+    "atomic_ptrdiff_t",
+    "atomic_intmax_t",
+    "atomic_uintmax_t",
+    "atomic_signed_lock_free",
+    "atomic_unsigned_lock_free",
+    "atomic_flag",
+    "atomic_t",
+    "atomic_long_t",
+};
+
+// A plain field is hot with at least this fraction of the hottest one's count
+const hot_divisor = 10;
+
+const Field = struct {
+    name: []const u8,
+    offset: u64,
+    element_size: u64,
+    // Elements of an array, each atomic or lock in one is written on its own
+    elements: u64,
+    is_array: bool,
+    kind: Kind,
+    count: u64,
+};
+
+fn matchesType(name: []const u8, patterns: []const []const u8) bool {
+    for (patterns) |pattern| {
+        if (mem.startsWith(u8, name, pattern) and (name.len == pattern.len or name[pattern.len] == '<')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+pub fn classify(t: Type, name: []const u8, options: Options) Kind {
+    if (t.ptr_count > 0) {
+        return .plain;
+    }
+    if (t.qualifiers.is_atomic or matchesType(name, &stdatomic_types) or
+        matchesType(name, &builtin_atomic_types) or matchesType(name, options.atomic_types))
+    {
+        return .atomic;
+    }
+    if (matchesType(name, &builtin_lock_types) or matchesType(name, options.lock_types)) {
+        return .lock;
+    }
+    return .plain;
+}
+
+fn fieldPath(prefix: []const u8, name: []const u8, arena: mem.Allocator) ![]const u8 {
+    const shown = if (name.len > 0) name else "<anonymous>";
+    if (prefix.len == 0) {
+        return shown;
+    }
+    return std.fmt.allocPrint(arena, "{s}.{s}", .{ prefix, shown });
+}
+
+const CollectError = mem.Allocator.Error;
+
+// Bases and anonymous structures are flattened and keep the profile counts of
+// the outer type, fields of a named structure member get the member's count.
+// Unions stay whole, their members share the storage anyway.
+fn collectFields(
+    c: *Context,
+    s: Structure,
+    base_offset: u64,
+    prefix: []const u8,
+    counts: ?*const profile.Counts,
+    outer_count: u64,
+    options: Options,
+    fields: *std.ArrayList(Field),
+    arena: mem.Allocator,
+) CollectError!void {
+    var member_id = s.member_range.start;
+    while (member_id < s.member_range.end) : (member_id += 1) {
+        const member = c.members.get(member_id);
+        if (member.kind == .virtual_base) {
+            continue;
+        }
+
+        const t = c.types.get(member.type_id);
+        const name = c.getName(member.name);
+        const offset = base_offset + member.mem_loc;
+        const count = if (counts) |member_counts| member_counts.get(name) orelse 0 else outer_count;
+        const kind = classify(t, c.getName(t.name), options);
+        const is_struct = t.ptr_count == 0 and !t.isArray() and t.struct_type != .none and t.struct_type != .union_type and t.struct_id != std.math.maxInt(main.StructId);
+        if (kind == .plain and is_struct) {
+            const inner = c.structures.get(t.struct_id);
+            if (member.kind == .base or t.name == 0) {
+                try collectFields(c, inner, offset, prefix, counts, outer_count, options, fields, arena);
+            } else {
+                try collectFields(c, inner, offset, try fieldPath(prefix, name, arena), null, count, options, fields, arena);
+            }
+            continue;
+        }
+
+        try fields.append(.{
+            .name = try fieldPath(prefix, name, arena),
+            .offset = offset,
+            .element_size = t.size,
+            .elements = if (t.isArray()) t.dimension else 1,
+            .is_array = t.isArray(),
+            .kind = kind,
+            .count = count,
+        });
+    }
+}
+
+const Overlap = struct {
+    first: u64,
+    last: u64,
+};
+
+// Elements of the field inside [start, end)
+fn overlap(field: Field, start: u64, end: u64) ?Overlap {
+    const size = field.element_size * field.elements;
+    if (size == 0 or field.offset >= end or field.offset + size <= start) {
+        return null;
+    }
+    const first = if (start > field.offset) (start - field.offset) / field.element_size else 0;
+    const last = @minimum(field.elements - 1, (end - 1 - field.offset) / field.element_size);
+    return Overlap{ .first = first, .last = last };
+}
+
+fn isHot(field: Field, max_count: u64) bool {
+    return field.kind == .plain and field.count > 0 and field.count * hot_divisor >= max_count;
+}
+
+fn printField(stdout: anytype, field: Field, range: Overlap) !void {
+    const label = switch (field.kind) {
+        .atomic => "atomic",
+        .lock => "lock",
+        .plain => "hot",
+    };
+    try stdout.print("{s} {s}", .{ label, field.name });
+    if (field.is_array and range.first == range.last) {
+        try stdout.print("[{}]", .{range.first});
+    } else if (field.is_array) {
+        try stdout.print("[{}..{}]", .{ range.first, range.last });
+    }
+    try stdout.print(" offset={} size={}", .{
+        field.offset + range.first * field.element_size,
+        (range.last - range.first + 1) * field.element_size,
+    });
+    if (field.kind == .plain) {
+        try stdout.print(" count={}", .{field.count});
+    }
+}
+
+pub fn run(c: *Context, options: Options, arena: mem.Allocator) !void {
+    var profile_data: ?profile.Profile = if (options.profile_path) |path| try profile.load(path, arena) else null;
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.bufferedWriter(stdout_file);
+    const stdout = bw.writer();
+
+    var fields = std.ArrayList(Field).init(arena);
+    var lines = std.AutoArrayHashMap(u64, void).init(arena);
+    var seen_members = std.AutoHashMap(u32, void).init(arena);
+    var structs_with_sync: u64 = 0;
+    var structs_reported: u64 = 0;
+    var lines_reported: u64 = 0;
+
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        const stype = c.types.get(s.type_id);
+        if (stype.struct_type == .union_type) {
+            continue;
+        }
+        // NOTE(radomski): Typedef copies share the members of the original
+        if (s.member_range.len() > 0) {
+            const gop = try seen_members.getOrPut(s.member_range.start);
+            if (gop.found_existing) {
+                continue;
+            }
+        }
+
+        const profiled = if (profile_data) |*p| profile.find(p, c.getName(stype.name), it.activeNamespaces()) else null;
+        fields.clearRetainingCapacity();
+        try collectFields(c, s, 0, "", if (profiled) |p| &p.counts else null, 0, options, &fields, arena);
+
+        var max_count: u64 = 0;
+        lines.clearRetainingCapacity();
+        for (fields.items) |field| {
+            if (field.kind == .plain) {
+                max_count = @maximum(max_count, field.count);
+                continue;
+            }
+            const size = field.element_size * field.elements;
+            if (size == 0) {
+                continue;
+            }
+            var line = field.offset / options.line_size;
+            while (line <= (field.offset + size - 1) / options.line_size) : (line += 1) {
+                try lines.put(line, {});
+            }
+        }
+        if (lines.count() == 0) {
+            continue;
+        }
+        structs_with_sync += 1;
+
+        var printed_header = false;
+        for (lines.keys()) |line| {
+            const start = line * options.line_size;
+            const end = start + options.line_size;
+            var writers: u64 = 0;
+            var hot: u64 = 0;
+            for (fields.items) |field| {
+                const range = overlap(field, start, end) orelse continue;
+                if (field.kind != .plain) {
+                    writers += range.last - range.first + 1;
+                } else if (isHot(field, max_count)) {
+                    hot += 1;
+                }
+            }
+            if (writers < 2 and (writers == 0 or hot == 0)) {
+                continue;
+            }
+
+            if (!printed_header) {
+                printed_header = true;
+                structs_reported += 1;
+                const prefix = switch (stype.struct_type) {
+                    .class_type => "class",
+                    else => "struct",
+                };
+                const name = if (stype.name != 0) c.getName(stype.name) else "<anonymous>";
+                try stdout.print("{s} {s} size={}\n", .{ prefix, try summary.qualifiedName(it.activeNamespaces(), name, arena), stype.size });
+            }
+            lines_reported += 1;
+            try stdout.print("  line {}:", .{line});
+            var separator: []const u8 = " ";
+            for (fields.items) |field| {
+                const range = overlap(field, start, end) orelse continue;
+                if (field.kind == .plain and !isHot(field, max_count)) {
+                    continue;
+                }
+                try stdout.writeAll(separator);
+                try printField(stdout, field, range);
+                separator = ", ";
+            }
+            try stdout.writeAll("\n");
+        }
+    }
+
+    if (profile_data) |p| {
+        for (p.types.values()) |profiled| {
+            if (!profiled.found) {
+                std.log.warn("no structure named {s}", .{profiled.name});
+            }
+        }
+    }
+
+    try stdout.print("{} shared lines in {} of {} structs with atomics or locks\n", .{
+        lines_reported,
+        structs_reported,
+        structs_with_sync,
+    });
+    try bw.flush();
+}
@@ -0,0 +1,133 @@
+const std = @import("std");
+const elf = @import("elf.zig");
+
+const mem = std.mem;
+const os = std.os;
+
+// Reading an ELF file from a pipe, `dis -`. Everything lands at its file offset
+// in a zero filled buffer as big as the file, pages never written to don't take
+// any memory.
+//
+// The section header table says which ranges are needed, but it usually comes
+// last. Until it's read the stream has to be kept. Once it is, the pages
+// holding nothing the parser needs are given back, and the rest of the stream
+// is only read where it's needed.
+//
+// NOTE(radomski): With the table at the end, which is what linkers write, the
+// peak is the whole file like reading a regular one. Only the memory held
+// while parsing goes down. The saving on the way in is for files with the
+// table early.
+
+pub const Stats = struct {
+    streamed: u64 = 0,
+    kept: u64 = 0,
+};
+
+const max_ranges = 32;
+const RangeList = std.BoundedArray(elf.FileRange, max_ranges);
+
+fn rangeLessThan(context: void, a: elf.FileRange, b: elf.FileRange) bool {
+    _ = context;
+    return a.offset < b.offset;
+}
+
+fn releaseGap(data: []align(mem.page_size) u8, start: u64, end: u64) void {
+    const page_start = mem.alignForward(start, mem.page_size);
+    const page_end = mem.alignBackward(end, mem.page_size);
+    if (page_start >= page_end) {
+        return;
+    }
+    const ptr = @alignCast(mem.page_size, data.ptr + page_start);
+    os.madvise(ptr, page_end - page_start, os.MADV.DONTNEED) catch {};
+}
+
+// Gives back the whole pages of [0, end) that don't overlap any of the ranges,
+// which are sorted by offset.
+fn releaseUnneeded(data: []align(mem.page_size) u8, end: u64, ranges: []const elf.FileRange) void {
+    var gap_start: u64 = 0;
+    for (ranges) |range| {
+        releaseGap(data, gap_start, @minimum(range.offset, end));
+        gap_start = @maximum(gap_start, range.offset + range.size);
+    }
+    releaseGap(data, gap_start, end);
+}
+
+fn skip(reader: anytype, n: u64) !void {
+    var scratch: [64 * 1024]u8 = undefined;
+    var left = n;
+    while (left > 0) {
+        const len = @minimum(left, scratch.len);
+        try reader.readNoEof(scratch[0..len]);
+        left -= len;
+    }
+}
+
+pub fn readElf(reader: anytype, stats: *Stats) ![]u8 {
+    const allocator = std.heap.page_allocator;
+
+    var header: [elf.elf_header_size]u8 = undefined;
+    try reader.readNoEof(&header);
+    const table = try elf.sectionHeaderTableExtent(&header);
+    const table_end = table.offset + table.size;
+    if (table.offset < header.len) {
+        return elf.Error.MalformedHeader;
+    }
+
+    // Everything up to the end of the section header table
+    var data = try allocator.alignedAlloc(u8, mem.page_size, table_end);
+    errdefer allocator.free(data);
+    mem.copy(u8, data, &header);
+    try reader.readNoEof(data[header.len..]);
+    var pos: u64 = table_end;
+
+    // NOTE(radomski): Sections after the section header table, the table is
+    // early and the buffer has to grow. Only what was read so far is copied.
+    const end = try elf.sectionsEnd(data);
+    if (end > data.len) {
+        const grown = try allocator.alignedAlloc(u8, mem.page_size, end);
+        mem.copy(u8, grown, data);
+        allocator.free(data);
+        data = grown;
+    }
+
+    const names = try elf.sectionNamesRange(data);
+    if (names.offset + names.size > pos) {
+        try skip(reader, names.offset -| pos);
+        const start = @maximum(names.offset, pos);
+        try reader.readNoEof(data[start .. names.offset + names.size]);
+        pos = names.offset + names.size;
+    }
+
+    var ranges = try RangeList.init(0);
+    try elf.debugSectionRanges(data, &ranges);
+    try ranges.append(names);
+    try ranges.append(table);
+    try ranges.append(.{ .offset = 0, .size = header.len });
+    std.sort.sort(elf.FileRange, ranges.slice(), {}, rangeLessThan);
+    releaseUnneeded(data, pos, ranges.slice());
+
+    for (ranges.slice()) |range| {
+        stats.kept += range.size;
+        const range_end = range.offset + range.size;
+        if (range_end <= pos) {
+            continue;
+        }
+        const start = @maximum(range.offset, pos);
+        try skip(reader, start - pos);
+        try reader.readNoEof(data[start..range_end]);
+        pos = range_end;
+    }
+
+    // Drain the rest so the writer doesn't get a broken pipe
+    var scratch: [64 * 1024]u8 = undefined;
+    while (true) {
+        const read = try reader.read(&scratch);
+        if (read == 0) {
+            break;
+        }
+        pos += read;
+    }
+
+    stats.streamed = pos;
+    return data;
+}
@@ -0,0 +1,252 @@
+const std = @import("std");
+const main = @import("main.zig");
+const Context = main.Context;
+const NameId = main.NameId;
+const StructRange = main.StructRange;
+
+const mem = std.mem;
+
+// --summary, whole binary totals in one pass over the parsed structures
+// instead of printing every one of them. Holes are the same ones the printer
+// shows, grouped by namespace and by the directory of DW_AT_decl_file.
+
+const cache_line_size = 64;
+
+pub const size_bucket_labels = [_][]const u8{ "<=8", "9-16", "17-32", "33-64", "65-128", "129-256", "257-512", ">512" };
+const line_bucket_labels = [_][]const u8{ "1", "2", "3-4", "5-8", "9-16", ">16" };
+
+const Group = struct {
+    structs: u64 = 0,
+    with_holes: u64 = 0,
+    size: u64 = 0,
+    waste_bits: u64 = 0,
+};
+
+const NamedGroup = struct {
+    name: []const u8,
+    group: Group,
+};
+
+const TopEntry = struct {
+    name: []const u8,
+    size: u32,
+    waste_bits: u64,
+    holes: usize,
+};
+
+// Index into size_bucket_labels, --sample estimates the same buckets
+pub fn sizeBucket(size: u32) usize {
+    if (size <= 8) {
+        return 0;
+    }
+    return @minimum(size_bucket_labels.len - 1, std.math.log2_int_ceil(u32, size) - 3);
+}
+
+fn lineBucket(size: u32) usize {
+    const lines = (size + cache_line_size - 1) / cache_line_size;
+    if (lines <= 1) {
+        return 0;
+    }
+    return @minimum(line_bucket_labels.len - 1, std.math.log2_int_ceil(u32, lines));
+}
+
+fn groupGreaterThan(context: void, a: NamedGroup, b: NamedGroup) bool {
+    _ = context;
+    if (a.group.waste_bits != b.group.waste_bits) {
+        return a.group.waste_bits > b.group.waste_bits;
+    }
+    return mem.lessThan(u8, a.name, b.name);
+}
+
+pub fn qualifiedName(namespaces: []const main.Namespace, name: []const u8, arena: mem.Allocator) ![]const u8 {
+    var out = std.ArrayList(u8).init(arena);
+    for (namespaces) |ns| {
+        try out.appendSlice(ns.name);
+        try out.appendSlice("::");
+    }
+    try out.appendSlice(name);
+    return out.items;
+}
+
+fn sameRange(a: ?StructRange, b: ?StructRange) bool {
+    if (a == null or b == null) {
+        return a == null and b == null;
+    }
+    return a.?.start == b.?.start and a.?.end == b.?.end;
+}
+
+fn sortedGroups(groups: anytype, arena: mem.Allocator) ![]NamedGroup {
+    var out = try arena.alloc(NamedGroup, groups.count());
+    var it = groups.iterator();
+    var i: usize = 0;
+    while (it.next()) |entry| : (i += 1) {
+        out[i] = .{ .name = entry.key_ptr.*, .group = entry.value_ptr.* };
+    }
+    std.sort.sort(NamedGroup, out, {}, groupGreaterThan);
+    return out;
+}
+
+pub fn run(c: *Context, top_n: usize, arena: mem.Allocator) !void {
+    var totals = Group{};
+    var hole_count: u64 = 0;
+    var size_buckets = [_]u64{0} ** size_bucket_labels.len;
+    var line_buckets = [_]u64{0} ** line_bucket_labels.len;
+    var top = try std.ArrayList(TopEntry).initCapacity(arena, top_n + 1);
+    var by_namespace = std.StringHashMap(Group).init(arena);
+    var by_dir = std.AutoHashMap(NameId, Group).init(arena);
+
+    // NOTE(radomski): A typedef of a named struct is a second structure with
+    // the same members, only the first one is counted
+    var seen_members = std.AutoHashMap(u32, void).init(arena);
+
+    // Qualified namespace of the previous structure, namespaces only change
+    // at the edges of their struct ranges
+    var namespace_key: []const u8 = "(global)";
+    var namespace_range: ?StructRange = null;
+
+    var holes = std.ArrayList(Context.Hole).init(arena);
+    var it = try c.containerIterator(.all);
+    defer it.deinit();
+    while (try it.next()) |s| {
+        if (s.member_range.len() > 0) {
+            const gop = try seen_members.getOrPut(s.member_range.start);
+            if (gop.found_existing) {
+                continue;
+            }
+        }
+
+        const stype = c.types.get(s.type_id);
+        holes.clearRetainingCapacity();
+        try c.collectHoles(s, 0, &holes);
+        var waste_bits: u64 = 0;
+        for (holes.items) |hole| {
+            waste_bits += hole.size_bits;
+        }
+
+        const group = Group{
+            .structs = 1,
+            .with_holes = @boolToInt(holes.items.len > 0),
+            .size = stype.size,
+            .waste_bits = waste_bits,
+        };
+        addGroup(&totals, group);
+        hole_count += holes.items.len;
+        size_buckets[sizeBucket(stype.size)] += 1;
+        line_buckets[lineBucket(stype.size)] += 1;
+
+        const namespaces = it.activeNamespaces();
+        const range_opt: ?StructRange = if (namespaces.len > 0) namespaces[namespaces.len - 1].struct_range else null;
+        if (!sameRange(range_opt, namespace_range)) {
+            namespace_range = range_opt;
+            namespace_key = if (namespaces.len > 0)
+                try qualifiedName(namespaces[0 .. namespaces.len - 1], namespaces[namespaces.len - 1].name, arena)
+            else
+                "(global)";
+        }
+        const ns_gop = try by_namespace.getOrPut(namespace_key);
+        if (!ns_gop.found_existing) {
+            ns_gop.value_ptr.* = .{};
+        }
+        addGroup(ns_gop.value_ptr, group);
+
+        const dir_gop = try by_dir.getOrPut(c.struct_decl_dirs.get(s.type_id) orelse 0);
+        if (!dir_gop.found_existing) {
+            dir_gop.value_ptr.* = .{};
+        }
+        addGroup(dir_gop.value_ptr, group);
+
+        // Bounded and kept sorted, names are only built for the ones that
+        // make it in
+        if (top_n > 0 and waste_bits > 0) {
+            var index = top.items.len;
+            while (index > 0 and top.items[index - 1].waste_bits < waste_bits) : (index -= 1) {}
+            if (index < top_n) {
+                try top.insert(index, .{
+                    .name = try qualifiedName(namespaces, c.getName(stype.name), arena),
+                    .size = stype.size,
+                    .waste_bits = waste_bits,
+                    .holes = holes.items.len,
+                });
+                if (top.items.len > top_n) {
+                    _ = top.pop();
+                }
+            }
+        }
+    }
+
+    var dirs = std.StringHashMap(Group).init(arena);
+    var dir_it = by_dir.iterator();
+    while (dir_it.next()) |entry| {
+        const name = if (entry.key_ptr.* == 0) "<unknown>" else c.getName(entry.key_ptr.*);
+        try dirs.put(name, entry.value_ptr.*);
+    }
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.bufferedWriter(stdout_file);
+    const stdout = bw.writer();
+
+    try stdout.print("structs={} with_holes={} holes={} size={} waste={} bytes and {} bits\n", .{
+        totals.structs,
+        totals.with_holes,
+        hole_count,
+        totals.size,
+        totals.waste_bits / 8,
+        totals.waste_bits % 8,
+    });
+    try stdout.print("average waste={d:.2} bytes per struct, {d:.2} per struct with holes\n", .{
+        average(totals.waste_bits, totals.structs),
+        average(totals.waste_bits, totals.with_holes),
+    });
+
+    try stdout.writeAll("Sizes in bytes:\n");
+    for (size_bucket_labels) |label, i| {
+        try stdout.print("  {s:<8} {}\n", .{ label, size_buckets[i] });
+    }
+    try stdout.print("Cache lines of {} bytes:\n", .{cache_line_size});
+    for (line_bucket_labels) |label, i| {
+        try stdout.print("  {s:<8} {}\n", .{ label, line_buckets[i] });
+    }
+
+    try stdout.print("Top {} by waste:\n", .{top.items.len});
+    for (top.items) |entry| {
+        try stdout.print("  {s} size={} waste={} bytes and {} bits in {} holes\n", .{
+            entry.name,
+            entry.size,
+            entry.waste_bits / 8,
+            entry.waste_bits % 8,
+            entry.holes,
+        });
+    }
+
+    try stdout.writeAll("By namespace:\n");
+    try printGroups(stdout, try sortedGroups(by_namespace, arena));
+    try stdout.writeAll("By directory:\n");
+    try printGroups(stdout, try sortedGroups(dirs, arena));
+    try bw.flush();
+}
+
+fn addGroup(to: *Group, from: Group) void {
+    to.structs += from.structs;
+    to.with_holes += from.with_holes;
+    to.size += from.size;
+    to.waste_bits += from.waste_bits;
+}
+
+fn average(bits: u64, count: u64) f64 {
+    if (count == 0) {
+        return 0;
+    }
+    return @intToFloat(f64, bits) / 8 / @intToFloat(f64, count);
+}
+
+fn printGroups(stdout: anytype, groups: []const NamedGroup) !void {
+    for (groups) |entry| {
+        try stdout.print("  {s} structs={} with_holes={} waste={} bytes and {} bits\n", .{
+            entry.name,
+            entry.group.structs,
+            entry.group.with_holes,
+            entry.group.waste_bits / 8,
+            entry.group.waste_bits % 8,
+        });
+    }
+}
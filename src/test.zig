@@ -2,6 +2,8 @@ const std = @import("std");
 const builtin = @import("builtin");
 const assert = std.debug.assert;
 const fs = std.fs;
+const mem = std.mem;
+const lib = @import("lib.zig");
 
 const KiloByte = 1024;
 const MegaByte = 1024 * KiloByte;
@@ -26,11 +28,819 @@ test {
         const gcc_dir_path = try fs.path.join(arena, &.{ fs.path.dirname(@src().file).?, "..", "tests", "gcc" });
         try ctx.addTestsFromDir(common_dir_path, &gcc_compiler_args);
         try ctx.addTestsFromDir(gcc_dir_path, &gcc_compiler_args);
+
+        // NOTE(radomski): Objects for other machines exercise the relocation
+        // table, only files whose layout doesn't depend on pointer or long size.
+        const cross_targets = [_][]const u8{ "aarch64-linux-gnu", "riscv64-linux-gnu", "i386-linux-gnu", "arm-linux-gnueabihf" };
+        const cross_files = [_][]const u8{ "bitfields.c", "enum.c", "struct.c", "typedef_and_inlining.c", "union.c" };
+        for (cross_targets) |target| {
+            try ctx.addCrossTargetTests(common_dir_path, &cross_files, &zig_cc_compiler_args, target);
+        }
+
+        // NOTE(radomski): Objects for BPF carry a .BTF section next to DWARF,
+        // which is what gets read then.
+        const btf_files = [_][]const u8{ "bitfields.c", "struct.c" };
+        try ctx.addCrossTargetTests(common_dir_path, &btf_files, &zig_cc_compiler_args, "bpfel-freestanding");
     }
 
     try ctx.run();
 }
 
+// Modules with unit tests of their own
+test {
+    _ = @import("perf.zig");
+    _ = @import("elf.zig");
+}
+
+test "perf counters" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    // NOTE(radomski): Counters go to stderr, with hardware events, software
+    // ones or none at all the output stays the same wherever the flag goes
+    const object_path = try scratch.compile(try scratch.corpusPath("struct.c"), "struct.o");
+    const expected = try scratch.dis(&.{object_path});
+    try std.testing.expectEqualStrings(expected, try scratch.dis(&.{ object_path, "--perf-counters" }));
+    try std.testing.expectEqualStrings(expected, try scratch.dis(&.{ "--perf-counters", object_path }));
+}
+
+test "lib" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const object_path = try scratch.compile(try scratch.corpusPath("struct.c"), "struct.o");
+    const file = try fs.cwd().openFile(object_path, .{});
+    defer file.close();
+    const b = try lib.Binary.openFd(std.testing.allocator, file.handle);
+    defer b.close();
+
+    var structures = b.structures();
+    const s = structures.next().?;
+    try std.testing.expectEqualStrings("s", s.name);
+    try std.testing.expectEqual(@as(u32, 8), s.size);
+    try std.testing.expectEqual(lib.StructKind.struct_type, s.kind);
+    try std.testing.expectEqual(@as(u32, 2), s.member_count);
+    try std.testing.expect(structures.next() == null);
+    try std.testing.expectEqual(s.id, (try b.findStructure("s")).?.id);
+    try std.testing.expect((try b.findStructure("nothing")) == null);
+
+    var members = b.members(s.id);
+    for ([_][]const u8{ "field1", "field2" }) |name, i| {
+        const member = members.next().?;
+        try std.testing.expectEqualStrings(name, member.name);
+        try std.testing.expectEqual(@intCast(u32, i * 4), member.offset);
+        try std.testing.expectEqualStrings("int", member.type_name);
+        try std.testing.expectEqual(@as(u32, 4), member.type_size);
+        try std.testing.expectEqual(@as(?u32, null), member.dimension);
+        try std.testing.expectEqual(@as(?lib.StructId, null), member.struct_id);
+        try std.testing.expectEqual(lib.MemberKind.field, member.kind);
+    }
+    try std.testing.expect(members.next() == null);
+}
+
+test "c api" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const object_path = try scratch.compile(try scratch.corpusPath("struct.c"), "struct.o");
+    const source_path = try scratch.writeFile("consumer.c",
+        \\#include <dis.h>
+        \\#include <fcntl.h>
+        \\#include <stdio.h>
+        \\
+        \\int main(int argc, char **argv) {
+        \\    dis_binary *binary = dis_open_fd(open(argv[1], O_RDONLY));
+        \\    dis_structure s;
+        \\    if (!binary || !dis_find_structure(binary, "s", 1, &s)) {
+        \\        return 1;
+        \\    }
+        \\    printf("%.*s size=%u\n", (int)s.name.len, s.name.ptr, s.size);
+        \\    dis_iterator it = dis_members_begin(binary, s.id);
+        \\    dis_member m;
+        \\    while (dis_members_next(binary, &it, &m)) {
+        \\        printf("  %.*s %.*s offset=%u size=%u\n", (int)m.type_name.len, m.type_name.ptr,
+        \\               (int)m.name.len, m.name.ptr, m.offset, m.type_size);
+        \\    }
+        \\    dis_close(binary);
+        \\    return 0;
+        \\}
+        \\
+    );
+
+    // NOTE(radomski): Against what zig build installed, like a C user would
+    const consumer_path = try scratch.path("consumer");
+    _ = try scratch.ctx.expectSuccess(&.{ scratch.zig_exe_path, "cc", "-o", consumer_path, source_path, "-Izig-out/include", "zig-out/lib/libdis.a", "-lpthread" });
+    try std.testing.expectEqualStrings(
+        \\s size=8
+        \\  int field1 offset=0 size=4
+        \\  int field2 offset=4 size=4
+        \\
+    , try scratch.ctx.expectSuccess(&.{ consumer_path, object_path }));
+}
+
+test "serve" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    const source_path = try scratch.corpusPath("struct.c");
+    const object_path = try scratch.compile(source_path, "struct.o");
+    const socket_path = try scratch.path("dis.sock");
+    const source = try std.fs.cwd().readFileAlloc(arena, source_path, 10 * MegaByte);
+    const expected_output = try scratch.ctx.getExpectedTestOutput(source);
+
+    var server = std.ChildProcess.init(&.{ "./zig-out/bin/dis", "serve", "--socket", socket_path }, arena);
+    try server.spawn();
+
+    const stream = blk: {
+        var attempt: u32 = 0;
+        while (true) : (attempt += 1) {
+            break :blk std.net.connectUnixSocket(socket_path) catch |err| {
+                if (attempt > 200) {
+                    return err;
+                }
+                std.time.sleep(10 * std.time.ns_per_ms);
+                continue;
+            };
+        }
+    };
+    defer stream.close();
+
+    const Query = struct {
+        request: []const u8,
+        response: []const u8,
+    };
+    const queries = [_]Query{
+        .{ .request = try std.fmt.allocPrint(arena, "type {s} s\n", .{object_path}), .response = expected_output },
+        .{ .request = try std.fmt.allocPrint(arena, "type {s} s\n", .{object_path}), .response = expected_output },
+        .{ .request = try std.fmt.allocPrint(arena, "offset {s} s 5\n", .{object_path}), .response = "field2 // size=4, offset=4\n" },
+        .{ .request = try std.fmt.allocPrint(arena, "filter {s} nothing_matches\n", .{object_path}), .response = "" },
+        .{ .request = "shutdown\n", .response = "" },
+    };
+
+    const reader = stream.reader();
+    for (queries) |query| {
+        try stream.writer().writeAll(query.request);
+
+        const status = try reader.readUntilDelimiterAlloc(arena, '\n', KiloByte);
+        try std.testing.expect(std.mem.startsWith(u8, status, "ok "));
+        const payload_len = try std.fmt.parseInt(usize, status[3..], 10);
+        const payload = try arena.alloc(u8, payload_len);
+        try reader.readNoEof(payload);
+        try std.testing.expectEqualStrings(query.response, payload);
+    }
+
+    const term = try server.wait();
+    try std.testing.expectEqual(term.Exited, 0);
+}
+
+test "watch" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    try scratch.tmp.dir.makeDir("objs");
+    const objs_path = try scratch.path("objs");
+    const a_path = try scratch.path("objs/a.o");
+    const b_path = try scratch.path("objs/b.o");
+    _ = try scratch.compile(try scratch.writeFile("a.c", "struct a { char c; long l; } a;\n"), "objs/a.o");
+    _ = try scratch.compile(try scratch.writeFile("b.c", "struct b { char c; int i; } b;\n"), "objs/b.o");
+
+    var watcher = std.ChildProcess.init(&.{ "./zig-out/bin/dis", "watch", objs_path, "--top", "2" }, arena);
+    watcher.stdout_behavior = .Pipe;
+    try watcher.spawn();
+    defer _ = watcher.kill() catch {};
+    const reader = watcher.stdout.?.reader();
+
+    const initial = [_][]const u8{
+        "objects=2 structs=2 waste=10 bytes and 0 bits",
+        try std.fmt.allocPrint(arena, "  HOLE => 7 bytes in a at offset=1:0 ({s})", .{a_path}),
+        try std.fmt.allocPrint(arena, "  HOLE => 3 bytes in b at offset=1:0 ({s})", .{b_path}),
+    };
+    for (initial) |expected| {
+        try std.testing.expectEqualStrings(expected, try reader.readUntilDelimiterAlloc(arena, '\n', KiloByte));
+    }
+
+    // NOTE(radomski): Built outside and renamed in, one event for the whole
+    // new object. Both holes of the new b now beat the one of a.
+    const new_b_path = try scratch.compile(try scratch.writeFile("b2.c",
+        \\struct b { char c; _Alignas(16) char d; char e[20]; } b;
+        \\
+    ), "b2.o");
+    try fs.renameAbsolute(new_b_path, b_path);
+
+    const updated = [_][]const u8{
+        "objects=2 structs=2 waste=33 bytes and 0 bits",
+        try std.fmt.allocPrint(arena, "  HOLE => 15 bytes in b at offset=1:0 ({s})", .{b_path}),
+        try std.fmt.allocPrint(arena, "  HOLE => 11 bytes in b at offset=37:0 ({s})", .{b_path}),
+    };
+    for (updated) |expected| {
+        try std.testing.expectEqualStrings(expected, try reader.readUntilDelimiterAlloc(arena, '\n', KiloByte));
+    }
+}
+
+test "archive" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): Member names past 15 characters go to the GNU "//"
+    // table, BSD stores them as #1/len in front of the data
+    var object_paths = std.ArrayList([]const u8).init(arena);
+    for ([_][]const u8{ "struct.c", "union.c", "bitfields.c" }) |name| {
+        const object_name = try std.fmt.allocPrint(arena, "a_member_with_a_long_name_{s}.o", .{name});
+        try object_paths.append(try scratch.compile(try scratch.corpusPath(name), object_name));
+    }
+    const expected = try scratch.dis(object_paths.items);
+
+    const Flavour = struct {
+        name: []const u8,
+        ar_args: []const []const u8,
+    };
+    const flavours = [_]Flavour{
+        .{ .name = "gnu.a", .ar_args = &.{ "--format=gnu", "rcs" } },
+        .{ .name = "bsd.a", .ar_args = &.{ "--format=bsd", "rcs" } },
+        .{ .name = "thin.a", .ar_args = &.{ "--format=gnu", "rcsT" } },
+    };
+    for (flavours) |flavour| {
+        const archive_path = try scratch.path(flavour.name);
+        var ar_args = std.ArrayList([]const u8).init(arena);
+        try ar_args.appendSlice(&.{ scratch.zig_exe_path, "ar" });
+        try ar_args.appendSlice(flavour.ar_args);
+        try ar_args.append(archive_path);
+        try ar_args.appendSlice(object_paths.items);
+        _ = try scratch.ctx.expectSuccess(ar_args.items);
+
+        try std.testing.expectEqualStrings(expected, try scratch.dis(&.{archive_path}));
+    }
+
+    // NOTE(radomski): Files given by path and thin archive members are read by
+    // the prefetcher, io_uring where it works. The pread fallback is forced.
+    var env_map = try std.process.getEnvMap(arena);
+    try env_map.put("DIS_PREFETCH", "pread");
+    var pread_argv = std.ArrayList([]const u8).init(arena);
+    try pread_argv.append("./zig-out/bin/dis");
+    try pread_argv.appendSlice(object_paths.items);
+    const thin_argv = [_][]const u8{ "./zig-out/bin/dis", try scratch.path("thin.a") };
+    for ([_][]const []const u8{ pread_argv.items, &thin_argv }) |argv| {
+        const result = try std.ChildProcess.exec(.{ .allocator = arena, .argv = argv, .env_map = &env_map, .max_output_bytes = 10 * MegaByte });
+        try std.testing.expectEqual(result.term, .{ .Exited = 0 });
+        try std.testing.expect(mem.indexOf(u8, result.stderr, "Prefetch (pread)") != null);
+        try std.testing.expectEqualStrings(expected, result.stdout);
+    }
+
+    // NOTE(radomski): A BSD name longer than the member it's stored in, with
+    // enough bytes after it that only the member size gives it away
+    const bad_path = try scratch.writeFile("bad.a", "!<arch>\n" ++
+        "#1/64           " ++ "0           " ++ "0     " ++ "0     " ++ "644     " ++ "8         " ++ "`\n" ++
+        "short.o\x00" ++ "\x00" ** 64);
+    const result = try std.ChildProcess.exec(.{ .allocator = arena, .argv = &.{ "./zig-out/bin/dis", bad_path } });
+    try std.testing.expect(result.term != .Exited or result.term.Exited != 0);
+    try std.testing.expect(mem.indexOf(u8, result.stderr, "MalformedArchive") != null);
+}
+
+test "parallel printing" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): Three chunks of 256 structures, with namespaces open
+    // across the chunk boundaries
+    var source = std.ArrayList(u8).init(arena);
+    const writer = source.writer();
+    var outer: usize = 0;
+    while (outer < 12) : (outer += 1) {
+        try writer.print("namespace outer{} {{\nnamespace inner {{\n", .{outer});
+        var i: usize = 0;
+        while (i < 50) : (i += 1) {
+            if (i == 30) {
+                try writer.writeAll("}\n");
+            }
+            try writer.print("struct s{0} {{ char tag; int value[{1}]; long count; }};\ns{0} v{0};\n", .{ outer * 50 + i, i % 5 + 1 });
+        }
+        try writer.writeAll("}\n");
+    }
+    const source_path = try scratch.writeFile("nested.cpp", source.items);
+    const object_path = try scratch.compile(source_path, "nested.o");
+
+    const serial = try scratch.dis(&.{ object_path, "--print-threads", "1" });
+    try std.testing.expectEqual(@as(usize, 600), mem.count(u8, serial, "::s"));
+    try std.testing.expectEqualStrings(serial, try scratch.dis(&.{ object_path, "--print-threads", "4" }));
+}
+
+test "deps" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): -nostdlib so libdep.so is the only DT_NEEDED, and it's
+    // only found through the $ORIGIN path the binary carries
+    try scratch.tmp.dir.makeDir("lib");
+    const library_path = try scratch.path("lib/libdep.so");
+    _ = try scratch.ctx.expectSuccess(&.{ scratch.zig_exe_path, "cc", "-shared", "-g", "-nostdlib", "-o", library_path, try scratch.corpusPath("struct.c") });
+
+    const source_path = try scratch.writeFile("main.c",
+        \\struct app {
+        \\    char tag;
+        \\    long value;
+        \\};
+        \\struct app app;
+        \\void _start(void) {}
+        \\
+    );
+    const library_dir_arg = try std.fmt.allocPrint(arena, "-L{s}", .{try scratch.path("lib")});
+
+    // DT_RUNPATH, then DT_RPATH
+    for ([_][]const u8{ "-Wl,--enable-new-dtags", "-Wl,--disable-new-dtags" }) |dtags, i| {
+        const binary_path = try scratch.path(try std.fmt.allocPrint(arena, "main-{}", .{i}));
+        _ = try scratch.ctx.expectSuccess(&.{ scratch.zig_exe_path, "cc", "-g", "-nostdlib", "-o", binary_path, source_path, library_dir_arg, "-ldep", dtags, "-Wl,-rpath,$ORIGIN/lib" });
+
+        const expected = try scratch.dis(&.{ binary_path, library_path });
+        try std.testing.expect(mem.indexOf(u8, expected, "struct s {") != null);
+        try std.testing.expectEqualStrings(expected, try scratch.dis(&.{ binary_path, "--with-deps" }));
+    }
+}
+
+test "shard" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): A shared object so there is a CU per source file
+    const library_path = try scratch.path("libshard.so");
+    var compile_args = std.ArrayList([]const u8).init(arena);
+    try compile_args.appendSlice(&.{ scratch.zig_exe_path, "cc", "-shared", "-g", "-o", library_path });
+    for ([_][]const u8{ "struct.c", "union.c", "bitfields.c", "enum.c", "typedef_and_inlining.c" }) |name| {
+        try compile_args.append(try scratch.corpusPath(name));
+    }
+    _ = try scratch.ctx.expectSuccess(compile_args.items);
+
+    const single = try scratch.dis(&.{library_path});
+
+    const shard_count = 3;
+    var merge_args = std.ArrayList([]const u8).init(arena);
+    try merge_args.appendSlice(&.{ "./zig-out/bin/dis", "merge" });
+    var i: u32 = 1;
+    while (i <= shard_count) : (i += 1) {
+        const spec = try std.fmt.allocPrint(arena, "{}/{}", .{ i, shard_count });
+        const shard_path = try scratch.path(try std.fmt.allocPrint(arena, "shard-{}", .{i}));
+        _ = try scratch.dis(&.{ library_path, "--shard", spec, "--out", shard_path });
+        try merge_args.append(shard_path);
+    }
+    // Shard order on the command line doesn't matter
+    mem.reverse([]const u8, merge_args.items[2..]);
+
+    const merged = try scratch.ctx.expectSuccess(merge_args.items);
+    try std.testing.expectEqualStrings(single, merged);
+
+    // A CU index past u32 is malformed, not truncated
+    const bad_path = try scratch.writeFile("shard-bad", "dis-shard 1\nshard 1 1\ninput 1 0 -\ncu 4294967296 0\n");
+    const result = try std.ChildProcess.exec(.{ .allocator = arena, .argv = &.{ "./zig-out/bin/dis", "merge", bad_path } });
+    try std.testing.expect(result.term != .Exited or result.term.Exited != 0);
+    try std.testing.expect(mem.indexOf(u8, result.stderr, "MalformedShard") != null);
+}
+
+test "stream" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const object_path = try scratch.compile(try scratch.corpusPath("struct.c"), "struct.o");
+
+    // NOTE(radomski): Through cat so stdin is a pipe and can't be seeked
+    const from_file = try scratch.dis(&.{object_path});
+    const command = try std.fmt.allocPrint(scratch.arena, "cat '{s}' | ./zig-out/bin/dis -", .{object_path});
+    const from_pipe = try scratch.ctx.expectSuccess(&.{ "/bin/sh", "-c", command });
+    try std.testing.expectEqualStrings(from_file, from_pipe);
+
+    for ([_][]const u8{ "--with-deps", "--shard 1/2" }) |option| {
+        const rejected = try std.fmt.allocPrint(scratch.arena, "./zig-out/bin/dis - {s} < '{s}'", .{ option, object_path });
+        const result = try std.ChildProcess.exec(.{ .allocator = scratch.arena, .argv = &.{ "/bin/sh", "-c", rejected } });
+        try std.testing.expect(result.term != .Exited or result.term.Exited != 0);
+        try std.testing.expect(mem.indexOf(u8, result.stderr, "can't read from -") != null);
+    }
+}
+
+test "btf round trip" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): C corpus only, BTF has no place for classes nested in classes
+    const common_dir_path = try scratch.corpusDir();
+    var dir = try fs.cwd().openIterableDir(common_dir_path, .{});
+    defer dir.close();
+    var it = dir.iterate();
+    while (try it.next()) |entry| {
+        if (!mem.endsWith(u8, entry.name, ".c")) {
+            continue;
+        }
+
+        const object_path = try scratch.compile(try scratch.corpusPath(entry.name), try std.fmt.allocPrint(arena, "{s}.o", .{entry.name}));
+        const btf_path = try scratch.path(try std.fmt.allocPrint(arena, "{s}.btf", .{entry.name}));
+
+        const from_dwarf = try scratch.dis(&.{object_path});
+        _ = try scratch.dis(&.{ object_path, "--emit-btf", btf_path });
+        const from_btf = try scratch.dis(&.{btf_path});
+        try std.testing.expectEqualStrings(from_dwarf, from_btf);
+    }
+
+    // C++ without nested classes or bases, BTF keeps neither, and only
+    // structs, it has no class kind either
+    const source_path = try scratch.writeFile("round_trip.cpp",
+        \\namespace outer {
+        \\    namespace inner {
+        \\        struct point {
+        \\            int x;
+        \\            unsigned y;
+        \\            signed char sign;
+        \\        };
+        \\    }
+        \\    struct holder {
+        \\        inner::point points[2];
+        \\        long count;
+        \\    };
+        \\}
+        \\
+        \\int t(outer::holder h) {
+        \\    return h.points[0].x;
+        \\}
+    );
+    const object_path = try scratch.compile(source_path, "round_trip.o");
+    const btf_path = try scratch.path("round_trip.btf");
+    const from_dwarf = try scratch.dis(&.{object_path});
+    _ = try scratch.dis(&.{ object_path, "--emit-btf", btf_path });
+    const from_btf = try scratch.dis(&.{btf_path});
+    try std.testing.expectEqualStrings(from_dwarf, from_btf);
+
+    const btf_data = try fs.cwd().readFileAlloc(arena, btf_path, MegaByte);
+    try std.testing.expectEqual(@as(?bool, true), btfIntIsSigned(btf_data, "int"));
+    try std.testing.expectEqual(@as(?bool, false), btfIntIsSigned(btf_data, "unsigned int"));
+    try std.testing.expectEqual(@as(?bool, true), btfIntIsSigned(btf_data, "signed char"));
+}
+
+// The signed bit of the BTF int named name, only knows the kinds --emit-btf writes
+fn btfIntIsSigned(data: []const u8, name: []const u8) ?bool {
+    const hdr_len = mem.readIntLittle(u32, data[4..8]);
+    const types = data[hdr_len + mem.readIntLittle(u32, data[8..12]) ..][0..mem.readIntLittle(u32, data[12..16])];
+    const strings = data[hdr_len + mem.readIntLittle(u32, data[16..20]) ..][0..mem.readIntLittle(u32, data[20..24])];
+    var pos: usize = 0;
+    while (pos < types.len) {
+        const name_off = mem.readIntLittle(u32, types[pos..][0..4]);
+        const info = mem.readIntLittle(u32, types[pos + 4 ..][0..4]);
+        pos += 12;
+        const trailing: usize = switch (@truncate(u5, info >> 24)) {
+            1 => 4,
+            3 => 12,
+            4, 5 => @as(usize, @truncate(u16, info)) * 12,
+            else => 0,
+        };
+        if (@truncate(u5, info >> 24) == 1 and mem.eql(u8, mem.sliceTo(strings[name_off..], 0), name)) {
+            return (mem.readIntLittle(u32, types[pos..][0..4]) >> 24) & 1 != 0;
+        }
+        pos += trailing;
+    }
+    return null;
+}
+
+test "summary" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    const common_dir_path = try fs.cwd().realpathAlloc(arena, try scratch.corpusDir());
+    const source_path = try fs.path.join(arena, &.{ common_dir_path, "struct.c" });
+    const object_path = try scratch.path("struct.o");
+
+    // NOTE(radomski): Both line table layouts, directories moved to entry
+    // formats in version 5
+    for ([_]u8{ 4, 5 }) |dwarf_version| {
+        try scratch.ctx.compileObject(source_path, object_path, .{
+            .dwarf_version = dwarf_version,
+            .dwarf_bitness = 32,
+            .compiler_args = &.{ scratch.zig_exe_path, "cc" },
+        });
+
+        const output = try scratch.dis(&.{ object_path, "--summary", "--top", "3" });
+        try std.testing.expect(mem.startsWith(u8, output, "structs="));
+        const by_dir = mem.indexOf(u8, output, "By directory:\n") orelse return error.TestUnexpectedResult;
+        const dir_line = try std.fmt.allocPrint(arena, "  {s} structs=", .{common_dir_path});
+        try std.testing.expect(mem.indexOfPos(u8, output, by_dir, dir_line) != null);
+    }
+}
+
+test "sample" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+    const arena = scratch.arena;
+
+    // NOTE(radomski): CUs of the same layout and payload size, names of the
+    // same length, so the ratio estimate of every stratum is exact. The
+    // typedef gives every struct a copy which neither mode may count.
+    const unit_count = 32;
+    var compile_args = std.ArrayList([]const u8).init(arena);
+    const library_path = try scratch.path("libsample.so");
+    try compile_args.appendSlice(&.{ scratch.zig_exe_path, "cc", "-shared", "-g", "-nostdlib", "-o", library_path });
+    var i: usize = 10;
+    while (i < 10 + unit_count) : (i += 1) {
+        const source = try std.fmt.allocPrint(arena,
+            \\struct s{0} {{
+            \\    char tag;
+            \\    int value;
+            \\}};
+            \\typedef struct s{0} t{0};
+            \\int f{0}(t{0} *p) {{
+            \\    return p->value;
+            \\}}
+            \\
+        , .{i});
+        try compile_args.append(try scratch.writeFile(try std.fmt.allocPrint(arena, "unit{}.c", .{i}), source));
+    }
+    _ = try scratch.ctx.expectSuccess(compile_args.items);
+
+    const exact = try scratch.dis(&.{ library_path, "--summary" });
+    var fields = mem.tokenize(u8, exact[0 .. mem.indexOfScalar(u8, exact, '\n') orelse exact.len], " =");
+    var exact_structs: f64 = 0;
+    var exact_holes: f64 = 0;
+    var exact_waste: f64 = 0;
+    while (fields.next()) |key| {
+        const value = fields.next() orelse break;
+        if (mem.eql(u8, key, "structs")) {
+            exact_structs = try std.fmt.parseFloat(f64, value);
+        } else if (mem.eql(u8, key, "holes")) {
+            exact_holes = try std.fmt.parseFloat(f64, value);
+        } else if (mem.eql(u8, key, "waste")) {
+            exact_waste = try std.fmt.parseFloat(f64, value);
+        }
+    }
+    try std.testing.expectEqual(@as(f64, unit_count), exact_structs);
+
+    const sampled = try scratch.dis(&.{ library_path, "--sample=25%", "--seed", "7" });
+    try std.testing.expect(mem.startsWith(u8, sampled, "Sampled 16 of 32 CUs"));
+    try expectWithinEstimate(sampled, "structures", exact_structs);
+    try expectWithinEstimate(sampled, "holes", exact_holes);
+    try expectWithinEstimate(sampled, "padding bytes", exact_waste);
+}
+
+// The exact total inside the interval --sample printed for label, which is
+// rounded to whole numbers
+fn expectWithinEstimate(output: []const u8, label: []const u8, exact: f64) !void {
+    var lines = mem.split(u8, output, "\n");
+    while (lines.next()) |line| {
+        const trimmed = mem.trimLeft(u8, line, " ");
+        if (!mem.startsWith(u8, trimmed, label) or trimmed.len == label.len or trimmed[label.len] != ' ') {
+            continue;
+        }
+        var numbers = mem.tokenize(u8, trimmed[label.len..], " +-");
+        const total = try std.fmt.parseFloat(f64, numbers.next() orelse return error.TestUnexpectedResult);
+        const margin = try std.fmt.parseFloat(f64, numbers.next() orelse return error.TestUnexpectedResult);
+        try std.testing.expect(@fabs(total - exact) <= margin + 0.5);
+        return;
+    }
+    return error.TestUnexpectedResult;
+}
+
+test "profile" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const source_path = try scratch.writeFile("item.c",
+        \\struct item {
+        \\    int hot;
+        \\    char pad[100];
+        \\    int warm;
+        \\};
+        \\struct item g;
+        \\
+    );
+    const profile_path = try scratch.writeFile("item.profile",
+        \\# from perf mem
+        \\item::hot 1000
+        \\item::warm 500
+        \\
+    );
+    const object_path = try scratch.compile(source_path, "item.o");
+
+    const output = try scratch.dis(&.{ object_path, "--profile", profile_path });
+    try std.testing.expectEqualStrings(
+        \\struct item { // size=108, was 108, lines per access 1.50 => 1.00 (-33.3%)
+        \\  int hot; // size=4, offset=0, count=1000
+        \\  int warm; // size=4, offset=4, count=500
+        \\  char pad[100]; // size=100, offset=8
+        \\};
+        \\Lines per access over all profiled types: 1.50 => 1.00 (-33.3%)
+        \\
+    , output);
+}
+
+test "false sharing" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const source_path = try scratch.writeFile("queue.c",
+        \\#include <stdatomic.h>
+        \\struct spin {
+        \\    int locked;
+        \\};
+        \\struct queue {
+        \\    _Atomic unsigned long head;
+        \\    _Atomic unsigned long tail;
+        \\    char pad[48];
+        \\    struct spin lock;
+        \\    int capacity;
+        \\    void *slots;
+        \\};
+        \\struct queue g;
+        \\struct counters {
+        \\    atomic_int hits;
+        \\    atomic_int misses;
+        \\};
+        \\struct counters counters;
+        \\typedef struct {
+        \\    long value;
+        \\} atomic_stats;
+        \\struct stats {
+        \\    atomic_stats first;
+        \\    atomic_stats second;
+        \\};
+        \\struct stats stats;
+        \\
+    );
+    const profile_path = try scratch.writeFile("queue.profile",
+        \\queue::capacity 1000
+        \\queue::slots 900
+        \\queue::pad 10
+        \\
+    );
+    const object_path = try scratch.compile(source_path, "queue.o");
+
+    const output = try scratch.dis(&.{ object_path, "--false-sharing", "--lock-type", "spin", "--profile", profile_path });
+    try std.testing.expectEqualStrings(
+        \\struct queue size=80
+        \\  line 0: atomic head offset=0 size=8, atomic tail offset=8 size=8
+        \\  line 1: lock lock offset=64 size=4, hot capacity offset=68 size=4 count=1000, hot slots offset=72 size=8 count=900
+        \\struct counters size=8
+        \\  line 0: atomic hits offset=0 size=4, atomic misses offset=4 size=4
+        \\3 shared lines in 2 of 2 structs with atomics or locks
+        \\
+    , output);
+}
+
+test "globals" {
+    const scratch = try Scratch.create();
+    defer scratch.destroy();
+
+    const source_path = try scratch.writeFile("globals.c",
+        \\struct pair {
+        \\    char tag;
+        \\    void *value;
+        \\};
+        \\struct pair table[4];
+        \\_Thread_local int counter;
+        \\int scalar;
+        \\int initialized = 1;
+        \\extern int elsewhere;
+        \\int get(void) {
+        \\    static int hidden;
+        \\    return elsewhere + hidden++;
+        \\}
+        \\
+    );
+
+    // NOTE(radomski): Every section of an object starts at 0, which one a
+    // variable is in can't be told
+    const object_path = try scratch.compile(source_path, "globals.o");
+    const from_object = try scratch.dis(&.{ object_path, "--globals" });
+    try std.testing.expectEqualStrings(
+        \\globals=4 size=76
+        \\  global=4 size=76
+        \\thread_local=1 size=4 per thread
+        \\Top 5 by size:
+        \\  global pair table[4]; // size=64, waste=28 bytes and 0 bits
+        \\  thread_local int counter; // size=4
+        \\  global int get::hidden; // size=4
+        \\  global int initialized; // size=4
+        \\  global int scalar; // size=4
+        \\Top 1 by waste:
+        \\  global pair table[4]; // size=64, waste=28 bytes and 0 bits
+        \\
+    , from_object);
+
+    const library_path = try scratch.path("libglobals.so");
+    _ = try scratch.ctx.expectSuccess(&.{ scratch.zig_exe_path, "cc", "-shared", "-g", "-nostdlib", "-o", library_path, source_path });
+    const from_library = try scratch.dis(&.{ library_path, "--globals" });
+    try std.testing.expectEqualStrings(
+        \\globals=4 size=76
+        \\  .data=1 size=4
+        \\  .bss=3 size=72
+        \\thread_local=1 size=4 per thread
+        \\Top 5 by size:
+        \\  .bss pair table[4]; // size=64, waste=28 bytes and 0 bits
+        \\  thread_local int counter; // size=4
+        \\  .bss int get::hidden; // size=4
+        \\  .data int initialized; // size=4
+        \\  .bss int scalar; // size=4
+        \\Top 1 by waste:
+        \\  .bss pair table[4]; // size=64, waste=28 bytes and 0 bits
+        \\
+    , from_library);
+
+    // Defined outside the class, still qualified with it
+    const cpp_source_path = try scratch.writeFile("registry.cpp",
+        \\namespace ns {
+        \\struct registry {
+        \\    static int count;
+        \\    int id;
+        \\};
+        \\int registry::count = 3;
+        \\}
+        \\int use(ns::registry r) {
+        \\    return r.id + ns::registry::count;
+        \\}
+        \\
+    );
+    const cpp_object_path = try scratch.compile(cpp_source_path, "registry.o");
+    const from_cpp = try scratch.dis(&.{ cpp_object_path, "--globals" });
+    try std.testing.expectEqualStrings(
+        \\globals=1 size=4
+        \\  global=1 size=4
+        \\thread_local=0 size=0 per thread
+        \\Top 1 by size:
+        \\  global int ns::registry::count; // size=4
+        \\Top 0 by waste:
+        \\
+    , from_cpp);
+}
+
+// Built binary, a temporary directory and the zig to compile inputs with,
+// the setup of every test running dis on inputs of its own.
+const Scratch = struct {
+    arena_allocator: std.heap.ArenaAllocator,
+    arena: mem.Allocator,
+    ctx: TestContext,
+    tmp: std.testing.TmpDir,
+    dir_path: []const u8,
+    zig_exe_path: []const u8,
+
+    // NOTE(radomski): On the heap, arena points into it
+    pub fn create() !*Scratch {
+        const scratch = try std.testing.allocator.create(Scratch);
+        errdefer std.testing.allocator.destroy(scratch);
+        scratch.arena_allocator = std.heap.ArenaAllocator.init(std.testing.allocator);
+        errdefer scratch.arena_allocator.deinit();
+        scratch.arena = scratch.arena_allocator.allocator();
+
+        scratch.ctx = TestContext.init(scratch.arena);
+        try scratch.ctx.buildExec();
+        scratch.zig_exe_path = try std.process.getEnvVarOwned(scratch.arena, "ZIG_EXE");
+        scratch.tmp = std.testing.tmpDir(.{});
+        errdefer scratch.tmp.cleanup();
+        scratch.dir_path = try scratch.tmp.dir.realpathAlloc(scratch.arena, ".");
+        return scratch;
+    }
+
+    pub fn destroy(scratch: *Scratch) void {
+        scratch.tmp.cleanup();
+        scratch.arena_allocator.deinit();
+        std.testing.allocator.destroy(scratch);
+    }
+
+    pub fn path(scratch: *Scratch, name: []const u8) ![]const u8 {
+        return fs.path.join(scratch.arena, &.{ scratch.dir_path, name });
+    }
+
+    pub fn corpusDir(scratch: *Scratch) ![]const u8 {
+        return fs.path.join(scratch.arena, &.{ fs.path.dirname(@src().file).?, "..", "tests", "common" });
+    }
+
+    pub fn corpusPath(scratch: *Scratch, name: []const u8) ![]const u8 {
+        return fs.path.join(scratch.arena, &.{ try scratch.corpusDir(), name });
+    }
+
+    pub fn writeFile(scratch: *Scratch, name: []const u8, contents: []const u8) ![]const u8 {
+        try scratch.tmp.dir.writeFile(name, contents);
+        return scratch.path(name);
+    }
+
+    // zig cc, DWARF 5 with 32-bit offsets, into the temporary directory
+    pub fn compile(scratch: *Scratch, source_path: []const u8, object_name: []const u8) ![]const u8 {
+        const object_path = try scratch.path(object_name);
+        try scratch.ctx.compileObject(source_path, object_path, .{
+            .dwarf_version = 5,
+            .dwarf_bitness = 32,
+            .compiler_args = &.{ scratch.zig_exe_path, "cc" },
+        });
+        return object_path;
+    }
+
+    // Runs the built dis with args and returns its stdout
+    pub fn dis(scratch: *Scratch, args: []const []const u8) ![]const u8 {
+        var argv = std.ArrayList([]const u8).init(scratch.arena);
+        try argv.append("./zig-out/bin/dis");
+        try argv.appendSlice(args);
+        return scratch.ctx.expectSuccess(argv.items);
+    }
+};
+
 const TestContext = struct {
     arena: std.mem.Allocator,
     tests: std.ArrayListUnmanaged(Test) = .{},
@@ -40,6 +850,7 @@ const TestContext = struct {
         dwarf_version: u8,
         dwarf_bitness: u8,
         compiler_args: []const []const u8,
+        target: ?[]const u8 = null,
     };
 
     const Test = struct {
@@ -114,30 +925,107 @@ const TestContext = struct {
         }
     }
 
-    pub fn run(tc: *Self) !void {
+    pub fn addCrossTargetTests(
+        tc: *Self,
+        dir_path: []const u8,
+        filenames: []const []const u8,
+        compiler_args: []const []const u8,
+        target: []const u8,
+    ) !void {
+        for (filenames) |filename| {
+            const file_path = try std.fs.path.join(tc.arena, &.{ dir_path, filename });
+            const src = try std.fs.cwd().readFileAlloc(tc.arena, file_path, 10 * MegaByte);
+            const expected_output = try tc.getExpectedTestOutput(src);
 
-        // Compile the exec
-        {
-            const zig_exe_path = try std.process.getEnvVarOwned(tc.arena, "ZIG_EXE");
+            const configs = &[_]TestConfig{
+                .{ .dwarf_version = 4, .dwarf_bitness = 32, .compiler_args = compiler_args, .target = target },
+                .{ .dwarf_version = 5, .dwarf_bitness = 32, .compiler_args = compiler_args, .target = target },
+            };
+            for (configs) |config| {
+                try tc.tests.append(tc.arena, Test{
+                    .name = try std.fmt.allocPrint(tc.arena, "{s}_{s}_dwarf{d}_{s}", .{
+                        fs.path.basename(compiler_args[0]),
+                        target,
+                        config.dwarf_version,
+                        filename,
+                    }),
+                    .file_path = file_path,
+                    .expected_output = expected_output,
+                    .config = config,
+                });
+            }
+        }
+    }
 
-            var args = std.ArrayList([]const u8).init(tc.arena);
-            defer args.deinit();
+    pub fn buildExec(tc: *Self) !void {
+        const zig_exe_path = try std.process.getEnvVarOwned(tc.arena, "ZIG_EXE");
 
-            try args.append(zig_exe_path);
-            try args.append("build");
+        var args = std.ArrayList([]const u8).init(tc.arena);
+        defer args.deinit();
 
-            const result = try std.ChildProcess.exec(.{
-                .allocator = tc.arena,
-                .argv = args.items,
-            });
+        try args.append(zig_exe_path);
+        try args.append("build");
 
-            if (result.term.Exited != 0) {
-                std.debug.print("{s}\n", .{result.stdout});
-                std.debug.print("{s}\n", .{result.stderr});
-            }
+        const result = try std.ChildProcess.exec(.{
+            .allocator = tc.arena,
+            .argv = args.items,
+        });
+
+        if (result.term.Exited != 0) {
+            std.debug.print("{s}\n", .{result.stdout});
+            std.debug.print("{s}\n", .{result.stderr});
+        }
+
+        try std.testing.expectEqual(result.term.Exited, 0);
+    }
+
+    // Runs argv and returns its stdout, failing the test on a non zero exit.
+    pub fn expectSuccess(tc: *Self, argv: []const []const u8) ![]const u8 {
+        const result = try std.ChildProcess.exec(.{
+            .allocator = tc.arena,
+            .argv = argv,
+            .max_output_bytes = 10 * MegaByte,
+        });
 
-            try std.testing.expectEqual(result.term.Exited, 0);
+        if (result.term != .Exited or result.term.Exited != 0) {
+            std.debug.print("{s}\n", .{result.stderr});
         }
+        try std.testing.expectEqual(result.term, .{ .Exited = 0 });
+        return result.stdout;
+    }
+
+    pub fn compileObject(tc: *Self, file_path: []const u8, output_path: []const u8, config: TestConfig) !void {
+        var args = std.ArrayList([]const u8).init(tc.arena);
+        defer args.deinit();
+
+        for (config.compiler_args) |arg| {
+            try args.append(arg);
+        }
+        if (config.target) |target| {
+            try args.append("-target");
+            try args.append(target);
+        }
+        try args.append(file_path);
+        try args.append("-o");
+        try args.append(output_path);
+        try args.append("-c");
+        try args.append(try std.fmt.allocPrint(tc.arena, "-gdwarf-{d}", .{config.dwarf_version}));
+        try args.append(try std.fmt.allocPrint(tc.arena, "-gdwarf{d}", .{config.dwarf_bitness}));
+
+        const result = try std.ChildProcess.exec(.{
+            .allocator = tc.arena,
+            .argv = args.items,
+        });
+
+        if (result.term.Exited != 0) {
+            std.debug.print("{s}\n", .{result.stdout});
+            std.debug.print("{s}\n", .{result.stderr});
+        }
+        try std.testing.expectEqual(result.term.Exited, 0);
+    }
+
+    pub fn run(tc: *Self) !void {
+        try tc.buildExec();
 
         var passed: u32 = 0;
         for (tc.tests.items) |t| {
@@ -155,31 +1043,7 @@ const TestContext = struct {
             const output_path = try std.fs.path.join(tc.arena, &.{ tmp_dir_path, output_filename });
 
             // Compile the source file
-            {
-                var args = std.ArrayList([]const u8).init(tc.arena);
-                defer args.deinit();
-
-                for (t.config.compiler_args) |arg| {
-                    try args.append(arg);
-                }
-                try args.append(t.file_path);
-                try args.append("-o");
-                try args.append(output_path);
-                try args.append("-c");
-                try args.append(try std.fmt.allocPrint(tc.arena, "-gdwarf-{d}", .{t.config.dwarf_version}));
-                try args.append(try std.fmt.allocPrint(tc.arena, "-gdwarf{d}", .{t.config.dwarf_bitness}));
-
-                const result = try std.ChildProcess.exec(.{
-                    .allocator = tc.arena,
-                    .argv = args.items,
-                });
-
-                if (result.term.Exited != 0) {
-                    std.debug.print("{s}\n", .{result.stdout});
-                    std.debug.print("{s}\n", .{result.stderr});
-                }
-                try std.testing.expectEqual(result.term.Exited, 0);
-            }
+            try tc.compileObject(t.file_path, output_path, t.config);
 
             // Run program
             {
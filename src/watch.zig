@@ -0,0 +1,341 @@
+const std = @import("std");
+const main = @import("main.zig");
+const Context = main.Context;
+
+const fs = std.fs;
+const mem = std.mem;
+const linux = std.os.linux;
+
+const KiloByte = 1024;
+
+// Results of running the ELF, relocation and DWARF pipeline over one object.
+// Shared between every path whose bytes hash to the same value, so reverting
+// a file or copying it around never parses it again.
+const ObjectResult = struct {
+    arena_instance: std.heap.ArenaAllocator,
+    hash: u64,
+    ref_count: u32 = 0,
+    struct_count: u64 = 0,
+    waste_bits: u64 = 0,
+    // The top_n biggest of the object, sorted biggest first
+    holes: []ObjectHole = &[_]ObjectHole{},
+};
+
+const ObjectHole = struct {
+    struct_name: []const u8,
+    offset_bits: u64,
+    size_bits: u64,
+};
+
+const TrackedObject = struct {
+    path: []const u8,
+    result: *ObjectResult,
+};
+
+const AggregateHole = struct {
+    hole: ObjectHole,
+    object: *TrackedObject,
+};
+
+const Watcher = struct {
+    gpa: mem.Allocator,
+    results: std.AutoHashMapUnmanaged(u64, *ObjectResult) = .{},
+    objects: std.StringHashMapUnmanaged(*TrackedObject) = .{},
+    watch_dirs: std.AutoHashMapUnmanaged(i32, []const u8) = .{},
+
+    // Aggregates, kept up to date as objects come and go. The worst holes
+    // aren't, they're picked from each object's own top_n when reporting.
+    object_count: u64 = 0,
+    struct_count: u64 = 0,
+    waste_bits: u64 = 0,
+    top_n: usize,
+
+    const Self = @This();
+
+    fn holeGreaterThan(context: void, a: ObjectHole, b: ObjectHole) bool {
+        _ = context;
+        return a.size_bits > b.size_bits;
+    }
+
+    fn aggregateOrder(context: void, a: AggregateHole, b: AggregateHole) std.math.Order {
+        _ = context;
+        return std.math.order(a.hole.size_bits, b.hole.size_bits);
+    }
+
+    fn analyse(s: *Self, bytes: []u8, hash: u64) !*ObjectResult {
+        var result = try s.gpa.create(ObjectResult);
+        errdefer s.gpa.destroy(result);
+        result.* = .{
+            .arena_instance = std.heap.ArenaAllocator.init(s.gpa),
+            .hash = hash,
+        };
+        errdefer result.arena_instance.deinit();
+        const result_arena = result.arena_instance.allocator();
+
+        var parse_arena_instance = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+        defer parse_arena_instance.deinit();
+        const parse_arena = parse_arena_instance.allocator();
+
+        var c = try main.contextFromElf(bytes, parse_arena);
+        try c.parse();
+
+        var holes = std.ArrayList(ObjectHole).init(parse_arena);
+        var struct_holes = std.ArrayList(Context.Hole).init(parse_arena);
+        var sid: usize = 0;
+        while (sid < c.structures.len) : (sid += 1) {
+            const structure = c.structures.get(sid);
+            const stype = c.types.get(structure.type_id);
+            if (stype.size == 0 or stype.name == 0) {
+                continue;
+            }
+
+            struct_holes.clearRetainingCapacity();
+            try c.collectHoles(structure, 0, &struct_holes);
+            result.struct_count += 1;
+            if (struct_holes.items.len == 0) {
+                continue;
+            }
+
+            const struct_name = c.getName(stype.name);
+            for (struct_holes.items) |hole| {
+                result.waste_bits += hole.size_bits;
+                try holes.append(.{ .struct_name = struct_name, .offset_bits = hole.offset_bits, .size_bits = hole.size_bits });
+            }
+        }
+
+        // NOTE(radomski): Names point into the object's bytes, only the kept
+        // ones are copied out
+        std.sort.sort(ObjectHole, holes.items, {}, holeGreaterThan);
+        result.holes = try result_arena.dupe(ObjectHole, holes.items[0..@minimum(s.top_n, holes.items.len)]);
+        for (result.holes) |*hole| {
+            hole.struct_name = try result_arena.dupe(u8, hole.struct_name);
+        }
+        return result;
+    }
+
+    fn releaseResult(s: *Self, result: *ObjectResult) void {
+        result.ref_count -= 1;
+        if (result.ref_count == 0) {
+            _ = s.results.remove(result.hash);
+            result.arena_instance.deinit();
+            s.gpa.destroy(result);
+        }
+    }
+
+    fn removeFromAggregates(s: *Self, object: *TrackedObject) void {
+        s.object_count -= 1;
+        s.struct_count -= object.result.struct_count;
+        s.waste_bits -= object.result.waste_bits;
+    }
+
+    fn addToAggregates(s: *Self, object: *TrackedObject) void {
+        s.object_count += 1;
+        s.struct_count += object.result.struct_count;
+        s.waste_bits += object.result.waste_bits;
+    }
+
+    // Top n over all objects, biggest first. A min-heap of at most n, each
+    // object's holes are sorted so its walk stops at the first one that
+    // doesn't beat the smallest kept.
+    fn worstHoles(s: *Self, allocator: mem.Allocator) ![]AggregateHole {
+        var heap = std.PriorityQueue(AggregateHole, void, aggregateOrder).init(allocator, {});
+        defer heap.deinit();
+        try heap.ensureTotalCapacity(s.top_n + 1);
+
+        var it = s.objects.valueIterator();
+        while (it.next()) |object_ptr| {
+            const object = object_ptr.*;
+            for (object.result.holes) |hole| {
+                if (heap.count() == s.top_n) {
+                    if (s.top_n == 0 or hole.size_bits <= heap.peek().?.hole.size_bits) {
+                        break;
+                    }
+                    _ = heap.remove();
+                }
+                try heap.add(.{ .hole = hole, .object = object });
+            }
+        }
+
+        var out = try allocator.alloc(AggregateHole, heap.count());
+        var index = out.len;
+        while (heap.removeOrNull()) |entry| {
+            index -= 1;
+            out[index] = entry;
+        }
+        return out;
+    }
+
+    fn removeObject(s: *Self, path: []const u8) void {
+        const kv = s.objects.fetchRemove(path) orelse return;
+        const object = kv.value;
+        s.removeFromAggregates(object);
+        s.releaseResult(object.result);
+        s.gpa.free(object.path);
+        s.gpa.destroy(object);
+    }
+
+    fn updateObject(s: *Self, path: []const u8) !void {
+        const file = fs.cwd().openFile(path, .{}) catch |err| switch (err) {
+            error.FileNotFound => {
+                s.removeObject(path);
+                return;
+            },
+            else => return err,
+        };
+        defer file.close();
+        const bytes = try file.readToEndAlloc(s.gpa, std.math.maxInt(usize));
+        defer s.gpa.free(bytes);
+
+        const hash = std.hash.Wyhash.hash(0, bytes);
+        if (s.objects.get(path)) |object| {
+            if (object.result.hash == hash) {
+                return;
+            }
+        }
+
+        const result = s.results.get(hash) orelse blk: {
+            const new_result = s.analyse(bytes, hash) catch |err| {
+                std.log.warn("{s}: {s}", .{ path, @errorName(err) });
+                return;
+            };
+            try s.results.put(s.gpa, hash, new_result);
+            break :blk new_result;
+        };
+        result.ref_count += 1;
+
+        s.removeObject(path);
+        var object = try s.gpa.create(TrackedObject);
+        object.* = .{ .path = try s.gpa.dupe(u8, path), .result = result };
+        try s.objects.put(s.gpa, object.path, object);
+        s.addToAggregates(object);
+    }
+
+    fn addWatch(s: *Self, inotify_fd: i32, dir_path: []const u8) !void {
+        const mask = linux.IN.CLOSE_WRITE | linux.IN.MOVED_TO | linux.IN.MOVED_FROM | linux.IN.DELETE | linux.IN.CREATE;
+        const wd = try std.os.inotify_add_watch(inotify_fd, dir_path, mask);
+        const gop = try s.watch_dirs.getOrPut(s.gpa, wd);
+        if (!gop.found_existing) {
+            gop.value_ptr.* = try s.gpa.dupe(u8, dir_path);
+        }
+    }
+
+    fn scanDir(s: *Self, inotify_fd: i32, dir_path: []const u8) !void {
+        try s.addWatch(inotify_fd, dir_path);
+
+        var dir = try fs.cwd().openIterableDir(dir_path, .{});
+        defer dir.close();
+        var it = try dir.walk(s.gpa);
+        defer it.deinit();
+        while (try it.next()) |entry| {
+            const path = try fs.path.join(s.gpa, &.{ dir_path, entry.path });
+            defer s.gpa.free(path);
+            switch (entry.kind) {
+                .Directory => try s.addWatch(inotify_fd, path),
+                .File => if (isObjectPath(path)) try s.updateObject(path),
+                else => {},
+            }
+        }
+    }
+
+    fn printReport(s: *Self, stdout: anytype) !void {
+        try stdout.print("objects={} structs={} waste={} bytes and {} bits\n", .{
+            s.object_count,
+            s.struct_count,
+            s.waste_bits / 8,
+            s.waste_bits % 8,
+        });
+        const worst_holes = try s.worstHoles(s.gpa);
+        defer s.gpa.free(worst_holes);
+        for (worst_holes) |entry| {
+            try stdout.print("  HOLE => {d} bytes in {s} at offset={}:{} ({s})\n", .{
+                entry.hole.size_bits / 8,
+                entry.hole.struct_name,
+                entry.hole.offset_bits / 8,
+                entry.hole.offset_bits % 8,
+                entry.object.path,
+            });
+        }
+    }
+};
+
+fn isObjectPath(path: []const u8) bool {
+    return mem.eql(u8, fs.path.extension(path), ".o");
+}
+
+pub fn run(args: [][:0]u8) !void {
+    var gpa_instance = std.heap.GeneralPurposeAllocator(.{}){};
+    const gpa = gpa_instance.allocator();
+
+    var dir_path: ?[]const u8 = null;
+    var top_n: usize = 10;
+    var i: usize = 0;
+    while (i < args.len) : (i += 1) {
+        if (mem.eql(u8, args[i], "--top") and i + 1 < args.len) {
+            i += 1;
+            top_n = try std.fmt.parseInt(usize, args[i], 10);
+        } else if (dir_path == null) {
+            dir_path = args[i];
+        } else {
+            std.log.err("unknown watch argument {s}", .{args[i]});
+            return error.InvalidArgument;
+        }
+    }
+
+    const root = dir_path orelse {
+        std.log.err("watch requires a directory", .{});
+        return error.InvalidArgument;
+    };
+
+    const stdout_file = std.io.getStdOut().writer();
+    var bw = std.io.BufferedWriter(16 * KiloByte, @TypeOf(stdout_file)){ .unbuffered_writer = stdout_file };
+    const stdout = bw.writer();
+
+    var w = Watcher{ .gpa = gpa, .top_n = top_n };
+    const inotify_fd = try std.os.inotify_init1(linux.IN.CLOEXEC);
+    defer std.os.close(inotify_fd);
+
+    try w.scanDir(inotify_fd, root);
+    try w.printReport(stdout);
+    try bw.flush();
+
+    var pending = std.StringArrayHashMap(void).init(gpa);
+    var event_buffer: [64 * KiloByte]u8 align(@alignOf(linux.inotify_event)) = undefined;
+    while (true) {
+        const read = try std.os.read(inotify_fd, &event_buffer);
+        var offset: usize = 0;
+        while (offset < read) {
+            const event = @ptrCast(*const linux.inotify_event, @alignCast(@alignOf(linux.inotify_event), &event_buffer[offset]));
+            const name_start = offset + @sizeOf(linux.inotify_event);
+            offset = name_start + event.len;
+
+            const name = mem.sliceTo(event_buffer[name_start .. name_start + event.len], 0);
+            const watched_dir = w.watch_dirs.get(event.wd) orelse continue;
+            const path = try fs.path.join(gpa, &.{ watched_dir, name });
+
+            if (event.mask & linux.IN.ISDIR != 0) {
+                if (event.mask & (linux.IN.CREATE | linux.IN.MOVED_TO) != 0) {
+                    try w.scanDir(inotify_fd, path);
+                }
+                gpa.free(path);
+            } else if (isObjectPath(path) and event.mask & linux.IN.CREATE == 0) {
+                const gop = try pending.getOrPut(path);
+                if (gop.found_existing) {
+                    gpa.free(path);
+                }
+            } else {
+                gpa.free(path);
+            }
+        }
+
+        // NOTE(radomski): A rebuild touches many objects at once, only report
+        // after the whole batch of events got applied.
+        for (pending.keys()) |path| {
+            try w.updateObject(path);
+            gpa.free(path);
+        }
+        pending.clearRetainingCapacity();
+
+        try w.printReport(stdout);
+        try bw.flush();
+    }
+}
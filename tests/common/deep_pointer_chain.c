@@ -0,0 +1,11 @@
+struct deep {
+    char ****************************************************************************************************p;
+};
+
+int t(struct deep s) {
+    return s.p != 0;
+}
+
+//struct deep { // size=8
+//  char ****************************************************************************************************p; // size=8, offset=0
+//};
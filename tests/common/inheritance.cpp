@@ -0,0 +1,54 @@
+struct Pod {
+    int a;
+    char b;
+};
+
+struct PodDerived : Pod {
+    char c;
+};
+
+class NonPod {
+    int a;
+public:
+    char b;
+};
+
+class NonPodDerived : public NonPod {
+public:
+    char c;
+};
+
+int t(Pod a, PodDerived b, NonPod c, NonPodDerived d) {
+    return a.b + b.c + c.b + d.c;
+}
+
+//struct Pod { // size=8
+//  int  a; // size=4, offset=0
+//  char b; // size=1, offset=4
+//  // HOLE => 3 bytes
+//};
+//struct PodDerived { // size=12
+//  struct Pod { // base, size=8
+//    int  a; // size=4, offset=0
+//    char b; // size=1, offset=4
+//    // HOLE => 3 bytes
+//  };
+//  // TAIL PADDING => 3 bytes of Pod, not reusable, POD base
+//  char c; // size=1, offset=8
+//  // HOLE => 3 bytes
+//};
+//class NonPod { // size=8
+//  int  a; // size=4, offset=0
+//  char b; // size=1, offset=4
+//  // HOLE => 3 bytes
+//};
+//class NonPodDerived { // size=8
+//  class NonPod { // base, size=8
+//    int  a; // size=4, offset=0
+//    char b; // size=1, offset=4
+//    // HOLE => 3 bytes
+//  };
+//  // TAIL PADDING => 3 bytes of NonPod, reused
+//  char c; // size=1, offset=5
+//  // HOLE => 2 bytes
+//};
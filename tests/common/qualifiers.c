@@ -0,0 +1,22 @@
+struct q {
+    const int a;
+    const volatile int v;
+    volatile char b;
+    int *const p;
+    const char *s;
+    const char **pp;
+};
+
+int t(struct q q) {
+    return q.a;
+}
+
+//struct q { // size=40
+//  const int          a;  // size=4, offset=0
+//  const volatile int v;  // size=4, offset=4
+//  volatile char      b;  // size=1, offset=8
+//  // HOLE => 7 bytes
+//  int *const         p;  // size=8, offset=16
+//  const char *       s;  // size=8, offset=24
+//  const char **      pp; // size=8, offset=32
+//};